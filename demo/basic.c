@@ -1,33 +1,83 @@
+#define _DEFAULT_SOURCE  // fileno() and mmap() with -std=c99
+
 #include "basic.h"
 #include "basic_bytecode.h"
+#include "basic_cache.h"
 #include "basic_common.h"
 #include "basic_debug.h"
 #include "basic_exec.h"
+#include "basic_image.h"
 #include "basic_optimizer.h"
 #include "basic_parser.h"
+#include "basic_patch.h"
+#include "basic_reload.h"
+#include "basic_strpool.h"
+#include "basic_transpile.h"
+#include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Program: 0: BASIC source, 1: image file (see save()), 2: image compiled
+// at build time (basicc -c basicImage -o demo/test_image.h), 3: BASIC
+// source, compiled only if it isn't in the cache
+#define LOAD_FROM 0
+#if LOAD_FROM == 2
+#include "test_image.h"
+#endif
+
+// The image is read only after loading (sys.setCode = NULL), instructions
+// are only quickened in the decode cache of the instance
+#if EXEC_QUICKEN && EXEC_DECODE_CACHE == 0
+#error "EXEC_QUICKEN needs EXEC_DECODE_CACHE in the demo (read only image)"
+#endif
+
+// 1: Write a loaded source as C code to demo\test_aot.c (see transpile())
+#ifndef DEMO_TRANSPILE
+#define DEMO_TRANSPILE 0
+#endif
 
 
 //=============================================================================
 // Private variables
 //=============================================================================
-static char codeMem[CODE_MEM];
-static char strings[STRING_MEM];
+//-----------------------------------------------------------------------------
+// program image - written while loading, read only while executing (can be
+// shared by all instances of the program)
+//-----------------------------------------------------------------------------
+static char        codeMem[CODE_MEM];
+static char        strings[STRING_MEM];
+static idxType     codeLen    = 0;
+static idxType     strLen     = 0;
+static const char* imgCode    = codeMem;  // Read while executing
+static const char* imgStrings = strings;  // Read while executing
+static char*       codeBuf    = codeMem;  // Written while loading
+static sStrPool    pool;                  // Dedup of strings while loading
+
+//-----------------------------------------------------------------------------
+// reloading - new version of the program until it's swapped in
+//-----------------------------------------------------------------------------
+static char    nextCode[CODE_MEM];
+static idxType nextLen    = 0;  // 0: no reload pending
+static idxType nextStrLen = 0;
+static sReload reload;          // Differences to the running version
 
 //-----------------------------------------------------------------------------
 // loading
 //-----------------------------------------------------------------------------
-static idxType codeLen = 0;
-static idxType strLen  = 0;
-static FILE*   file    = NULL;
+static FILE* file = NULL;
 
 //-----------------------------------------------------------------------------
-// executing
+// executing - state of one instance
 //-----------------------------------------------------------------------------
+static sVm     vm;
 static idxType pc      = 0;
 static int     sleepMs = 0;
 
@@ -96,8 +146,8 @@ static int sleep(sCode* args, sCode* mem)
   if (sleepMs <= 0)
     sleepMs = 1;
 
-  // No return value
-  return 0;
+  // No return value, yield to end the time slice
+  return 1;
 }
 
 //=============================================================================
@@ -113,75 +163,22 @@ static char getNextChar(void)
 }
 
 //-----------------------------------------------------------------------------
-static int getCodeLen(eOp op)
+static void echo(char c)
 {
-  switch (op)
-  {
-    case CMD_INVALID:
-    case CMD_NOP:
-    case CMD_END:
-    case OP_NEQ:
-    case OP_LTEQ:
-    case OP_GTEQ:
-    case OP_LT:
-    case OP_GT:
-    case OP_EQUAL:
-    case OP_XOR:
-    case OP_OR:
-    case OP_AND:
-    case OP_NOT:
-    case OP_SHL:
-    case OP_SHR:
-    case OP_PLUS:
-    case OP_MINUS:
-    case OP_MOD:
-    case OP_MULT:
-    case OP_DIV:
-    case OP_IDIV:
-    case OP_POW:
-    case OP_SIGN:
-    case VAL_ZERO:
-      return 1;
-    case CMD_PRINT:
-    case CMD_LET_PTR:
-    case CMD_LET_REG:
-    case CMD_IF:
-    case CMD_GOTO:
-    case LNK_GOTO:
-    case CMD_GOSUB:
-    case LNK_GOSUB:
-    case CMD_RETURN:
-    case CMD_POP:
-    case CMD_SVC:
-    case CMD_GET_PTR:
-    case CMD_GET_REG:
-      return 3;
-    case CMD_LET_GLOBAL:
-    case CMD_LET_LOCAL:
-    case CMD_GET_GLOBAL:
-    case CMD_GET_LOCAL:
-    case CMD_CREATE_PTR:
-    case VAL_INTEGER:
-    case VAL_FLOAT:
-    case VAL_STRING:
-    case VAL_PTR:
-      return 5;
-    default:
-      return ERR_EXEC_CMD_INV;
-  }
+  putchar(c);  // Listing of the source while parsing
 }
 
 //-----------------------------------------------------------------------------
 static int addCode(const sCode* code)
 {
   int idx = codeLen;
-  int len = getCodeLen(code->op);
+  int len = image_codeLen(code->op);
 
   ENSURE(code, ERR_MEM_CODE);
   ENSURE(codeLen + len <= CODE_MEM, ERR_MEM_CODE);
-  codeMem[idx] = code->op;
+  codeBuf[idx] = code->op;
   if (len > 1)
-    memcpy(&codeMem[idx + 1], &code->param, len - 1);
+    memcpy(&codeBuf[idx + 1], &code->param, len - 1);
   codeLen += len;
   return idx;
 }
@@ -191,10 +188,10 @@ static int setCode(const sCodeIdx* code)
 {
   if (!code || code->idx >= CODE_MEM)
     return ERR_MEM_CODE;
-  int len            = getCodeLen(code->code.op);
-  codeMem[code->idx] = code->code.op;
+  int len            = image_codeLen(code->code.op);
+  codeBuf[code->idx] = code->code.op;
   if (len > 1)
-    memcpy(&codeMem[code->idx + 1], &code->code.param, len - 1);
+    memcpy(&codeBuf[code->idx + 1], &code->code.param, len - 1);
   return 0;
 }
 
@@ -214,11 +211,12 @@ static int getCode(sCodeIdx* code, int idx)
   if (idx < 0 || idx >= CODE_MEM)
     return ERR_MEM_CODE;
 
+  // Behind the code (e.g. end of a loaded image) memory reads as zero
   code->idx     = idx;
-  code->code.op = (eOp)codeMem[idx];
-  int len       = getCodeLen(code->code.op);
+  code->code.op = (idx < codeLen) ? (eOp)imgCode[idx] : CMD_INVALID;
+  int len       = image_codeLen(code->code.op);
   if (len > 1)
-    memcpy(&code->code.param, &codeMem[code->idx + 1], len - 1);
+    memcpy(&code->code.param, &imgCode[code->idx + 1], len - 1);
   return idx;
 }
 
@@ -231,32 +229,17 @@ static int getCodeNextIndex(void)
 //-----------------------------------------------------------------------------
 static int setString(const char* str, unsigned int len)
 {
-  int j;
-
-  for (int i = 0; i <= strLen; i++)
-  {
-    for (j = 0; j < len && j < strLen - i; j++)
-      if (strings[i + j] != str[j])
-        break;
-    if (j == len)
-      return i;
-    if (j == strLen - i)
-    {
-      ENSURE(strLen + len <= STRING_MEM, ERR_STR_MEM);
-      memcpy(&strings[strLen], &str[j], len - j);
-      strLen += len - j;
-      return i;
-    }
-  }
-  return ERR_STR_MEM;  // Never comes here
+  int start = strpool_add(&pool, str, len);
+  strLen    = pool.len;
+  return start;
 }
 
 //-----------------------------------------------------------------------------
 static int getString(const char** str, int start, unsigned int len)
 {
-  if (start + len > STRING_MEM)
+  if (start + len > (unsigned int)strLen)
     return ERR_STR_MEM;
-  *str = &strings[start];
+  *str = &imgStrings[start];
   return len;
 }
 
@@ -267,14 +250,16 @@ static int getString(const char** str, int start, unsigned int len)
 static sSys sys =
 {
   .getNextChar      = getNextChar,
+  .echo             = echo,
   .addCode          = addCode,
   .newCode          = newCode,
   .getCode          = getCode,
   .setCode          = setCode,
   .getCodeNextIndex = getCodeNextIndex,
-  .getCodeLen       = getCodeLen,
+  .getCodeLen       = image_codeLen,
   .getString        = getString,
   .setString        = setString,
+  .getTick          = sysTickMs,
   .regs             =
   {
     { "$TICK",      getTick, NULL,    0      },
@@ -293,9 +278,11 @@ static sSys sys =
 //=============================================================================
 static void clear(void)
 {
-  pc      = ERR_EXEC_END;
-  codeLen = 0;
-  strLen  = 0;
+  pc         = ERR_EXEC_END;
+  codeLen    = 0;
+  strLen     = 0;
+  imgCode    = codeMem;
+  imgStrings = strings;
   memset(codeMem, 0, sizeof(codeMem));
   memset(strings, 0, sizeof(strings));
 }
@@ -303,21 +290,120 @@ static void clear(void)
 //-----------------------------------------------------------------------------
 static bool save(void)
 {
-  // Mandadory data to save:
-  // - codeMem  (at least the first codeLen bytes)
-  // - strings  (at least the first strLen bytes)
-  // Recommended data to save:
-  // - codeLen  (helps to save/read only needed data)
-  // - strLen   (helps to save/read only needed data)
-  // - CRC      (ensure data integrity)
-  // - Version  (ensure compatibility: registers, buildin functions, ...)
+  // Image: header (version, signature of registers and buildin functions,
+  // CRC), code and strings (see basic_image.h)
+  sImage       image = {codeMem, codeLen, strings, strLen};
+  sImageHeader header;
+  FILE*        f;
+  bool         ok;
+
+  if (image_header(&sys, &image, &header) < 0)
+    return false;
+  f = fopen("demo\\test.bin", "wb");
+  if (!f)
+    return false;
+  ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+       fwrite(codeMem, 1, codeLen, f) == (size_t)codeLen &&
+       fwrite(strings, 1, strLen, f) == (size_t)strLen;
+  return (fclose(f) == 0) && ok;
+}
+
+//-----------------------------------------------------------------------------
+static bool openImage(const void* data, int size)
+{
+  // Code and strings of the image are used in place
+  sImage image;
+  int    err = image_open(&sys, data, size, &image);
+
+  if (err < 0)
+  {
+    printf("BASIC: Image error %d: %s" BASIC_OUT_EOL, err, errmsg(err));
+    return false;
+  }
+  imgCode    = image.code;
+  imgStrings = image.strings;
+  codeLen    = image.codeLen;
+  strLen     = image.strLen;
   return true;
 }
 
 //-----------------------------------------------------------------------------
 static bool load(void)
 {
-  // load data -> must match save()
+#if defined(__linux__)
+  // Map the image (no copy)
+  static void* map     = NULL;
+  static off_t mapSize = 0;
+  struct stat  st;
+  FILE*        f;
+
+  if (map)
+    munmap(map, mapSize);
+  map = NULL;
+  f   = fopen("demo\\test.bin", "rb");
+  if (!f)
+    return false;
+  if (fstat(fileno(f), &st) == 0 && st.st_size > 0)
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+  fclose(f);
+  if (!map || map == MAP_FAILED)
+  {
+    map = NULL;
+    return false;
+  }
+  mapSize = st.st_size;
+  return openImage(map, mapSize);
+#else
+  // Read the image into RAM. On a MCU, the image in flash can be executed in
+  // place instead (see LOAD_FROM)
+  static char buf[IMAGE_SIZE(CODE_MEM, STRING_MEM)];
+  FILE*       f = fopen("demo\\test.bin", "rb");
+  int         size;
+
+  if (!f)
+    return false;
+  size = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  return openImage(buf, size);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+static bool writePatched(void* ctx, const void* data, int len)
+{
+  return fwrite(data, 1, len, (FILE*)ctx) == (size_t)len;
+}
+
+//-----------------------------------------------------------------------------
+static bool compile(void)
+{
+  // Source from file into codeBuf, strings into the pool
+  // Parser tables only while loading (on the C stack here, could also be a
+  // buffer which is used later, e.g. by an SVC)
+  char    arena[PARSE_ARENA_SIZE];
+  sParser parser;
+  int     line, col, err;
+
+  parse_arena(&parser, arena, sizeof(arena));
+  if ((err = parse_all(&parser, &sys, &line, &col)) < 0)
+  {
+    printf("%*s" BASIC_OUT_EOL, col, "^");
+    printf("ERROR %d in Line %d, Col %d: %s" BASIC_OUT_EOL, err, line, col,
+            errmsg(err));
+    return false;
+  }
+  if ((err = parse_link(&parser, &sys)) < 0)
+  {
+    printf("LINK ERROR %d: %s" BASIC_OUT_EOL, err, errmsg(err));
+    return false;
+  }
+  if ((err = optimize(&sys)) < 0)
+  {
+    printf("Optimizer ERROR %d: %s" BASIC_OUT_EOL, err, errmsg(err));
+    return false;
+  }
+  codeLen = err;  // Optimized code can be shorter
+  parse_stat(&parser, codeLen, strLen);
   return true;
 }
 
@@ -333,29 +419,10 @@ static bool readFromFile(const char* filename)
 
   printf("=[ Load ]===================================================="
          BASIC_OUT_EOL);
-  {
-    int line, col, err;
-
-    if ((err = parseAll(&sys, &line, &col)) < 0)
-    {
-      printf("%*s" BASIC_OUT_EOL, col, "^");
-      printf("ERROR %d in Line %d, Col %d: %s" BASIC_OUT_EOL, err, line, col,
-              errmsg(err));
-      return false;
-    }
-    if ((err = link(&sys)) < 0)
-    {
-      printf("LINK ERROR %d: %s" BASIC_OUT_EOL, err, errmsg(err));
-      return false;
-    }
-    if ((err = optimize(&sys)) < 0)
-    {
-      printf("Optimizer ERROR %d: %s" BASIC_OUT_EOL, err, errmsg(err));
-      return false;
-    }
-    parseStat(codeLen, strLen);
-    save();
-  }
+  strpool_init(&pool, strings, sizeof(strings));
+  if (!compile())
+    return false;
+  save();
 
   printf("=[ List ]=============================================0======\r\n");
   {
@@ -370,43 +437,283 @@ static bool readFromFile(const char* filename)
     }
     printf("'" BASIC_OUT_EOL);
   }
+
+#if DEMO_TRANSPILE
+  {
+    FILE* c   = fopen("demo\\test_aot.c", "w");
+    int   err = c ? transpile(&sys, codeLen, "BasicAot", c) : ERR_AOT_WRITE;
+    if (c)
+      fclose(c);
+    if (err < 0)
+      printf("Transpile ERROR %d: %s" BASIC_OUT_EOL, err, errmsg(err));
+  }
+#endif
   return true;
 }
 
+#if LOAD_FROM == 3
+//-----------------------------------------------------------------------------
+static bool readCached(const char* filename)
+{
+  // Image of the same source, configuration, registers and SVCs
+  static char buf[IMAGE_SIZE(CODE_MEM, STRING_MEM)];
+  sImage      image;
+  FILE*       f = fopen(filename, "rb");
+  char*       source;
+  long        len;
+  uint64_t    key;
+  int         err;
+
+  if (!f)
+  {
+    printf("Error open file" BASIC_OUT_EOL);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  len    = ftell(f);
+  source = malloc(len > 0 ? len : 1);
+  rewind(f);
+  len = source ? fread(source, 1, len, f) : 0;
+  fclose(f);
+  key = cache_key(&sys, source, len);
+  free(source);
+
+  err = cache_load("demo\\cache_", key, buf, sizeof(buf));
+  if (err > 0 && openImage(buf, err))
+  {
+    printf("BASIC: Cached image %016" PRIx64 BASIC_OUT_EOL, key);
+    return true;
+  }
+  if (!readFromFile(filename))
+    return false;
+
+  image = (sImage){codeMem, codeLen, strings, strLen};
+  if ((err = cache_store(&sys, "demo\\cache_", key, &image)) < 0)
+    printf("BASIC: Cache error %d: %s" BASIC_OUT_EOL, err, errmsg(err));
+  return true;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+static bool swap(void)
+{
+  // New version in place of the running one at a safe point (no Sub
+  // running), the globals on the stack are kept
+  idxType newPc = pc;
+
+  if (reload_pc(&reload, &vm, &newPc) < 0)
+    return false;
+
+  memcpy(codeMem, nextCode, nextLen);
+  imgCode = codeMem;
+  codeLen = nextLen;
+  strLen  = nextStrLen;
+  pc      = newPc;
+  nextLen = 0;
+
+  // Drop compiled and decoded code of the old version
+  exec_flush(&sys);
+  exec_decode(&vm, &sys);
+  printf("BASIC: Reloaded, %d of %d Subs changed" BASIC_OUT_EOL,
+         reload.changed, reload.cur.cnt);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static int stepToSwap(void)
+{
+  // Single instructions up to a safe point for the pending reload, at most
+  // for one slice
+  int start = sysTickMs();
+  int res   = EXEC_RUN_BUDGET;
+
+  while (!swap())
+  {
+    if (sysTickMs() - start >= 2)
+      return EXEC_RUN_TIMEOUT;
+    if ((res = exec_run(&vm, &sys, &pc, 1, -1)) != EXEC_RUN_BUDGET)
+      break;
+  }
+  return res;
+}
+
 //=============================================================================
 // Public functions
 //=============================================================================
 void BasicInit(void)
 {
-#if 1   // Read from file
+  sys.setCode = setCode;  // Loader and optimizer write the image
+
+#if LOAD_FROM == 0
   if (!readFromFile("demo\\test.bas"))
-#else   // Load precompiled bytecode
+#elif LOAD_FROM == 1
   if (!load())
+#elif LOAD_FROM == 2
+  if (!openImage(basicImage, basicImageLen))
+#else
+  if (!readCached("demo\\test.bas"))
 #endif
   {
     printf("BASIC: Load error" BASIC_OUT_EOL);
     clear();
   }
 
+  // Check stack usage and operands of the bytecode
+  int err = verify(&sys, codeLen);
+  if (err < 0)
+  {
+    printf("BASIC: Verify error %d: %s" BASIC_OUT_EOL, err, errmsg(err));
+#if !EXEC_CHECK_STACK
+    clear();  // Interpreter without stack checks runs verified code only
+#endif
+  }
+
+  // Image is read only from now on, instances only own their sVm
+  sys.setCode = NULL;
+
+  // New program: fresh VM, drop compiled code of the old one
+  exec_reset(&vm);
+  exec_flush(&sys);
+
+  // Decode instructions in advance (if enabled)
+  int ram = exec_decode(&vm, &sys);
+  if (ram > 0)
+    printf("BASIC: Decode cache %d bytes" BASIC_OUT_EOL, ram);
+
   // Autostart
-  pc = ((eOp)codeMem[0] != CMD_INVALID) ? 0 : ERR_EXEC_END;
+  pc = ((eOp)imgCode[0] != CMD_INVALID) ? 0 : ERR_EXEC_END;
+}
+
+//-----------------------------------------------------------------------------
+bool BasicReload(const char* filename)
+{
+  // Compiles a new version of the running program (e.g. a fix pushed to the
+  // device). BasicTask() swaps it in if only code in Subs changed, else the
+  // program has to be restarted (BasicInit())
+  const char* curCode = imgCode;
+  idxType     curLen  = codeLen;
+  idxType     curStr  = strLen;
+  bool        ok;
+  int         err;
+
+  file = fopen(filename, "r");
+  if (!file)
+    return false;
+
+  // New strings behind the ones of the running program (still in use)
+  if (imgStrings != strings)
+    memcpy(strings, imgStrings, strLen);
+  imgStrings = strings;
+  strpool_init(&pool, strings, sizeof(strings));
+  strpool_reuse(&pool, strLen);
+
+  codeBuf     = nextCode;
+  imgCode     = nextCode;
+  codeLen     = 0;
+  sys.setCode = setCode;
+  ok          = compile();
+  if (ok && (err = verify(&sys, codeLen)) < 0)
+  {
+    printf("BASIC: Verify error %d: %s" BASIC_OUT_EOL, err, errmsg(err));
+    ok = EXEC_CHECK_STACK;  // Else only verified code runs (see BasicInit())
+  }
+  fclose(file);
+  file = NULL;
+
+  nextLen     = ok ? codeLen : 0;
+  nextStrLen  = strLen;
+  codeBuf     = codeMem;
+  imgCode     = curCode;
+  codeLen     = curLen;
+  strLen      = curStr;
+  sys.setCode = NULL;
+  if (!ok)
+    return false;
+
+  // Same code outside of the Subs?
+  {
+    sImage cur  = {imgCode, codeLen, imgStrings, strLen};
+    sImage next = {nextCode, nextLen, strings, nextStrLen};
+
+    if ((err = reload_map(&reload, &cur, &next)) < 0)
+    {
+      printf("BASIC: Reload error %d: %s" BASIC_OUT_EOL, err, errmsg(err));
+      nextLen = 0;
+      return false;
+    }
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool BasicPatch(const char* filename)
+{
+  // Updates the image file (see save()) with a patch of basicpatch. The patch
+  // is applied while it's read in small blocks, like received over a radio
+  // link. On a MCU the new image goes into a second flash area
+  static char     old[IMAGE_SIZE(CODE_MEM, STRING_MEM)];
+  static sPatcher patcher;
+  char            buf[64];
+  FILE*           in;
+  FILE*           out;
+  int             size = 0;
+  int             res;
+  int             len;
+
+  in = fopen("demo\\test.bin", "rb");
+  if (in)
+  {
+    size = fread(old, 1, sizeof(old), in);
+    fclose(in);
+  }
+  in  = fopen(filename, "rb");
+  out = fopen("demo\\test.new", "wb");
+  if (!in || !out)
+  {
+    if (in)
+      fclose(in);
+    if (out)
+      fclose(out);
+    return false;
+  }
+  res = patch_init(&patcher, old, size, writePatched, out);
+  while (res == 0 && (len = fread(buf, 1, sizeof(buf), in)) > 0)
+    res = patch_feed(&patcher, buf, len);
+  fclose(in);
+  if (fclose(out) != 0 && res == 1)
+    res = ERR_PATCH_WRITE;
+  if (res != 1)
+  {
+    res = (res == 0) ? ERR_PATCH_DATA : res;  // Patch truncated
+    printf("BASIC: Patch error %d: %s" BASIC_OUT_EOL, res, errmsg(res));
+    remove("demo\\test.new");
+    return false;
+  }
+  remove("demo\\test.bin");
+  return rename("demo\\test.new", "demo\\test.bin") == 0;
 }
 
 //-----------------------------------------------------------------------------
 bool BasicTask(int interval)
 {
-  int start = sysTickMs();
+  int res;
 
   if (sleepMs > 0)
     sleepMs -= interval;
-
-  while (sleepMs <= 0 && pc >= 0 && sysTickMs() - start < 2)
+  if (sleepMs > 0 || pc < 0)
+    return (pc >= 0);
+
+  res = (nextLen > 0) ? stepToSwap() : EXEC_RUN_BUDGET;
+  if (res == EXEC_RUN_BUDGET)
+    res = exec_run(&vm, &sys, &pc, INT_MAX, 2);  // Run for 2ms
+  if (res == ERR_EXEC_END)
+    printf("BASIC: done" BASIC_OUT_EOL);
+  else if (res < 0)
+    printf("BASIC: Runtime error %d" BASIC_OUT_EOL, res);
+  if (res < 0)
   {
-    pc = exec(&sys, pc);
-    if (pc == ERR_EXEC_END)
-      printf("BASIC: done" BASIC_OUT_EOL);
-    else if (pc < 0)
-      printf("BASIC: Runtime error %d" BASIC_OUT_EOL, pc);
+    pc = res;
+    exec_stat(&vm);
   }
   return (pc >= 0);
 }
@@ -7,3 +7,5 @@
 //=============================================================================
 void BasicInit(void);
 bool BasicTask(int interval);
+bool BasicReload(const char* filename);
+bool BasicPatch(const char* filename);
@@ -4,6 +4,7 @@
 // Defines
 //=============================================================================
 #define BASIC_OUT_EOL "\r\n"  // EOL for outputs
+#define BASIC_LARGE   0       // Hosts: 32 bit indices, hashed symbol tables
 
 //-----------------------------------------------------------------------------
 // Bytecode
@@ -23,8 +24,36 @@
 #define MAX_LABELS    16  // Max number of labels
 #define MAX_STRING    40  // Max length of individual string
 #define STAT          1   // Enable bookkeeping for statistics
+#define PARSE_STATIC  0   // parseAll(), link(), ... with a static arena
 
 //-----------------------------------------------------------------------------
 // Exec
 //-----------------------------------------------------------------------------
-#define STACK_SIZE    32  // Stack size [entries]
+#define STACK_SIZE        32  // Stack size [entries]
+#define EXEC_TICK_CHECK   64  // Instructions between clock reads in exec_run()
+#define EXEC_THREADED     1   // Threaded dispatch (only GCC/Clang, else switch)
+#define EXEC_DECODE_CACHE 0   // Decoded instructions (0: off, CODE_MEM: all)
+#define EXEC_QUICKEN      0   // Rewrite instructions for the seen types (cache)
+#define EXEC_CHECK_STACK  1   // Stack checks (0: only run verified programs)
+#define EXEC_CHECK_BOUNDS 1   // Check array indices against the dimension
+#define EXEC_JIT          1   // Compile hot subs (only x86-64 Linux, else off)
+#define EXEC_JIT_CALLS    16  // Calls of a sub before it's compiled
+#define EXEC_JIT_MEM      64  // Executable memory for compiled subs [KiB]
+
+//-----------------------------------------------------------------------------
+// Scheduler (only Linux hosts)
+//-----------------------------------------------------------------------------
+#define SCHED_MAX_WORKERS 16    // Max number of worker threads
+#define SCHED_SLICE       4096  // Instructions per time slice of an instance
+#define SCHED_WHEEL       256   // Slots of the timer wheel [ms]
+
+//-----------------------------------------------------------------------------
+// Optimizer
+//-----------------------------------------------------------------------------
+#define OPT_MAX_TARGETS   64  // Jump targets for type inference (0: off)
+#define OPT_SLOTS         1   // Three-address instructions on frame slots
+
+//-----------------------------------------------------------------------------
+// Patches (updates of an image, see basic_patch.h)
+//-----------------------------------------------------------------------------
+#define PATCH_MAX_SEGS    16  // Parts copied from the old image (12 bytes each)
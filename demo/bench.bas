@@ -0,0 +1,19 @@
+' Benchmark: integer loops, arrays and sub calls (no output in the loops)
+Option Explicit
+
+Sub Mix(a, b)
+  Mix = (a * 3 + b) Mod 1000
+End Sub
+
+Dim sum = 0
+Dim tmp = 0
+Dim arr(8)
+For i = 1 To 20000
+  For j = 0 To 7
+    arr(j) = arr(j) + i - j
+    sum = sum + arr(j) Mod 7
+  Next
+  tmp = Mix(tmp, i)
+  If sum > 100000 Then sum = sum - 100000
+Next
+Print "sum="; sum; " tmp="; tmp
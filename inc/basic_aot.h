@@ -0,0 +1,513 @@
+#pragma once
+
+// Runtime of the C code generated by transpile() (see basic_transpile.c).
+// Only the generated file includes it, the functions and the state mirror
+// basic_exec.c, so results and error codes are the same as in the VM.
+
+#include "basic_bytecode.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include "basic_exec.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define IS_INT(x)   ((x).op == VAL_INTEGER)
+#define COMPARE(a, b, cmp)                                                     \
+  ((IS_INT(a) && IS_INT(b)) ? ((a).iValue cmp (b).iValue)                      \
+                            : (castFloat(&(a)) cmp castFloat(&(b))))
+
+#if EXEC_CHECK_STACK
+#define ENSURE_STACK(n) ENSURE(sp >= (n), ERR_EXEC_STACK_UF)
+#define ENSURE_ROOM()   ENSURE(sp < ARRAY_SIZE(stack), ERR_EXEC_STACK_OF)
+#define ENSURE_NEED(n)  ENSURE(sp + (n) <= ARRAY_SIZE(stack), ERR_EXEC_STACK_OF)
+#else
+#define ENSURE_STACK(n)
+#define ENSURE_ROOM()
+#define ENSURE_NEED(n)
+#endif
+
+#if EXEC_CHECK_BOUNDS
+#define ENSURE_INDEX(i, dim) ENSURE((i) >= 0 && (i) < (dim), ERR_EXEC_OUT_BOUND)
+#else
+#define ENSURE_INDEX(i, dim) ENSURE((i) >= 0, ERR_EXEC_OUT_BOUND)
+#endif
+
+// Constant operand of a slot instruction
+#define KONST(k) (&(sCode){.op = VAL_INTEGER, .iValue = (k)})
+
+//-----------------------------------------------------------------------------
+// Instructions, the operands are constants of the bytecode
+//-----------------------------------------------------------------------------
+// clang-format off
+#define GOSUB(func, ret)                                                       \
+  do                                                                           \
+  {                                                                            \
+    int _r;                                                                    \
+    CHECK(pushLabel((ret), fp));                                               \
+    fp = sp - 1;                                                               \
+    CHECK(_r = func());                                                        \
+    ENSURE(_r == (ret), ERR_EXEC_PC);                                          \
+  } while (0)
+
+#define SVC(idx)                                                               \
+  do                                                                           \
+  {                                                                            \
+    int _r;                                                                    \
+    CHECK(_r = svc(idx));                                                      \
+    if (_r > 0 && yield)  /* SVC requests to yield */                          \
+      CHECK(yield());                                                          \
+  } while (0)
+
+#define IF(lbl)                                                                \
+  ENSURE_STACK(1);                                                             \
+  if (!castBool(&stack[--sp])) goto lbl
+
+#define IF_CMP(cmp, lbl)                                                       \
+  ENSURE_STACK(2); sp -= 2;                                                    \
+  if (!COMPARE(stack[sp], stack[sp + 1], cmp)) goto lbl
+
+#define IF_CMP_II(cmp, lbl)                                                    \
+  ENSURE_STACK(2); sp -= 2;                                                    \
+  if (!(stack[sp].iValue cmp stack[sp + 1].iValue)) goto lbl
+
+#define FOR(var, lbl)                                                          \
+  do                                                                           \
+  {                                                                            \
+    int _r;                                                                    \
+    CHECK(_r = forTest(var));                                                  \
+    if (!_r) goto lbl;                                                         \
+  } while (0)
+
+#define NEXT(var, lbl)                                                         \
+  do                                                                           \
+  {                                                                            \
+    int _r;                                                                    \
+    CHECK(_r = forNext(var));                                                  \
+    if (_r) goto lbl;                                                          \
+  } while (0)
+
+#define OP_CMP(cmp)                                                            \
+  ENSURE_STACK(2); sp -= 2;                                                    \
+  CHECK(pushInt(COMPARE(stack[sp], stack[sp + 1], cmp) ? -1 : 0))
+
+#define OP_INT(op)                                                             \
+  ENSURE_STACK(2); sp -= 2;                                                    \
+  CHECK(pushInt(castInt(&stack[sp]) op castInt(&stack[sp + 1])))
+
+#define OP_ARITH(op)                                                           \
+  ENSURE_STACK(2); sp -= 2;                                                    \
+  CHECK((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))                           \
+      ? pushInt(stack[sp].iValue        op stack[sp + 1].iValue)               \
+      : pushFloat(castFloat(&stack[sp]) op castFloat(&stack[sp + 1])))
+
+// Both operands are known to be integers (see optimizer)
+#define OP_II(op)                                                              \
+  ENSURE_STACK(2); sp -= 1;                                                    \
+  stack[sp - 1].iValue = stack[sp - 1].iValue op stack[sp].iValue
+
+#define OP_CMP_II(cmp)                                                         \
+  ENSURE_STACK(2); sp -= 1;                                                    \
+  stack[sp - 1].iValue = -(stack[sp - 1].iValue cmp stack[sp].iValue)
+// clang-format on
+
+// Slot instructions: dst = a <op> b, need: see SLOT_NEED
+#define SLOT_ARITH(dst, need, a, b, oper)                                      \
+  do                                                                           \
+  {                                                                            \
+    ENSURE_NEED(need);                                                         \
+    sCode* _a = (a);                                                           \
+    sCode* _b = (b);                                                           \
+    sCode* _d = slot(dst);                                                     \
+    ENSURE(_d && _a && _b, ERR_EXEC_VAR_INV);                                  \
+    if (IS_INT(*_a) && IS_INT(*_b))                                            \
+    {                                                                          \
+      iType _i   = _a->iValue oper _b->iValue;                                 \
+      _d->op     = VAL_INTEGER;                                                \
+      _d->iValue = _i;                                                         \
+    }                                                                          \
+    else                                                                       \
+    {                                                                          \
+      fType _f   = castFloat(_a) oper castFloat(_b);                           \
+      _d->op     = VAL_FLOAT;                                                  \
+      _d->fValue = _f;                                                         \
+    }                                                                          \
+  } while (0)
+
+// Slot instructions: if not (a <cmp> b) goto lbl
+#define SLOT_IF(a, b, cmp, lbl)                                                \
+  do                                                                           \
+  {                                                                            \
+    ENSURE_NEED(SLOT_NEED_IF);                                                 \
+    sCode* _a = (a);                                                           \
+    sCode* _b = (b);                                                           \
+    ENSURE(_a && _b, ERR_EXEC_VAR_INV);                                        \
+    if (!COMPARE(*_a, *_b, cmp))                                               \
+      goto lbl;                                                                \
+  } while (0)
+
+//=============================================================================
+// Private variables
+//=============================================================================
+static sCode       stack[STACK_SIZE];
+static idxType     sp = 0;
+static idxType     fp = 0;
+static sSys*       sys;
+static int         (*yield)(void);
+static const char* strPool;
+static int         strPoolLen;
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static inline void begin(sSys* system, int (*cb)(void), const char* str,
+                         int len)
+{
+  sys        = system;
+  yield      = cb;
+  strPool    = str;
+  strPoolLen = len;
+  sp = fp = 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline bool castBool(const sCode* value)
+{
+  if (value->op == VAL_INTEGER)
+    return value->iValue;
+  if (value->op == VAL_FLOAT)
+    return value->fValue;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static inline iType castInt(const sCode* value)
+{
+  if (value->op == VAL_INTEGER)
+    return value->iValue;
+  if (value->op == VAL_FLOAT)
+    return value->fValue + 0.5f;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline fType castFloat(const sCode* value)
+{
+  if (value->op == VAL_INTEGER)
+    return value->iValue;
+  if (value->op == VAL_FLOAT)
+    return value->fValue;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int pushInt(iType value)
+{
+  ENSURE_ROOM();
+  stack[sp].op     = VAL_INTEGER;
+  stack[sp].iValue = value;
+  sp++;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int pushFloat(fType value)
+{
+  ENSURE_ROOM();
+  stack[sp].op     = VAL_FLOAT;
+  stack[sp].fValue = value;
+  sp++;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int pushLabel(idxType idx, idxType fp)
+{
+  ENSURE_ROOM();
+  stack[sp].op      = VAL_LABEL;
+  stack[sp].lbl.lbl = idx;
+  stack[sp].lbl.fp  = fp;
+  sp++;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int pushCode(const sCode* code)
+{
+  ENSURE_ROOM();
+  memcpy(&stack[sp++], code, sizeof(sCode));
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int getReg(idxType idx)
+{
+  sCode value;
+  ENSURE(idx >= 0 && idx < MAX_REG_NUM, ERR_EXEC_REG_INV);
+  ENSURE(sys->regs[idx].getter, ERR_EXEC_REG_READ);
+  CHECK(sys->regs[idx].getter(&value, sys->regs[idx].cookie));
+  return pushCode(&value);
+}
+
+//-----------------------------------------------------------------------------
+static inline int setReg(idxType idx)
+{
+  ENSURE_STACK(1);
+  sp--;
+  ENSURE(idx >= 0 && idx < MAX_REG_NUM, ERR_EXEC_REG_INV);
+  ENSURE(sys->regs[idx].setter, ERR_EXEC_REG_WRITE);
+  return sys->regs[idx].setter(&stack[sp], sys->regs[idx].cookie);
+}
+
+//-----------------------------------------------------------------------------
+static inline int print(idxType cnt)
+{
+  const sCode* val;
+
+  ENSURE_STACK(cnt + 1);
+  sp -= cnt + 1;
+
+  for (int i = 0; i <= cnt; i++)
+  {
+    val = &stack[sp + i];
+    switch (val->op)
+    {
+      case VAL_INTEGER:
+        printf("%d", val->iValue);
+        break;
+      case VAL_FLOAT:
+        printf("%f", val->fValue);
+        break;
+      case VAL_STRING:
+        ENSURE(val->str.start >= 0 && val->str.len >= 0 &&
+                   val->str.start + val->str.len <= strPoolLen,
+               ERR_EXEC_PRINT);
+        printf("%.*s", val->str.len, &strPool[val->str.start]);
+        break;
+      default:
+        printf("(%d)", val->op);
+        return ERR_EXEC_PRINT;
+    }
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int returnSub(idxType cnt)
+{
+  idxType res;
+  ENSURE_STACK(fp + 1);
+  ENSURE(stack[fp].op == VAL_LABEL, ERR_EXEC_CMD_INV);
+  sp  = fp - cnt;
+  res = stack[fp].lbl.lbl;
+  fp  = stack[fp].lbl.fp;
+  return res;
+}
+
+//-----------------------------------------------------------------------------
+static inline int letVar(int base, idxType dim)
+{
+  // CMD_LET_GLOBAL (base: absolute) and CMD_LET_LOCAL (base: fp relative)
+  iType idx = (dim > 0) ? castInt(&stack[sp - 2]) : 0;
+  if (dim > 0)  // Array
+  {
+    ENSURE_INDEX(idx, dim);
+    memcpy(&stack[sp - 2], &stack[sp - 1], sizeof(stack[0]));
+    sp--;
+  }
+  ENSURE(base >= 0 && base + idx < sp, ERR_EXEC_VAR_INV);
+  memcpy(&stack[base + idx], &stack[--sp], sizeof(stack[0]));
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int getVar(int base, idxType dim)
+{
+  iType idx = (dim > 0) ? castInt(&stack[--sp]) : 0;
+  if (dim > 0)
+    ENSURE_INDEX(idx, dim);
+  ENSURE(base >= 0 && base + idx < sp, ERR_EXEC_VAR_INV);
+  return pushCode(&stack[base + idx]);
+}
+
+//-----------------------------------------------------------------------------
+static inline int letPtr(idxType rel)
+{
+  sCode* ptr;
+  iType  idx;
+  sp -= 2;
+  ENSURE(fp + rel >= 0 && fp + rel < sp, ERR_EXEC_VAR_INV);
+  ptr = &stack[fp + rel];
+  ENSURE(ptr->op == VAL_PTR, ERR_EXEC_VAR_INV);
+  idx = castInt(&stack[sp]);
+  ENSURE_INDEX(idx, ptr->param2);
+  ENSURE(ptr->param >= 0 && ptr->param + idx < sp, ERR_EXEC_VAR_INV);
+  memcpy(&stack[ptr->param + idx], &stack[sp + 1], sizeof(stack[0]));
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int getPtr(idxType rel)
+{
+  sCode* ptr;
+  iType  idx;
+  ENSURE(fp + rel >= 0 && fp + rel < sp, ERR_EXEC_VAR_INV);
+  ptr = &stack[fp + rel];
+  ENSURE(ptr->op == VAL_PTR, ERR_EXEC_VAR_INV);
+  idx = castInt(&stack[--sp]);
+  ENSURE_INDEX(idx, ptr->param2);
+  ENSURE(ptr->param >= 0 && ptr->param + idx < sp, ERR_EXEC_VAR_INV);
+  return pushCode(&stack[ptr->param + idx]);
+}
+
+//-----------------------------------------------------------------------------
+static inline int createPtr(idxType rel, idxType dim)
+{
+  sCode value;
+  ENSURE(fp + rel >= 0 && fp + rel < sp, ERR_EXEC_VAR_INV);
+  if (stack[fp + rel].op == VAL_PTR)
+    return pushCode(&stack[fp + rel]);
+  value.op     = VAL_PTR;
+  value.param  = fp + rel;
+  value.param2 = dim;
+  return pushCode(&value);
+}
+
+//-----------------------------------------------------------------------------
+static inline int incVar(int idx, iType value)
+{
+  sCode* ptr;
+  ENSURE(idx >= 0 && idx < sp, ERR_EXEC_VAR_INV);
+  ptr = &stack[idx];
+  if (IS_INT(*ptr))
+  {
+    ptr->iValue += value;
+  }
+  else
+  {
+    ptr->fValue = castFloat(ptr) + value;
+    ptr->op     = VAL_FLOAT;
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int letInt(int idx, iType value)
+{
+  ENSURE(idx >= 0 && idx < sp, ERR_EXEC_VAR_INV);
+  stack[idx].op     = VAL_INTEGER;
+  stack[idx].iValue = value;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline sCode* slot(int idx)
+{
+  idx += fp;
+  return (idx >= 0 && idx < ARRAY_SIZE(stack)) ? &stack[idx] : NULL;
+}
+
+//-----------------------------------------------------------------------------
+static inline int move(int dst, int need, int src)
+{
+  sCode  value;
+  sCode* ptr;
+
+  ENSURE_NEED(need);
+  ptr = slot(src);
+  ENSURE(ptr, ERR_EXEC_VAR_INV);
+  memcpy(&value, ptr, sizeof(value));
+  ptr = slot(dst);
+  ENSURE(ptr, ERR_EXEC_VAR_INV);
+  memcpy(ptr, &value, sizeof(value));
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline int forTest(int idx)
+{
+  sCode* var;
+  ENSURE(idx >= 0 && idx < sp - 2, ERR_EXEC_VAR_INV);
+  var = &stack[idx];
+  if (castFloat(&stack[sp - 1]) < 0)
+    return COMPARE(*var, stack[sp - 2], >=);
+  return COMPARE(*var, stack[sp - 2], <=);
+}
+
+//-----------------------------------------------------------------------------
+static inline int forNext(int idx)
+{
+  sCode* var;
+  ENSURE(idx >= 0 && idx < sp - 2, ERR_EXEC_VAR_INV);
+  var = &stack[idx];
+  if (IS_INT(*var) && IS_INT(stack[sp - 1]))
+  {
+    var->iValue += stack[sp - 1].iValue;
+  }
+  else
+  {
+    var->fValue = castFloat(var) + castFloat(&stack[sp - 1]);
+    var->op     = VAL_FLOAT;
+  }
+  return forTest(idx);
+}
+
+//-----------------------------------------------------------------------------
+static inline int svc(idxType idx)
+{
+  ENSURE(idx >= 0 && idx < ARRAY_SIZE(sys->svcs) && sys->svcs[idx].func,
+         ERR_EXEC_SVC_INV);
+  ENSURE_STACK(sys->svcs[idx].argc + 1);
+  sp -= sys->svcs[idx].argc;
+  return sys->svcs[idx].func(&stack[sp - 1], &stack[0]);
+}
+
+//-----------------------------------------------------------------------------
+static inline int opNot(void)
+{
+  ENSURE_STACK(1);
+  sp -= 1;
+  return pushInt(~castInt(&stack[sp]));
+}
+
+//-----------------------------------------------------------------------------
+static inline int opDiv(void)
+{
+  ENSURE_STACK(2);
+  sp -= 2;
+  ENSURE(castFloat(&stack[sp + 1]) != 0.0f, ERR_EXEC_DIV_ZERO);
+  return pushFloat(castFloat(&stack[sp]) / castFloat(&stack[sp + 1]));
+}
+
+//-----------------------------------------------------------------------------
+static inline int opIdiv(void)
+{
+  ENSURE_STACK(2);
+  sp -= 2;
+  ENSURE(castInt(&stack[sp + 1]) != 0, ERR_EXEC_DIV_ZERO);
+  return pushInt(castInt(&stack[sp]) / castInt(&stack[sp + 1]));
+}
+
+//-----------------------------------------------------------------------------
+static inline int opPow(void)
+{
+  ENSURE_STACK(2);
+  sp -= 2;
+  if (IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
+    return pushInt(powf(stack[sp].iValue, stack[sp + 1].iValue) + 0.5f);
+  return pushFloat(powf(castFloat(&stack[sp]), castFloat(&stack[sp + 1])));
+}
+
+//-----------------------------------------------------------------------------
+static inline int opSign(void)
+{
+  ENSURE_STACK(1);
+  sp -= 1;
+  if (IS_INT(stack[sp]))
+    return pushInt(-stack[sp].iValue);
+  return pushFloat(-stack[sp].fValue);
+}
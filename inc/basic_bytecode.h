@@ -30,6 +30,51 @@ typedef enum
   CMD_GET_PTR,      //  X                         <rel>               -
   CMD_GET_REG,      //  X                         <reg>               +1
   CMD_CREATE_PTR,   //  X                         <rel>, <dim>        +1        Becomes VAL_PTR on stack
+  CMD_INC_GLOBAL,   //  X                         <abs>, <int>        -         Optimizer: var += int
+  CMD_INC_LOCAL,    //  X                         <rel>, <int>        -         Optimizer: var += int
+  CMD_LETI_GLOBAL,  //  X                         <abs>, <int>        -         Optimizer: var = int
+  CMD_LETI_LOCAL,   //  X                         <rel>, <int>        -         Optimizer: var = int
+  CMD_FOR_GLOBAL,   //  X                         <lbl>, <abs>        -         Limit, step on stack
+  CMD_FOR_LOCAL,    //  X                         <lbl>, <rel>        -         Limit, step on stack
+  CMD_NEXT_GLOBAL,  //  X                         <lbl>, <abs>        -         Limit, step on stack
+  CMD_NEXT_LOCAL,   //  X                         <lbl>, <rel>        -         Limit, step on stack
+  CMD_IF_NEQ,       //  X                         <lbl>               -2        Optimizer: OP_NEQ + CMD_IF
+  CMD_IF_LTEQ,      //  X                         <lbl>               -2        Optimizer: OP_LTEQ + CMD_IF
+  CMD_IF_GTEQ,      //  X                         <lbl>               -2        Optimizer: OP_GTEQ + CMD_IF
+  CMD_IF_LT,        //  X                         <lbl>               -2        Optimizer: OP_LT + CMD_IF
+  CMD_IF_GT,        //  X                         <lbl>               -2        Optimizer: OP_GT + CMD_IF
+  CMD_IF_EQUAL,     //  X                         <lbl>               -2        Optimizer: OP_EQUAL + CMD_IF
+  CMD_IF_NEQ_II,    //  X                         <lbl>               -2        Optimizer: CMD_IF_NEQ, both int
+  CMD_IF_LTEQ_II,   //  X                         <lbl>               -2        Optimizer: CMD_IF_LTEQ, both int
+  CMD_IF_GTEQ_II,   //  X                         <lbl>               -2        Optimizer: CMD_IF_GTEQ, both int
+  CMD_IF_LT_II,     //  X                         <lbl>               -2        Optimizer: CMD_IF_LT, both int
+  CMD_IF_GT_II,     //  X                         <lbl>               -2        Optimizer: CMD_IF_GT, both int
+  CMD_IF_EQUAL_II,  //  X                         <lbl>               -2        Optimizer: CMD_IF_EQUAL, both int
+  CMD_IF_NEQ_QI,    //  X                         <lbl>               -2        Quickened: CMD_IF_NEQ, int
+  CMD_IF_NEQ_QF,    //  X                         <lbl>               -2        Quickened: CMD_IF_NEQ, float
+  CMD_IF_LTEQ_QI,   //  X                         <lbl>               -2        Quickened: CMD_IF_LTEQ, int
+  CMD_IF_LTEQ_QF,   //  X                         <lbl>               -2        Quickened: CMD_IF_LTEQ, float
+  CMD_IF_GTEQ_QI,   //  X                         <lbl>               -2        Quickened: CMD_IF_GTEQ, int
+  CMD_IF_GTEQ_QF,   //  X                         <lbl>               -2        Quickened: CMD_IF_GTEQ, float
+  CMD_IF_LT_QI,     //  X                         <lbl>               -2        Quickened: CMD_IF_LT, int
+  CMD_IF_LT_QF,     //  X                         <lbl>               -2        Quickened: CMD_IF_LT, float
+  CMD_IF_GT_QI,     //  X                         <lbl>               -2        Quickened: CMD_IF_GT, int
+  CMD_IF_GT_QF,     //  X                         <lbl>               -2        Quickened: CMD_IF_GT, float
+  CMD_IF_EQUAL_QI,  //  X                         <lbl>               -2        Quickened: CMD_IF_EQUAL, int
+  CMD_IF_EQUAL_QF,  //  X                         <lbl>               -2        Quickened: CMD_IF_EQUAL, float
+  CMD_MOVE,         //  X                         <dst>:<n>, <a>      -         Slots: dst = a
+  CMD_IF_NEQ_SS,    //  X                         <lbl>, <a>:<b>      -         Slots: CMD_IF_NEQ, slot
+  CMD_IF_NEQ_SK,    //  X                         <lbl>, <a>:<k>      -         Slots: CMD_IF_NEQ, const
+  CMD_IF_LTEQ_SS,   //  X                         <lbl>, <a>:<b>      -         Slots: CMD_IF_LTEQ, slot
+  CMD_IF_LTEQ_SK,   //  X                         <lbl>, <a>:<k>      -         Slots: CMD_IF_LTEQ, const
+  CMD_IF_GTEQ_SS,   //  X                         <lbl>, <a>:<b>      -         Slots: CMD_IF_GTEQ, slot
+  CMD_IF_GTEQ_SK,   //  X                         <lbl>, <a>:<k>      -         Slots: CMD_IF_GTEQ, const
+  CMD_IF_LT_SS,     //  X                         <lbl>, <a>:<b>      -         Slots: CMD_IF_LT, slot
+  CMD_IF_LT_SK,     //  X                         <lbl>, <a>:<k>      -         Slots: CMD_IF_LT, const
+  CMD_IF_GT_SS,     //  X                         <lbl>, <a>:<b>      -         Slots: CMD_IF_GT, slot
+  CMD_IF_GT_SK,     //  X                         <lbl>, <a>:<k>      -         Slots: CMD_IF_GT, const
+  CMD_IF_EQUAL_SS,  //  X                         <lbl>, <a>:<b>      -         Slots: CMD_IF_EQUAL, slot
+  CMD_IF_EQUAL_SK,  //  X                         <lbl>, <a>:<k>      -         Slots: CMD_IF_EQUAL, const
   OP_NEQ,           //  X                         -                   -2+1
   OP_LTEQ,          //  X                         -                   -2+1
   OP_GTEQ,          //  X                         -                   -2+1
@@ -50,6 +95,27 @@ typedef enum
   OP_IDIV,          //  X                         -                   -2+1
   OP_POW,           //  X                         -                   -2+1
   OP_SIGN,          //  X                         -                   -1+1
+  OP_NEQ_II,        //  X                         -                   -2+1      Optimizer: OP_NEQ, both int
+  OP_LTEQ_II,       //  X                         -                   -2+1      Optimizer: OP_LTEQ, both int
+  OP_GTEQ_II,       //  X                         -                   -2+1      Optimizer: OP_GTEQ, both int
+  OP_LT_II,         //  X                         -                   -2+1      Optimizer: OP_LT, both int
+  OP_GT_II,         //  X                         -                   -2+1      Optimizer: OP_GT, both int
+  OP_EQUAL_II,      //  X                         -                   -2+1      Optimizer: OP_EQUAL, both int
+  OP_PLUS_II,       //  X                         -                   -2+1      Optimizer: OP_PLUS, both int
+  OP_MINUS_II,      //  X                         -                   -2+1      Optimizer: OP_MINUS, both int
+  OP_MULT_II,       //  X                         -                   -2+1      Optimizer: OP_MULT, both int
+  OP_PLUS_QI,       //  X                         -                   -2+1      Quickened: OP_PLUS, int
+  OP_PLUS_QF,       //  X                         -                   -2+1      Quickened: OP_PLUS, float
+  OP_MINUS_QI,      //  X                         -                   -2+1      Quickened: OP_MINUS, int
+  OP_MINUS_QF,      //  X                         -                   -2+1      Quickened: OP_MINUS, float
+  OP_MULT_QI,       //  X                         -                   -2+1      Quickened: OP_MULT, int
+  OP_MULT_QF,       //  X                         -                   -2+1      Quickened: OP_MULT, float
+  OP_PLUS_SS,       //  X                         <dst>:<n>, <a>:<b>  -         Slots: dst = a + b
+  OP_PLUS_SK,       //  X                         <dst>:<n>, <a>:<k>  -         Slots: dst = a + k
+  OP_MINUS_SS,      //  X                         <dst>:<n>, <a>:<b>  -         Slots: dst = a - b
+  OP_MINUS_SK,      //  X                         <dst>:<n>, <a>:<k>  -         Slots: dst = a - k
+  OP_MULT_SS,       //  X                         <dst>:<n>, <a>:<b>  -         Slots: dst = a * b
+  OP_MULT_SK,       //  X                         <dst>:<n>, <a>:<k>  -         Slots: dst = a * k
   VAL_ZERO,         //  X                         -                   +1
   VAL_INTEGER,      //  X                X        <int>               +1
   VAL_FLOAT,        //  X                X        <float>             +1
@@ -59,11 +125,32 @@ typedef enum
 } eOp;
 // clang-format on
 
+//-----------------------------------------------------------------------------
+// Slot instructions (three-address): operands are frame slots (fp relative)
+// or constants, <a> and <b>/<k> are packed into param2 with 8 bit each.
+// <dst> is packed with <n> into param: the stack entries above sp the
+// replaced stack code needed (2 for a compare without <dst>)
+#define SLOT_PACK(a, b)   ((idxType)(((a) & 0xFF) | (((b) & 0xFF) << 8)))
+#define SLOT_A(param2)    ((int8_t)((param2) & 0xFF))
+#define SLOT_B(param2)    ((int8_t)(((param2) >> 8) & 0xFF))
+#define SLOT_DST(param)   SLOT_A(param)
+#define SLOT_NEED(param)  SLOT_B(param)
+#define SLOT_NEED_IF      2
+#define SLOT_FITS(x)      ((x) >= INT8_MIN && (x) <= INT8_MAX)
+
 //-----------------------------------------------------------------------------
 typedef int32_t iType;     // Integer value
 typedef float   fType;     // Float value
+#if BASIC_LARGE
+typedef int32_t idxType;   // Code/var/reg/str index
+typedef int32_t sLenType;  // String length
+#else
 typedef int16_t idxType;   // Code/var/reg/str index
 typedef int16_t sLenType;  // String length
+#if CODE_MEM > INT16_MAX || STRING_MEM > INT16_MAX
+#error "CODE_MEM and STRING_MEM > 32767 need BASIC_LARGE"
+#endif
+#endif
 
 //-----------------------------------------------------------------------------
 typedef struct sCode
@@ -76,7 +163,7 @@ typedef struct sCode
     struct             //
     {                  //
       idxType param;   // var (VAR, LET), reg (REG, SET), lbl (IF, GOTO, GOSUB)
-      idxType param2;  // dim (VAR, LET)
+      idxType param2;  // dim (VAR, LET), var (FOR, NEXT)
     };                 //
     struct             // VAL_STRING
     {                  //
@@ -122,6 +209,7 @@ typedef struct
 typedef struct
 {
   char (*getNextChar)(void);
+  void (*echo)(char c);
   int (*newCode)(sCodeIdx* code, eOp op);
   int (*addCode)(const sCode* code);
   int (*setCode)(const sCodeIdx* code);
@@ -130,6 +218,7 @@ typedef struct
   int (*getCodeLen)(eOp op);
   int (*setString)(const char* str, unsigned int len);
   int (*getString)(const char** str, int start, unsigned int len);
+  int (*getTick)(void);
   sReg regs[MAX_REG_NUM];
   sSvc svcs[MAX_SVC_NUM];
 } sSys;
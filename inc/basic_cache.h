@@ -0,0 +1,18 @@
+#pragma once
+
+#include "basic_image.h"
+#include <stdint.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define ERR_CACHE_MISS  -1200  // No image of the source in the cache
+#define ERR_CACHE_WRITE -1201  // Can't write to the cache
+
+//=============================================================================
+// Functions
+//=============================================================================
+uint64_t cache_key(const sSys* sys, const char* source, int len);
+int      cache_load(const char* prefix, uint64_t key, void* buf, int size);
+int      cache_store(const sSys* sys, const char* prefix, uint64_t key,
+                     const sImage* image);
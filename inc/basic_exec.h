@@ -21,8 +21,44 @@
 
 #define ERR_EXEC_OUT_BOUND -813  // Index out of bound
 
+//-----------------------------------------------------------------------------
+// exec_run() reasons
+//-----------------------------------------------------------------------------
+#define EXEC_RUN_BUDGET    0  // Instruction budget used up
+#define EXEC_RUN_TIMEOUT   1  // Time slice expired
+#define EXEC_RUN_YIELD     2  // SVC requested to yield (e.g. Sleep)
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+typedef struct
+{
+  sCode   code;  // Decoded instruction
+  idxType idx;   // Code index of the instruction (-1: empty)
+  idxType next;  // Code index of the next instruction
+} sDecoded;
+
+//-----------------------------------------------------------------------------
+// State of one running program, owned by the caller (e.g. static)
+typedef struct
+{
+  sCode   stack[STACK_SIZE];  // Variables, frames and expression values
+  idxType sp;                 // Stack pointer
+  idxType fp;                 // Frame pointer
+#if EXEC_DECODE_CACHE > 0
+  sDecoded cache[EXEC_DECODE_CACHE];  // Decoded instructions
+#endif
+#if STAT
+  uint32_t dispatchCnt;  // Executed instructions
+#endif
+} sVm;
+
 //=============================================================================
 // Functions
 //=============================================================================
-int  exec(sSys* sys, idxType pc);
-void exec_reset(void);
+int  exec(sVm* vm, sSys* sys, idxType pc);
+int  exec_run(sVm* vm, sSys* sys, idxType* pc, int budget, int timeout);
+int  exec_decode(sVm* vm, sSys* sys);
+void exec_stat(const sVm* vm);
+void exec_reset(sVm* vm);
+void exec_flush(const sSys* sys);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "basic_bytecode.h"
+#include <stdbool.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define ERR_IMAGE_MAGIC     -1100  // Not an image (or other byte order)
+#define ERR_IMAGE_VERSION   -1101  // Other image version or instruction set
+#define ERR_IMAGE_SIZE      -1102  // Image truncated or too large
+#define ERR_IMAGE_CRC       -1103  // Image corrupted
+#define ERR_IMAGE_SIGNATURE -1104  // Registers, SVCs or code format differ
+
+#define IMAGE_MAGIC   0x4342636D  // "mcBC"
+#define IMAGE_VERSION 2
+
+// Size of an image [bytes]
+#define IMAGE_SIZE(codeLen, strLen)                                            \
+  ((int)sizeof(sImageHeader) + (int)(codeLen) + (int)(strLen))
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// Header of an image, followed by the code and the string section
+typedef struct
+{
+  uint32_t magic;      // IMAGE_MAGIC
+  uint16_t version;    // IMAGE_VERSION
+  uint16_t ops;        // Number of operators (instruction set)
+  uint32_t signature;  // Registers, SVCs and code format of the sSys
+  uint32_t codeLen;    // Size of the code section [bytes]
+  uint32_t strLen;     // Size of the string section [bytes]
+  uint32_t crc;        // CRC-32 of the header (up to here) and the sections
+} sImageHeader;
+
+//-----------------------------------------------------------------------------
+// Program in memory (RAM, flash or a mapped file)
+typedef struct
+{
+  const char* code;
+  int         codeLen;
+  const char* strings;
+  int         strLen;
+} sImage;
+
+//=============================================================================
+// Functions
+//=============================================================================
+uint32_t image_crc(uint32_t crc, const void* data, int len);
+int      image_codeLen(eOp op);
+bool     image_isJump(eOp op);
+uint32_t image_signature(const sSys* sys);
+int      image_header(const sSys* sys, const sImage* image,
+                      sImageHeader* header);
+int      image_open(const sSys* sys, const void* data, int size, sImage* image);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "basic_bytecode.h"
+#include <stdbool.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+// Template JIT, only for x86-64 Linux hosts (e.g. simulations of a device)
+#if EXEC_JIT && defined(__x86_64__) && defined(__linux__)
+#define JIT 1
+#else
+#define JIT 0
+#endif
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+typedef struct
+{
+  sCode*   stack;   // Stack of the interpreter
+  int32_t  sp;      // Stack pointer
+  int32_t  fp;      // Frame pointer
+  int32_t  pc;      // In: next instruction, out: continue interpreter here
+  int32_t  budget;  // Instruction budget (see exec_run())
+  uint32_t cnt;     // Out: executed instructions
+} sJitState;
+
+//=============================================================================
+// Functions
+//=============================================================================
+#if JIT
+int  jit_enter(const sSys* sys, sJitState* state, bool call);
+void jit_enable(bool enable);
+void jit_reset(const sSys* sys);
+#endif
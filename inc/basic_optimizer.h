@@ -1,8 +1,70 @@
 #pragma once
 
 #include "basic_bytecode.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define ERR_VERIFY_STACK -700  // Stack unbalanced or underflow
+#define ERR_VERIFY_DEPTH -701  // Stack may overflow (or recursion)
+#define ERR_VERIFY_JUMP  -702  // Invalid jump target
+#define ERR_VERIFY_REG   -703  // Invalid register
+#define ERR_VERIFY_SVC   -704  // Invalid buildin function
+#define ERR_VERIFY_CMD   -705  // Invalid instruction
+#define ERR_VERIFY_LIMIT -706  // Program too complex to verify
+
+#define OPT_BLOCK 32  // Bytes per entry of the code index (BASIC_LARGE)
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+typedef struct sTarget sTarget;
+
+//-----------------------------------------------------------------------------
+typedef struct
+{
+  idxType  depth;  // Stack depth (relative to fp)
+  uint32_t ints;   // Stack entries known to be VAL_INTEGER (bit n: entry n)
+  sTarget* sub;    // Current sub, fp unknown -> globals unknown (NULL: main)
+} sTypes;
+
+//-----------------------------------------------------------------------------
+struct sTarget
+{
+  idxType idx;    // Code index of jump target
+  idxType argc;   // Sub entry: number of arguments, else -1
+  idxType need;   // Sub entry: max. stack depth (relative to fp)
+  bool    valid;  // Types known
+  sTypes  types;  // Types at jump target
+};
+
+//-----------------------------------------------------------------------------
+// State of one optimization or verification, owned by the caller. Each
+// thread needs its own one
+typedef struct
+{
+#if OPT_MAX_TARGETS > 0
+  sTarget  targets[OPT_MAX_TARGETS];
+#endif
+  int      targetCnt;
+  uint32_t subWrites;  // Globals a sub can set to a non integer
+  idxType  mainNeed;   // Max. stack depth of the main program
+#if BASIC_LARGE
+  // Index of the code of a pass, instead of scans of the whole code
+  uint32_t jumpTo[CODE_MEM / 32 + 1];             // Bit n: jump target n
+  idxType  blockInstr[CODE_MEM / OPT_BLOCK + 1];  // First instruction
+  idxType  blockNops[CODE_MEM / OPT_BLOCK + 1];   // NOPs in front of it
+#endif
+} sOptimizer;
 
 //=============================================================================
 // Functions
 //=============================================================================
+int optimize_code(sOptimizer* o, const sSys* system);
+int optimize_verify(sOptimizer* o, const sSys* system, int len);
+
+// Same with a static sOptimizer (only one at a time)
 int optimize(const sSys* system);
+int verify(const sSys* system, int len);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "basic_bytecode.h"
+#include <stdbool.h>
+#include <stdint.h>
 
 //=============================================================================
 // Defines
@@ -48,11 +50,110 @@
 #define ERR_NOT_ARRAY       -41   // Variable is not an array
 #define ERR_ARRAY           -42   // Variable is an array
 #define ERR_ARRAY_NOT_FOUND -43   // Array not found (Sub called with brackets?)
+#define ERR_PARSE_ARENA     -44   // Arena too small for the parser tables
 #define ERR_NOT_IMPL        -999  // Not implemented yet
 
+#define READ_AHEAD    (MAX_NAME + 2)    // Chars the parser looks ahead
+#define READ_BUF_SIZE (4 * READ_AHEAD)  // Previous char and read ahead
+
+// Working memory of a compilation, see parse_arena() [bytes]
+#if BASIC_LARGE
+#define PARSE_HASH_NUM                                                         \
+  (3 * (MAX_VAR_NUM + MAX_LABELS + MAX_SUB_NUM + MAX_REG_NUM + MAX_SVC_NUM))
+#else
+#define PARSE_HASH_NUM 0
+#endif
+#define PARSE_ARENA_SIZE                                                       \
+  ((3 * MAX_VAR_NUM + MAX_LABELS + 2 * MAX_SUB_NUM + PARSE_HASH_NUM + 1) *     \
+       sizeof(idxType) +                                                       \
+   (MAX_VAR_NUM + MAX_LABELS + MAX_SUB_NUM) * MAX_NAME + READ_BUF_SIZE + 1)
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// State of one compilation (parse and link), owned by the caller. Each
+// thread needs its own one (and its own sSys). The tables are in the arena
+// (see parse_arena())
+typedef struct
+{
+  // Arena
+  char* arena;
+  int   arenaSize;
+  int   arenaUsed;
+
+  // Names
+  char (*varName)[MAX_NAME];
+  idxType* varIndex;
+  idxType* varLevel;
+  idxType* varDim;
+  char (*labels)[MAX_NAME];
+  idxType* labelDst;
+  char (*subName)[MAX_NAME];
+  idxType* subLabel;
+  idxType* subArgc;
+  int      varCnt;          // Slots in use, the ones of a block at the end
+  int      lblCnt;          // Slots in use (never freed)
+  int      subCnt;          // Slots in use (never freed)
+  char     name[MAX_NAME];  // Last name read (see namecon())
+#if STAT
+  idxType maxVarNum;
+  int     strBytes;  // Bytes of all string literals (before dedup)
+#endif
+#if BASIC_LARGE
+  // Hash chains of the name tables (-1: end), 2 buckets per entry
+  idxType* varHead;
+  idxType* varNext;
+  idxType* lblHead;
+  idxType* lblNext;
+  idxType* subHead;
+  idxType* subNext;
+  idxType* regHead;
+  idxType* regNext;
+  idxType* svcHead;
+  idxType* svcNext;
+#endif
+  bool optionExplicit;
+
+  // Blocks
+  char    exitLabel[2];
+  idxType spAtBeginOfDo;
+  idxType spAtBeginOfFor;
+  idxType exitDo;
+  idxType exitFor;
+  int     curArgc;
+  int     sp;  // Stack pointer tracking
+  int     level;
+
+  // Source
+  const sSys* sys;
+  const char* s;
+  int         lineNum;
+  int         lineCol;
+  char*       readBuf;  // READ_BUF_SIZE + 1, terminated by a NUL byte
+  char*       readEnd;
+  bool        quote;
+  const char* mem;     // Source in memory (see parse_mem())
+  const char* memEnd;  //
+  int         pos;     // Number of read chars
+  int         opPos;   // Position of opMask
+  uint32_t    opMask;  // Operators at opPos (see opTokens())
+} sParser;
+
 //=============================================================================
 // Functions
 //=============================================================================
+int  parse_arena(sParser* p, void* arena, int size);
+int  parse_all(sParser* p, const sSys* system, int* errline, int* errcol);
+int  parse_mem(sParser* p, const sSys* system, const char* source, int len,
+               int* errline, int* errcol);
+int  parse_link(sParser* p, const sSys* system);
+void parse_stat(const sParser* p, int codeSize, int strSize);
+
+#if PARSE_STATIC
+// Same with a static sParser and arena (only one compilation at a time)
 int  parseAll(const sSys* system, int* errline, int* errcol);
+int  parseMem(const sSys* system, const char* source, int len, int* errline,
+              int* errcol);
 int  link(const sSys* system);
 void parseStat(int codeSize, int strSize);
+#endif
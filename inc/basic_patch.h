@@ -0,0 +1,84 @@
+#pragma once
+
+#include "basic_image.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define ERR_PATCH_MAGIC -1400  // Not a patch
+#define ERR_PATCH_BASE  -1401  // Patch for another image
+#define ERR_PATCH_SIZE  -1402  // Too many parts or new image too large
+#define ERR_PATCH_DATA  -1403  // Patch corrupted, truncated or too long
+#define ERR_PATCH_CRC   -1404  // New image corrupted (CRC)
+#define ERR_PATCH_WRITE -1405  // Can't write the new image
+
+#define PATCH_MAGIC   0x5042636D  // "mcBP"
+#define PATCH_VERSION 1
+
+#if PATCH_MAX_SEGS > 255
+#error "PATCH_MAX_SEGS > 255 doesn't fit into sPatchHeader"
+#endif
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// Header of a patch, followed by the header of the new image, the parts of
+// the code and the string section (sorted by 'to') and the records of the
+// sections. A record is a LEB128 of (bytes << 1 | copy): copied from the old
+// image (in a part) or followed by the bytes
+typedef struct
+{
+  uint32_t magic;     // PATCH_MAGIC
+  uint16_t version;   // PATCH_VERSION
+  uint8_t  codeSegs;  // Parts of the code section
+  uint8_t  strSegs;   // Parts of the string section
+  uint32_t oldCrc;    // CRC of the old image (sImageHeader.crc)
+  uint32_t newCrc;    // CRC-32 of the whole new image
+} sPatchHeader;
+
+//-----------------------------------------------------------------------------
+// Part of a section which corresponds to the old image, most of it is
+// copied. Code parts start at an instruction, jump targets and string
+// addresses are moved like the part in front of them
+typedef struct
+{
+  uint32_t from;  // Index in the old section
+  uint32_t to;    // Index in the new section
+  uint32_t len;   // [bytes]
+} sPatchSeg;
+
+//-----------------------------------------------------------------------------
+// Writes the next bytes of the new image, returns false on errors
+typedef bool (*fPatchWrite)(void* ctx, const void* data, int len);
+
+//-----------------------------------------------------------------------------
+// Patch applied while it's received (see patch_feed()), owned by the caller
+typedef struct
+{
+  sImage       old;    // Image to patch (read only)
+  uint32_t     oldCrc;
+  fPatchWrite  write;
+  void*        ctx;
+  sPatchHeader header;
+  sImageHeader image;  // Header of the new image
+  sPatchSeg    segs[PATCH_MAX_SEGS];
+  int          fill;   // Bytes of header, image and segs received
+  uint32_t     rec;    // Record header received so far
+  int          shift;  // - bits of it
+  uint32_t     run;    // Bytes left of the record
+  bool         copy;   // - copied from the old image
+  uint32_t     pos;    // Bytes of the new image written
+  uint32_t     size;   // Size of the new image
+  uint32_t     crc;    // CRC-32 of the bytes written
+} sPatcher;
+
+//=============================================================================
+// Functions
+//=============================================================================
+int  patch_init(sPatcher* p, const void* old, int size, fPatchWrite write,
+                void* ctx);
+int  patch_feed(sPatcher* p, const void* data, int len);
+void patch_reloc(const sPatchSeg* segs, int codeSegs, int strSegs,
+                 sCode* code);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "basic_exec.h"
+#include "basic_image.h"
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define ERR_RELOAD_MAIN    -1300  // Code outside of the Subs changed (restart)
+#define ERR_RELOAD_BUSY    -1301  // Sub running (retry after the next step)
+#define ERR_RELOAD_STRINGS -1302  // Strings of the running program changed
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// Subs of a program: GOTO over the Sub, entry (target of a GOSUB) .. RETURN
+typedef struct
+{
+  idxType start[MAX_SUB_NUM];  // Index of the GOTO
+  idxType end[MAX_SUB_NUM];    // Index behind the RETURN
+  int     cnt;
+} sReloadSubs;
+
+//-----------------------------------------------------------------------------
+// Differences of two versions (see reload_map()), owned by the caller
+typedef struct
+{
+  sReloadSubs cur;      // Running program
+  sReloadSubs next;     // New version
+  int         changed;  // Subs with other code
+} sReload;
+
+//=============================================================================
+// Functions
+//=============================================================================
+int reload_map(sReload* r, const sImage* cur, const sImage* next);
+int reload_pc(const sReload* r, const sVm* vm, idxType* pc);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "basic_exec.h"
+
+//=============================================================================
+// Defines
+//=============================================================================
+// Scheduler for many programs on a pool of threads, only for Linux hosts
+// (e.g. a simulation of many devices)
+#if defined(__linux__)
+#define SCHED 1
+#else
+#define SCHED 0
+#endif
+
+#define ERR_SCHED_WORKERS -1000  // Invalid number of workers
+
+#if SCHED
+#include <pthread.h>
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// One program instance, owned by the caller (see sched_add())
+typedef struct sSchedVm
+{
+  sVm              vm;     // State of the interpreter
+  sSys*            sys;    // Program (can be shared by instances)
+  idxType          pc;     // Next instruction
+  int              res;    // Result after it ended (ERR_EXEC_END: success)
+  int              sleep;  // Requested sleep [ms] (see sched_sleep())
+  int              wake;   // Tick to continue a sleeping instance
+  struct sSchedVm* next;   // Run queue or timer slot
+} sSchedVm;
+
+//-----------------------------------------------------------------------------
+// Worker thread with its run queue (FIFO)
+typedef struct
+{
+  struct sSched*  sched;
+  pthread_t       thread;
+  pthread_mutex_t lock;
+  sSchedVm*       head;
+  sSchedVm*       tail;
+  int             cnt;
+} sSchedWorker;
+
+//-----------------------------------------------------------------------------
+typedef struct sSched
+{
+  sSchedWorker    workers[SCHED_MAX_WORKERS];
+  int             workerCnt;
+  int             next;      // Worker for the next added instance
+  int             active;    // Instances not ended yet
+  int             failed;    // Instances ended by an error
+  pthread_mutex_t idleLock;  // Idle workers wait for work
+  pthread_cond_t  idle;
+  pthread_mutex_t timerLock;
+  sSchedVm*       wheel[SCHED_WHEEL];  // Sleeping instances by wake tick
+  int             tick;                // Last processed tick of the wheel
+} sSched;
+
+//=============================================================================
+// Functions
+//=============================================================================
+int  sched_init(sSched* sched, int workers);
+void sched_add(sSched* sched, sSchedVm* inst, sSys* sys, idxType pc);
+int  sched_run(sSched* sched);
+void sched_sleep(int ms);
+#endif
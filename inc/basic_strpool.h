@@ -0,0 +1,35 @@
+#pragma once
+
+#include "basic_bytecode.h"
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define STRPOOL_GRAM    4     // Leading bytes of a position in the index
+#define STRPOOL_BUCKETS 4096  // Hash buckets per gram length
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// String section of a program, literals share bytes with equal or
+// overlapping ones
+typedef struct
+{
+  char* mem;   // Strings
+  int   size;  // Size of mem [bytes]
+  int   len;   // Used [bytes]
+#if BASIC_LARGE
+  // Positions in ascending order by hash of their first 1..STRPOOL_GRAM
+  // bytes (-1: end)
+  idxType head[STRPOOL_GRAM][STRPOOL_BUCKETS];
+  idxType tail[STRPOOL_GRAM][STRPOOL_BUCKETS];
+  idxType next[STRPOOL_GRAM][STRING_MEM];
+#endif
+} sStrPool;
+
+//=============================================================================
+// Functions
+//=============================================================================
+void strpool_init(sStrPool* pool, char* mem, int size);
+int  strpool_add(sStrPool* pool, const char* str, int len);
+void strpool_reuse(sStrPool* pool, int len);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "basic_bytecode.h"
+#include <stdio.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define ERR_AOT_CMD   -900  // Invalid instruction
+#define ERR_AOT_JUMP  -901  // Invalid jump target
+#define ERR_AOT_LIMIT -902  // Too many subs
+#define ERR_AOT_WRITE -903  // Can't write output
+
+//=============================================================================
+// Functions
+//=============================================================================
+int transpile(const sSys* system, int len, const char* name, FILE* file);
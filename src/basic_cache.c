@@ -0,0 +1,104 @@
+#include "basic_cache.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include <inttypes.h>
+#include <stdio.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define FNV_OFFSET 0xCBF29CE484222325ull
+#define FNV_PRIME  0x00000100000001B3ull
+
+//=============================================================================
+// Private variables
+//=============================================================================
+// Limits and options which change the bytecode of a source (or if it
+// compiles at all)
+// clang-format off
+static const int32_t config[] =
+{
+  IMAGE_VERSION, sizeof(sCode), sizeof(idxType),
+  CODE_MEM, STRING_MEM, MAX_REG_NUM, MAX_SVC_NUM, MAX_NAME,
+  MAX_VAR_NUM, MAX_SUB_NUM, MAX_LABELS, MAX_STRING,
+  STACK_SIZE, OPT_MAX_TARGETS, OPT_SLOTS,
+};
+// clang-format on
+
+// Strings of the configuration the parser writes into the image
+static const char eol[] = BASIC_OUT_EOL;  // String section (Print)
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static uint64_t fnv1a(uint64_t hash, const void* data, int len)
+{
+  const uint8_t* p = data;
+  while (len-- > 0)
+    hash = (hash ^ *p++) * FNV_PRIME;
+  return hash;
+}
+
+//-----------------------------------------------------------------------------
+static void path(char* buf, const char* prefix, uint64_t key, const char* ext)
+{
+  snprintf(buf, FILENAME_MAX, "%s%016" PRIx64 "%s", prefix, key, ext);
+}
+
+//=============================================================================
+// Public functions
+//=============================================================================
+uint64_t cache_key(const sSys* sys, const char* source, int len)
+{
+  // Content address of the image: source, configuration and signature of
+  // the registers and SVCs
+  uint32_t signature = image_signature(sys);
+  uint64_t hash      = fnv1a(FNV_OFFSET, config, sizeof(config));
+  hash               = fnv1a(hash, eol, sizeof(eol));
+  hash               = fnv1a(hash, &signature, sizeof(signature));
+  return fnv1a(hash, source, len);
+}
+
+//-----------------------------------------------------------------------------
+int cache_load(const char* prefix, uint64_t key, void* buf, int size)
+{
+  // Reads the image <prefix><key>.bin, returns its size. It still has to be
+  // checked by image_open() (e.g. written only partially)
+  char  name[FILENAME_MAX];
+  FILE* f;
+  int   len;
+
+  path(name, prefix, key, ".bin");
+  f = fopen(name, "rb");
+  ENSURE(f, ERR_CACHE_MISS);
+  len = fread(buf, 1, size, f);
+  fclose(f);
+  ENSURE(len > 0, ERR_CACHE_MISS);
+  return len;
+}
+
+//-----------------------------------------------------------------------------
+int cache_store(const sSys* sys, const char* prefix, uint64_t key,
+                const sImage* image)
+{
+  // Written to a temporary file first, readers see the old or the complete
+  // image only
+  char         name[FILENAME_MAX];
+  char         temp[FILENAME_MAX];
+  sImageHeader header;
+  FILE*        f;
+  int          ok;
+
+  CHECK(image_header(sys, image, &header));
+  path(name, prefix, key, ".bin");
+  path(temp, prefix, key, ".tmp");
+  f = fopen(temp, "wb");
+  ENSURE(f, ERR_CACHE_WRITE);
+  ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+       fwrite(image->code, 1, image->codeLen, f) == (size_t)image->codeLen &&
+       fwrite(image->strings, 1, image->strLen, f) == (size_t)image->strLen;
+  ok = (fclose(f) == 0) && ok && rename(temp, name) == 0;
+  if (!ok)
+    remove(temp);
+  return ok ? 0 : ERR_CACHE_WRITE;
+}
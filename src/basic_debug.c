@@ -1,7 +1,14 @@
 #include "basic_debug.h"
 #include "basic_bytecode.h"
+#include "basic_cache.h"
 #include "basic_config.h"
+#include "basic_image.h"
+#include "basic_optimizer.h"
 #include "basic_parser.h"
+#include "basic_patch.h"
+#include "basic_reload.h"
+#include "basic_sched.h"
+#include "basic_transpile.h"
 #include <stdbool.h>
 #include <stdio.h>
 
@@ -31,6 +38,51 @@ static const char* opStr(eOp op)
     case CMD_GET_PTR:   return "GetPtr";
     case CMD_GET_REG:   return "GetReg";
     case CMD_CREATE_PTR:return "CreatPtr";
+    case CMD_INC_GLOBAL:return "IncGlobl";
+    case CMD_INC_LOCAL: return "IncLocal";
+    case CMD_LETI_GLOBAL:return "LetIGlbl";
+    case CMD_LETI_LOCAL:return "LetILocl";
+    case CMD_FOR_GLOBAL:return "ForGlobl";
+    case CMD_FOR_LOCAL: return "ForLocal";
+    case CMD_NEXT_GLOBAL:return "NextGlbl";
+    case CMD_NEXT_LOCAL:return "NextLocl";
+    case CMD_IF_NEQ:    return "If<>";
+    case CMD_IF_LTEQ:   return "If<=";
+    case CMD_IF_GTEQ:   return "If>=";
+    case CMD_IF_LT:     return "If<";
+    case CMD_IF_GT:     return "If>";
+    case CMD_IF_EQUAL:  return "If=";
+    case CMD_IF_NEQ_II:return "If<>ii";
+    case CMD_IF_LTEQ_II:return "If<=ii";
+    case CMD_IF_GTEQ_II:return "If>=ii";
+    case CMD_IF_LT_II:return "If<ii";
+    case CMD_IF_GT_II:return "If>ii";
+    case CMD_IF_EQUAL_II:return "If=ii";
+    case CMD_IF_NEQ_QI:return "If<>qi";
+    case CMD_IF_NEQ_QF:return "If<>qf";
+    case CMD_IF_LTEQ_QI:return "If<=qi";
+    case CMD_IF_LTEQ_QF:return "If<=qf";
+    case CMD_IF_GTEQ_QI:return "If>=qi";
+    case CMD_IF_GTEQ_QF:return "If>=qf";
+    case CMD_IF_LT_QI:return "If<qi";
+    case CMD_IF_LT_QF:return "If<qf";
+    case CMD_IF_GT_QI:return "If>qi";
+    case CMD_IF_GT_QF:return "If>qf";
+    case CMD_IF_EQUAL_QI:return "If=qi";
+    case CMD_IF_EQUAL_QF:return "If=qf";
+    case CMD_MOVE:      return "Move";
+    case CMD_IF_NEQ_SS:return "If<>ss";
+    case CMD_IF_NEQ_SK:return "If<>sk";
+    case CMD_IF_LTEQ_SS:return "If<=ss";
+    case CMD_IF_LTEQ_SK:return "If<=sk";
+    case CMD_IF_GTEQ_SS:return "If>=ss";
+    case CMD_IF_GTEQ_SK:return "If>=sk";
+    case CMD_IF_LT_SS:return "If<ss";
+    case CMD_IF_LT_SK:return "If<sk";
+    case CMD_IF_GT_SS:return "If>ss";
+    case CMD_IF_GT_SK:return "If>sk";
+    case CMD_IF_EQUAL_SS:return "If=ss";
+    case CMD_IF_EQUAL_SK:return "If=sk";
     case LNK_GOTO:      return "GoTo*";
     case LNK_GOSUB:     return "GoSub*";
     case OP_NEQ:        return "<>";
@@ -53,6 +105,27 @@ static const char* opStr(eOp op)
     case OP_IDIV:       return "\\";
     case OP_POW:        return "^";
     case OP_SIGN:       return "Sign";
+    case OP_NEQ_II: return "<>ii";
+    case OP_LTEQ_II:return "<=ii";
+    case OP_GTEQ_II:return ">=ii";
+    case OP_LT_II:  return "<ii";
+    case OP_GT_II:  return ">ii";
+    case OP_EQUAL_II:return "=ii";
+    case OP_PLUS_II:return "+ii";
+    case OP_MINUS_II:return "-ii";
+    case OP_MULT_II:return "*ii";
+    case OP_PLUS_QI:return "+qi";
+    case OP_PLUS_QF:return "+qf";
+    case OP_MINUS_QI:return "-qi";
+    case OP_MINUS_QF:return "-qf";
+    case OP_MULT_QI:return "*qi";
+    case OP_MULT_QF:return "*qf";
+    case OP_PLUS_SS:return "+ss";
+    case OP_PLUS_SK:return "+sk";
+    case OP_MINUS_SS:return "-ss";
+    case OP_MINUS_SK:return "-sk";
+    case OP_MULT_SS:return "*ss";
+    case OP_MULT_SK:return "*sk";
     case VAL_ZERO:      return "ZERO";
     case VAL_INTEGER:   return "INT";
     case VAL_FLOAT:     return "FLOAT";
@@ -83,6 +156,30 @@ static void printCmd(const sSys* sys, idxType i, sCode* c)
     case CMD_SVC:
     case CMD_GET_PTR:
     case CMD_GET_REG:
+    case CMD_IF_NEQ:
+    case CMD_IF_LTEQ:
+    case CMD_IF_GTEQ:
+    case CMD_IF_LT:
+    case CMD_IF_GT:
+    case CMD_IF_EQUAL:
+    case CMD_IF_NEQ_II:
+    case CMD_IF_LTEQ_II:
+    case CMD_IF_GTEQ_II:
+    case CMD_IF_LT_II:
+    case CMD_IF_GT_II:
+    case CMD_IF_EQUAL_II:
+    case CMD_IF_NEQ_QI:
+    case CMD_IF_NEQ_QF:
+    case CMD_IF_LTEQ_QI:
+    case CMD_IF_LTEQ_QF:
+    case CMD_IF_GTEQ_QI:
+    case CMD_IF_GTEQ_QF:
+    case CMD_IF_LT_QI:
+    case CMD_IF_LT_QF:
+    case CMD_IF_GT_QI:
+    case CMD_IF_GT_QF:
+    case CMD_IF_EQUAL_QI:
+    case CMD_IF_EQUAL_QF:
       printf("%3d: %-8s (%5d)", i, opStr(c->op), c->param);
       break;
     case CMD_LET_GLOBAL:
@@ -93,6 +190,41 @@ static void printCmd(const sSys* sys, idxType i, sCode* c)
     case VAL_PTR:
       printf("%3d: %-8s (%-2d%3d)", i, opStr(c->op), c->param2, c->param);
       break;
+    case CMD_INC_GLOBAL:
+    case CMD_INC_LOCAL:
+    case CMD_LETI_GLOBAL:
+    case CMD_LETI_LOCAL:
+    case CMD_FOR_GLOBAL:
+    case CMD_FOR_LOCAL:
+    case CMD_NEXT_GLOBAL:
+    case CMD_NEXT_LOCAL:
+      printf("%3d: %-8s (%3d%4d)", i, opStr(c->op), c->param, c->param2);
+      break;
+    case CMD_IF_NEQ_SS:
+    case CMD_IF_NEQ_SK:
+    case CMD_IF_LTEQ_SS:
+    case CMD_IF_LTEQ_SK:
+    case CMD_IF_GTEQ_SS:
+    case CMD_IF_GTEQ_SK:
+    case CMD_IF_LT_SS:
+    case CMD_IF_LT_SK:
+    case CMD_IF_GT_SS:
+    case CMD_IF_GT_SK:
+    case CMD_IF_EQUAL_SS:
+    case CMD_IF_EQUAL_SK:
+      printf("%3d: %-8s (%3d%4d%4d)", i, opStr(c->op), c->param,
+             SLOT_A(c->param2), SLOT_B(c->param2));
+      break;
+    case CMD_MOVE:
+    case OP_PLUS_SS:
+    case OP_PLUS_SK:
+    case OP_MINUS_SS:
+    case OP_MINUS_SK:
+    case OP_MULT_SS:
+    case OP_MULT_SK:
+      printf("%3d: %-8s (%3d%4d%4d)", i, opStr(c->op), SLOT_DST(c->param),
+             SLOT_A(c->param2), SLOT_B(c->param2));
+      break;
     case CMD_NOP:
     case CMD_END:
     case OP_NEQ:
@@ -115,6 +247,21 @@ static void printCmd(const sSys* sys, idxType i, sCode* c)
     case OP_POW:
     case OP_NOT:
     case OP_SIGN:
+    case OP_NEQ_II:
+    case OP_LTEQ_II:
+    case OP_GTEQ_II:
+    case OP_LT_II:
+    case OP_GT_II:
+    case OP_EQUAL_II:
+    case OP_PLUS_II:
+    case OP_MINUS_II:
+    case OP_MULT_II:
+    case OP_PLUS_QI:
+    case OP_PLUS_QF:
+    case OP_MINUS_QI:
+    case OP_MINUS_QF:
+    case OP_MULT_QI:
+    case OP_MULT_QF:
     case VAL_ZERO:
       printf("%3d: %-8s (     )", i, opStr(c->op));
       break;
@@ -185,6 +332,35 @@ const char* errmsg(int err)
     case ERR_NOT_ARRAY:       return "Variable is not an array";
     case ERR_ARRAY:           return "Variable is an array";
     case ERR_ARRAY_NOT_FOUND: return "Array not found (Sub called with brackets?)";
+    case ERR_PARSE_ARENA:     return "Arena too small for the parser tables";
+    case ERR_VERIFY_STACK:    return "Stack unbalanced or underflow";
+    case ERR_VERIFY_DEPTH:    return "Stack may overflow (or recursion)";
+    case ERR_VERIFY_JUMP:     return "Invalid jump target";
+    case ERR_VERIFY_REG:      return "Invalid register";
+    case ERR_VERIFY_SVC:      return "Invalid buildin function";
+    case ERR_VERIFY_CMD:      return "Invalid instruction";
+    case ERR_VERIFY_LIMIT:    return "Program too complex to verify";
+    case ERR_AOT_CMD:         return "Invalid instruction";
+    case ERR_AOT_JUMP:        return "Invalid jump target";
+    case ERR_AOT_LIMIT:       return "Too many subs";
+    case ERR_AOT_WRITE:       return "Can't write output";
+    case ERR_SCHED_WORKERS:   return "Invalid number of workers";
+    case ERR_IMAGE_MAGIC:     return "Not a bytecode image";
+    case ERR_IMAGE_VERSION:   return "Image version or instruction set differs";
+    case ERR_IMAGE_SIZE:      return "Image truncated or too large";
+    case ERR_IMAGE_CRC:       return "Image corrupted (CRC)";
+    case ERR_IMAGE_SIGNATURE: return "Registers or buildin functions differ";
+    case ERR_CACHE_MISS:      return "Source not in the cache";
+    case ERR_CACHE_WRITE:     return "Can't write to the cache";
+    case ERR_RELOAD_MAIN:     return "Code outside of the Subs changed (restart)";
+    case ERR_RELOAD_BUSY:     return "Sub running, retry at a safe point";
+    case ERR_RELOAD_STRINGS:  return "Strings of the running program changed";
+    case ERR_PATCH_MAGIC:     return "Not a patch";
+    case ERR_PATCH_BASE:      return "Patch for another image";
+    case ERR_PATCH_SIZE:      return "Too many parts or new image too large";
+    case ERR_PATCH_DATA:      return "Patch corrupted, truncated or too long";
+    case ERR_PATCH_CRC:       return "New image corrupted (CRC)";
+    case ERR_PATCH_WRITE:     return "Can't write the new image";
     case ERR_NOT_IMPL:        return "Not implemented yet";
     default:                  return "(unknown)";
   }
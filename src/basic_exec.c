@@ -1,6 +1,7 @@
 #include "basic_exec.h"
 #include "basic_common.h"
 #include "basic_config.h"
+#include "basic_jit.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -9,14 +10,190 @@
 //=============================================================================
 // Defines
 //=============================================================================
-#define IS_INT(x) ((x).op == VAL_INTEGER)
+#define IS_INT(x)   ((x).op == VAL_INTEGER)
+#define IS_FLOAT(x) ((x).op == VAL_FLOAT)
+#define COMPARE(a, b, cmp)                                                     \
+  ((IS_INT(a) && IS_INT(b)) ? ((a).iValue cmp (b).iValue)                      \
+                            : (castFloat(&(a)) cmp castFloat(&(b))))
+
+// Stack checks, can be omitted for verified programs (see verify())
+#if EXEC_CHECK_STACK
+#define ENSURE_STACK(n) ENSURE(vm->sp >= (n), ERR_EXEC_STACK_UF)
+#define ENSURE_ROOM()   ENSURE(vm->sp < STACK_SIZE, ERR_EXEC_STACK_OF)
+#define ENSURE_NEED(n)  ENSURE(vm->sp + (n) <= STACK_SIZE, ERR_EXEC_STACK_OF)
+#else
+#define ENSURE_STACK(n)
+#define ENSURE_ROOM()
+#define ENSURE_NEED(n)
+#endif
+
+// Array index, without bound check it only has to stay on the stack
+#if EXEC_CHECK_BOUNDS
+#define ENSURE_INDEX(i, dim) ENSURE((i) >= 0 && (i) < (dim), ERR_EXEC_OUT_BOUND)
+#else
+#define ENSURE_INDEX(i, dim) ENSURE((i) >= 0, ERR_EXEC_OUT_BOUND)
+#endif
+
+// Generic instruction: rewrite to the variant for the types of a and b
+// (skipped for read only code without decode cache, see rewrite())
+#if EXEC_QUICKEN
+#define QUICKEN(a, b, qi, qf)                                                  \
+  do                                                                           \
+  {                                                                            \
+    if (EXEC_DECODE_CACHE == 0 && !sys->setCode)                               \
+      break;                                                                   \
+    if (IS_INT(a) && IS_INT(b))                                                \
+      CHECK(rewrite(vm, sys, &code, qi));                                      \
+    else if (IS_FLOAT(a) && IS_FLOAT(b))                                       \
+      CHECK(rewrite(vm, sys, &code, qf));                                      \
+  } while (0)
+#else
+#define QUICKEN(a, b, qi, qf)
+#endif
+
+// Quickened instruction: operands of other types -> back to the generic
+// instruction and execute it again (no do-while, NEXT can be 'continue')
+#define GUARD(is, op)                                                          \
+  if (!is(stack[vm->sp - 2]) || !is(stack[vm->sp - 1]))                        \
+  {                                                                            \
+    CHECK(rewrite(vm, sys, &code, op));                                        \
+    pc = code.idx;                                                             \
+    NEXT;                                                                      \
+  }
+
+// Slot instructions: dst = a <op> b, operands are frame slots (see optimizer)
+#define SLOT_ARITH(b, oper)                                                    \
+  do                                                                           \
+  {                                                                            \
+    ENSURE_NEED(SLOT_NEED(code.code.param));                                   \
+    sCode* _a = slot(vm, SLOT_A(code.code.param2));                            \
+    sCode* _b = (b);                                                           \
+    ptr       = slot(vm, SLOT_DST(code.code.param));                           \
+    ENSURE(ptr && _a && _b, ERR_EXEC_VAR_INV);                                 \
+    if (IS_INT(*_a) && IS_INT(*_b))                                            \
+    {                                                                          \
+      iValue      = _a->iValue oper _b->iValue;                                \
+      ptr->op     = VAL_INTEGER;                                               \
+      ptr->iValue = iValue;                                                    \
+    }                                                                          \
+    else                                                                       \
+    {                                                                          \
+      fType _f    = castFloat(_a) oper castFloat(_b);                          \
+      ptr->op     = VAL_FLOAT;                                                 \
+      ptr->fValue = _f;                                                        \
+    }                                                                          \
+  } while (0)
+
+// Slot instructions: if not (a <cmp> b) goto lbl
+#define SLOT_IF(b, cmp)                                                        \
+  do                                                                           \
+  {                                                                            \
+    ENSURE_NEED(SLOT_NEED_IF);                                                 \
+    sCode* _a = slot(vm, SLOT_A(code.code.param2));                            \
+    sCode* _b = (b);                                                           \
+    ENSURE(_a && _b, ERR_EXEC_VAR_INV);                                        \
+    if (!COMPARE(*_a, *_b, cmp))                                               \
+      pc = code.code.param;                                                    \
+  } while (0)
+
+#define SLOT_B_VAR()   slot(vm, SLOT_B(code.code.param2))
+#define SLOT_B_CONST() konst(&value, SLOT_B(code.code.param2))
+
+#if STAT
+#define COUNT()    vm->dispatchCnt++
+#define COUNT_N(n) vm->dispatchCnt += (n)
+#else
+#define COUNT()
+#define COUNT_N(n)
+#endif
+
+// Continue in native code if the sub is compiled (see basic_jit.c), it
+// returns at the first instruction it leaves to the interpreter
+#if JIT
+#define JIT_ENTER(call)                                                        \
+  do                                                                           \
+  {                                                                            \
+    sJitState _s = {stack, vm->sp, vm->fp, pc, budget, 0};                     \
+    if (jit_enter(sys, &_s, (call)) > 0)                                       \
+    {                                                                          \
+      vm->sp = _s.sp;                                                          \
+      vm->fp = _s.fp;                                                          \
+      pc     = _s.pc;                                                          \
+      budget = _s.budget;                                                      \
+      COUNT_N(_s.cnt);                                                         \
+    }                                                                          \
+  } while (0)
+#else
+#define JIT_ENTER(call)
+#endif
+
+// Uncomment to trace every instruction
+// #define TRACE() debugState(sys, &code, stack, vm->sp, vm->fp)
+#ifndef TRACE
+#define TRACE()
+#endif
+
+// clang-format off
+#if EXEC_DECODE_CACHE > 0
+#define FETCH()                                                                \
+  do                                                                           \
+  {                                                                            \
+    ENSURE(pc >= 0, ERR_EXEC_PC);                                              \
+    sDecoded* _d = &vm->cache[pc % EXEC_DECODE_CACHE];                         \
+    if (_d->idx != pc)                                                         \
+      CHECK(decode(sys, _d, pc));                                              \
+    code.code = _d->code;                                                      \
+    code.idx  = pc;                                                            \
+    pc        = _d->next;                                                      \
+    COUNT();                                                                   \
+    TRACE();                                                                   \
+  } while (0)
+#else
+#define FETCH()                                                                \
+  do                                                                           \
+  {                                                                            \
+    ENSURE(pc >= 0, ERR_EXEC_PC);                                              \
+    CHECK(sys->getCode(&code, pc));                                            \
+    pc += sys->getCodeLen(code.code.op);                                       \
+    COUNT();                                                                   \
+    TRACE();                                                                   \
+  } while (0)
+#endif
+
+#if EXEC_THREADED && defined(__GNUC__)
+// Direct threaded dispatch (labels as values): each handler jumps straight
+// to the handler of the next instruction
+#define THREADED       1
+#define CASE(op)       L_##op
+#define DEFAULT        L_DEFAULT
+#define NEXT                                                                   \
+  do                                                                           \
+  {                                                                            \
+    if (budget-- <= 0)                                                         \
+      goto done;                                                               \
+    FETCH();                                                                   \
+    if ((unsigned)code.code.op >= ARRAY_SIZE(dispatch))                        \
+      goto L_DEFAULT;                                                          \
+    goto *dispatch[code.code.op];                                              \
+  } while (0)
+#define DISPATCH_BEGIN NEXT;
+#define DISPATCH_END
+#else
+// Switch dispatch (portable)
+#define THREADED       0
+#define CASE(op)       case op
+#define DEFAULT        default
+#define NEXT           continue
+#define DISPATCH_BEGIN while (budget-- > 0) { FETCH(); switch (code.code.op) {
+#define DISPATCH_END   } }
+#endif
+// clang-format on
 
 //=============================================================================
-// Private variables
+// Prototypes
 //=============================================================================
-static sCode   stack[STACK_SIZE];
-static idxType sp = 0;
-static idxType fp = 0;
+void debugState(sSys* sys, sCodeIdx* code, sCode* stack, idxType sp,
+                idxType fp);
 
 //=============================================================================
 // Private functions
@@ -51,41 +228,41 @@ static fType castFloat(sCode* value)
 }
 
 //-----------------------------------------------------------------------------
-static inline int pushInt(iType value)
+static inline int pushInt(sVm* vm, iType value)
 {
-  ENSURE(sp < ARRAY_SIZE(stack), ERR_EXEC_STACK_OF);
-  stack[sp].op     = VAL_INTEGER;
-  stack[sp].iValue = value;
-  sp++;
+  ENSURE_ROOM();
+  vm->stack[vm->sp].op     = VAL_INTEGER;
+  vm->stack[vm->sp].iValue = value;
+  vm->sp++;
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static inline int pushFloat(fType value)
+static inline int pushFloat(sVm* vm, fType value)
 {
-  ENSURE(sp < ARRAY_SIZE(stack), ERR_EXEC_STACK_OF);
-  stack[sp].op     = VAL_FLOAT;
-  stack[sp].fValue = value;
-  sp++;
+  ENSURE_ROOM();
+  vm->stack[vm->sp].op     = VAL_FLOAT;
+  vm->stack[vm->sp].fValue = value;
+  vm->sp++;
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static inline int pushLabel(idxType idx, idxType fp)
+static inline int pushLabel(sVm* vm, idxType idx, idxType frame)
 {
-  ENSURE(sp < ARRAY_SIZE(stack), ERR_EXEC_STACK_OF);
-  stack[sp].op      = VAL_LABEL;
-  stack[sp].lbl.lbl = idx;
-  stack[sp].lbl.fp  = fp;
-  sp++;
+  ENSURE_ROOM();
+  vm->stack[vm->sp].op      = VAL_LABEL;
+  vm->stack[vm->sp].lbl.lbl = idx;
+  vm->stack[vm->sp].lbl.fp  = frame;
+  vm->sp++;
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static inline int pushCode(sCode* code)
+static inline int pushCode(sVm* vm, sCode* code)
 {
-  ENSURE(sp < ARRAY_SIZE(stack), ERR_EXEC_STACK_OF);
-  memcpy(&stack[sp++], code, sizeof(sCode));
+  ENSURE_ROOM();
+  memcpy(&vm->stack[vm->sp++], code, sizeof(sCode));
   return 0;
 }
 
@@ -106,30 +283,30 @@ static int setReg(sSys* sys, idxType idx, sCode* value)
 }
 
 //-----------------------------------------------------------------------------
-static int print(sSys* sys, idxType cnt)
+static int print(sVm* vm, sSys* sys, idxType cnt)
 {
   const char* str;
 
-  ENSURE(sp > cnt, ERR_EXEC_STACK_UF);
-  sp -= cnt + 1;
+  ENSURE_STACK(cnt + 1);
+  vm->sp -= cnt + 1;
 
   for (int i = 0; i <= cnt; i++)
   {
-    switch (stack[sp + i].op)
+    switch (vm->stack[vm->sp + i].op)
     {
       case VAL_INTEGER:
-        printf("%d", stack[sp + i].iValue);
+        printf("%d", vm->stack[vm->sp + i].iValue);
         break;
       case VAL_FLOAT:
-        printf("%f", stack[sp + i].fValue);
+        printf("%f", vm->stack[vm->sp + i].fValue);
         break;
       case VAL_STRING:
-        CHECK(sys->getString(&str, stack[sp + i].str.start,
-                             stack[sp + i].str.len));
-        printf("%.*s", stack[sp + i].str.len, str);
+        CHECK(sys->getString(&str, vm->stack[vm->sp + i].str.start,
+                             vm->stack[vm->sp + i].str.len));
+        printf("%.*s", vm->stack[vm->sp + i].str.len, str);
         break;
       default:
-        printf("(%d)", stack[sp + i].op);
+        printf("(%d)", vm->stack[vm->sp + i].op);
         return ERR_EXEC_PRINT;
     }
   }
@@ -137,283 +314,917 @@ static int print(sSys* sys, idxType cnt)
 }
 
 //-----------------------------------------------------------------------------
-static int returnSub(idxType cnt)
+static int returnSub(sVm* vm, idxType cnt)
 {
   idxType res;
-  ENSURE(sp > fp, ERR_EXEC_STACK_UF);
-  ENSURE(stack[fp].op == VAL_LABEL, ERR_EXEC_CMD_INV);
-  sp  = fp - cnt;
-  res = stack[fp].lbl.lbl;
-  fp  = stack[fp].lbl.fp;
+  ENSURE_STACK(vm->fp + 1);
+  ENSURE(vm->stack[vm->fp].op == VAL_LABEL, ERR_EXEC_CMD_INV);
+  vm->sp = vm->fp - cnt;
+  res    = vm->stack[vm->fp].lbl.lbl;
+  vm->fp = vm->stack[vm->fp].lbl.fp;
   return res;
 }
 
 //-----------------------------------------------------------------------------
-static int svc(sSys* sys, idxType idx)
+static int incVar(sVm* vm, idxType idx, iType value)
+{
+  sCode* ptr;
+  ENSURE(idx >= 0 && idx < vm->sp, ERR_EXEC_VAR_INV);
+  ptr = &vm->stack[idx];
+  if (IS_INT(*ptr))
+  {
+    ptr->iValue += value;
+  }
+  else
+  {
+    ptr->fValue = castFloat(ptr) + value;
+    ptr->op     = VAL_FLOAT;
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int letInt(sVm* vm, idxType idx, iType value)
+{
+  ENSURE(idx >= 0 && idx < vm->sp, ERR_EXEC_VAR_INV);
+  vm->stack[idx].op     = VAL_INTEGER;
+  vm->stack[idx].iValue = value;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static inline sCode* slot(sVm* vm, int idx)
+{
+  // Frame slot of a slot instruction (variable or temporary above sp)
+  idx += vm->fp;
+  if (idx < 0 || idx >= (int)ARRAY_SIZE(vm->stack))
+    return NULL;
+  return &vm->stack[idx];
+}
+
+//-----------------------------------------------------------------------------
+static inline sCode* konst(sCode* value, iType k)
+{
+  value->op     = VAL_INTEGER;
+  value->iValue = k;
+  return value;
+}
+
+//-----------------------------------------------------------------------------
+static int forTest(sVm* vm, idxType idx)
+{
+  // Limit and step are on top of the stack. Returns 1 while the variable is
+  // in range (counting down for a negative step)
+  sCode* var;
+  ENSURE(idx >= 0 && idx < vm->sp - 2, ERR_EXEC_VAR_INV);
+  var = &vm->stack[idx];
+  if (castFloat(&vm->stack[vm->sp - 1]) < 0)
+    return COMPARE(*var, vm->stack[vm->sp - 2], >=);
+  return COMPARE(*var, vm->stack[vm->sp - 2], <=);
+}
+
+//-----------------------------------------------------------------------------
+static int forNext(sVm* vm, idxType idx)
+{
+  sCode* var;
+  ENSURE(idx >= 0 && idx < vm->sp - 2, ERR_EXEC_VAR_INV);
+  var = &vm->stack[idx];
+  if (IS_INT(*var) && IS_INT(vm->stack[vm->sp - 1]))
+  {
+    var->iValue += vm->stack[vm->sp - 1].iValue;
+  }
+  else
+  {
+    var->fValue = castFloat(var) + castFloat(&vm->stack[vm->sp - 1]);
+    var->op     = VAL_FLOAT;
+  }
+  return forTest(vm, idx);
+}
+
+//-----------------------------------------------------------------------------
+static int svc(sVm* vm, sSys* sys, idxType idx)
 {
   ENSURE(idx >= 0 && idx < ARRAY_SIZE(sys->svcs) && sys->svcs[idx].func,
          ERR_EXEC_SVC_INV);
-  ENSURE(sp > sys->svcs[idx].argc, ERR_EXEC_STACK_UF);
-  sp -= sys->svcs[idx].argc;
-  return sys->svcs[idx].func(&stack[sp - 1], &stack[0]);
+  ENSURE_STACK(sys->svcs[idx].argc + 1);
+  vm->sp -= sys->svcs[idx].argc;
+  return sys->svcs[idx].func(&vm->stack[vm->sp - 1], &vm->stack[0]);
 }
 
-//=============================================================================
-// Public functions
-//=============================================================================
-int exec(sSys* sys, idxType pc)
+//-----------------------------------------------------------------------------
+#if EXEC_DECODE_CACHE > 0
+static int decode(sSys* sys, sDecoded* d, idxType pc)
 {
   sCodeIdx code;
-  sCode    value;
-  iType    iValue;
-  sCode*   ptr;
-
-  ENSURE(pc >= 0, ERR_EXEC_PC);
   CHECK(sys->getCode(&code, pc));
-  pc += sys->getCodeLen(code.code.op);
+  d->code = code.code;
+  d->idx  = pc;
+  d->next = pc + sys->getCodeLen(code.code.op);
+  return 0;
+}
+#endif
 
-  extern void debugState(sSys * sys, sCodeIdx * code, sCode * stack, idxType sp,
-                         idxType fp);
-  // debugState(sys, &code, stack, sp, fp);
+//-----------------------------------------------------------------------------
+static int rewrite(sVm* vm, sSys* sys, const sCodeIdx* code, eOp op)
+{
+  sCodeIdx quick = *code;
+  quick.code.op  = op;
+#if EXEC_DECODE_CACHE > 0
+  // Current instruction is always cached, code memory can stay read only
+  sDecoded* d = &vm->cache[code->idx % EXEC_DECODE_CACHE];
+  if (d->idx == code->idx)
+  {
+    d->code.op = op;
+    return 0;
+  }
+#else
+  (void)vm;
+#endif
+  // Read only code (setCode NULL, e.g. a shared program image) is never
+  // quickened, it can't contain quickened instructions to rewrite back
+  ENSURE(sys->setCode, ERR_EXEC_CMD_INV);
+  return sys->setCode(&quick);
+}
 
-  switch (code.code.op)
+//-----------------------------------------------------------------------------
+static int run(sVm* vm, sSys* sys, idxType* ppc, int budget)
+{
+  sCode* const stack = vm->stack;
+  sCodeIdx     code;
+  sCode        value;
+  iType        iValue;
+  sCode*       ptr;
+  idxType      pc = *ppc;
+  int          res;
+
+#if THREADED
+  // clang-format off
+  static const void* const dispatch[] =
   {
-    case CMD_PRINT:
-      CHECK(print(sys, code.code.param));
-      return pc;
-    case CMD_LET_GLOBAL:
-      iValue = (code.code.param2 > 0) ? castInt(&stack[sp - 2]) : 0;
+    [CMD_INVALID]     = &&L_DEFAULT,
+    [CMD_PRINT]       = &&L_CMD_PRINT,
+    [CMD_LET_GLOBAL]  = &&L_CMD_LET_GLOBAL,
+    [CMD_LET_LOCAL]   = &&L_CMD_LET_LOCAL,
+    [CMD_LET_PTR]     = &&L_CMD_LET_PTR,
+    [CMD_LET_REG]     = &&L_CMD_LET_REG,
+    [CMD_IF]          = &&L_CMD_IF,
+    [CMD_GOTO]        = &&L_CMD_GOTO,
+    [LNK_GOTO]        = &&L_DEFAULT,
+    [CMD_GOSUB]       = &&L_CMD_GOSUB,
+    [LNK_GOSUB]       = &&L_DEFAULT,
+    [CMD_RETURN]      = &&L_CMD_RETURN,
+    [CMD_POP]         = &&L_CMD_POP,
+    [CMD_NOP]         = &&L_CMD_NOP,
+    [CMD_END]         = &&L_CMD_END,
+    [CMD_SVC]         = &&L_CMD_SVC,
+    [CMD_GET_GLOBAL]  = &&L_CMD_GET_GLOBAL,
+    [CMD_GET_LOCAL]   = &&L_CMD_GET_LOCAL,
+    [CMD_GET_PTR]     = &&L_CMD_GET_PTR,
+    [CMD_GET_REG]     = &&L_CMD_GET_REG,
+    [CMD_CREATE_PTR]  = &&L_CMD_CREATE_PTR,
+    [CMD_INC_GLOBAL]  = &&L_CMD_INC_GLOBAL,
+    [CMD_INC_LOCAL]   = &&L_CMD_INC_LOCAL,
+    [CMD_LETI_GLOBAL] = &&L_CMD_LETI_GLOBAL,
+    [CMD_LETI_LOCAL]  = &&L_CMD_LETI_LOCAL,
+    [CMD_FOR_GLOBAL]  = &&L_CMD_FOR_GLOBAL,
+    [CMD_FOR_LOCAL]   = &&L_CMD_FOR_LOCAL,
+    [CMD_NEXT_GLOBAL] = &&L_CMD_NEXT_GLOBAL,
+    [CMD_NEXT_LOCAL]  = &&L_CMD_NEXT_LOCAL,
+    [CMD_IF_NEQ]      = &&L_CMD_IF_NEQ,
+    [CMD_IF_LTEQ]     = &&L_CMD_IF_LTEQ,
+    [CMD_IF_GTEQ]     = &&L_CMD_IF_GTEQ,
+    [CMD_IF_LT]       = &&L_CMD_IF_LT,
+    [CMD_IF_GT]       = &&L_CMD_IF_GT,
+    [CMD_IF_EQUAL]    = &&L_CMD_IF_EQUAL,
+    [CMD_IF_NEQ_II]   = &&L_CMD_IF_NEQ_II,
+    [CMD_IF_LTEQ_II]  = &&L_CMD_IF_LTEQ_II,
+    [CMD_IF_GTEQ_II]  = &&L_CMD_IF_GTEQ_II,
+    [CMD_IF_LT_II]    = &&L_CMD_IF_LT_II,
+    [CMD_IF_GT_II]    = &&L_CMD_IF_GT_II,
+    [CMD_IF_EQUAL_II] = &&L_CMD_IF_EQUAL_II,
+    [CMD_IF_NEQ_QI]   = &&L_CMD_IF_NEQ_QI,
+    [CMD_IF_NEQ_QF]   = &&L_CMD_IF_NEQ_QF,
+    [CMD_IF_LTEQ_QI]  = &&L_CMD_IF_LTEQ_QI,
+    [CMD_IF_LTEQ_QF]  = &&L_CMD_IF_LTEQ_QF,
+    [CMD_IF_GTEQ_QI]  = &&L_CMD_IF_GTEQ_QI,
+    [CMD_IF_GTEQ_QF]  = &&L_CMD_IF_GTEQ_QF,
+    [CMD_IF_LT_QI]    = &&L_CMD_IF_LT_QI,
+    [CMD_IF_LT_QF]    = &&L_CMD_IF_LT_QF,
+    [CMD_IF_GT_QI]    = &&L_CMD_IF_GT_QI,
+    [CMD_IF_GT_QF]    = &&L_CMD_IF_GT_QF,
+    [CMD_IF_EQUAL_QI] = &&L_CMD_IF_EQUAL_QI,
+    [CMD_IF_EQUAL_QF] = &&L_CMD_IF_EQUAL_QF,
+    [CMD_MOVE]        = &&L_CMD_MOVE,
+    [CMD_IF_NEQ_SS]   = &&L_CMD_IF_NEQ_SS,
+    [CMD_IF_NEQ_SK]   = &&L_CMD_IF_NEQ_SK,
+    [CMD_IF_LTEQ_SS]  = &&L_CMD_IF_LTEQ_SS,
+    [CMD_IF_LTEQ_SK]  = &&L_CMD_IF_LTEQ_SK,
+    [CMD_IF_GTEQ_SS]  = &&L_CMD_IF_GTEQ_SS,
+    [CMD_IF_GTEQ_SK]  = &&L_CMD_IF_GTEQ_SK,
+    [CMD_IF_LT_SS]    = &&L_CMD_IF_LT_SS,
+    [CMD_IF_LT_SK]    = &&L_CMD_IF_LT_SK,
+    [CMD_IF_GT_SS]    = &&L_CMD_IF_GT_SS,
+    [CMD_IF_GT_SK]    = &&L_CMD_IF_GT_SK,
+    [CMD_IF_EQUAL_SS] = &&L_CMD_IF_EQUAL_SS,
+    [CMD_IF_EQUAL_SK] = &&L_CMD_IF_EQUAL_SK,
+    [OP_NEQ]          = &&L_OP_NEQ,
+    [OP_LTEQ]         = &&L_OP_LTEQ,
+    [OP_GTEQ]         = &&L_OP_GTEQ,
+    [OP_LT]           = &&L_OP_LT,
+    [OP_GT]           = &&L_OP_GT,
+    [OP_EQUAL]        = &&L_OP_EQUAL,
+    [OP_XOR]          = &&L_OP_XOR,
+    [OP_OR]           = &&L_OP_OR,
+    [OP_AND]          = &&L_OP_AND,
+    [OP_NOT]          = &&L_OP_NOT,
+    [OP_SHL]          = &&L_OP_SHL,
+    [OP_SHR]          = &&L_OP_SHR,
+    [OP_PLUS]         = &&L_OP_PLUS,
+    [OP_MINUS]        = &&L_OP_MINUS,
+    [OP_MOD]          = &&L_OP_MOD,
+    [OP_MULT]         = &&L_OP_MULT,
+    [OP_DIV]          = &&L_OP_DIV,
+    [OP_IDIV]         = &&L_OP_IDIV,
+    [OP_POW]          = &&L_OP_POW,
+    [OP_SIGN]         = &&L_OP_SIGN,
+    [OP_NEQ_II]       = &&L_OP_NEQ_II,
+    [OP_LTEQ_II]      = &&L_OP_LTEQ_II,
+    [OP_GTEQ_II]      = &&L_OP_GTEQ_II,
+    [OP_LT_II]        = &&L_OP_LT_II,
+    [OP_GT_II]        = &&L_OP_GT_II,
+    [OP_EQUAL_II]     = &&L_OP_EQUAL_II,
+    [OP_PLUS_II]      = &&L_OP_PLUS_II,
+    [OP_MINUS_II]     = &&L_OP_MINUS_II,
+    [OP_MULT_II]      = &&L_OP_MULT_II,
+    [OP_PLUS_QI]      = &&L_OP_PLUS_QI,
+    [OP_PLUS_QF]      = &&L_OP_PLUS_QF,
+    [OP_MINUS_QI]     = &&L_OP_MINUS_QI,
+    [OP_MINUS_QF]     = &&L_OP_MINUS_QF,
+    [OP_MULT_QI]      = &&L_OP_MULT_QI,
+    [OP_MULT_QF]      = &&L_OP_MULT_QF,
+    [OP_PLUS_SS]      = &&L_OP_PLUS_SS,
+    [OP_PLUS_SK]      = &&L_OP_PLUS_SK,
+    [OP_MINUS_SS]     = &&L_OP_MINUS_SS,
+    [OP_MINUS_SK]     = &&L_OP_MINUS_SK,
+    [OP_MULT_SS]      = &&L_OP_MULT_SS,
+    [OP_MULT_SK]      = &&L_OP_MULT_SK,
+    [VAL_ZERO]        = &&L_VAL_ZERO,
+    [VAL_INTEGER]     = &&L_VAL_INTEGER,
+    [VAL_FLOAT]       = &&L_VAL_FLOAT,
+    [VAL_STRING]      = &&L_VAL_STRING,
+    [VAL_PTR]         = &&L_VAL_PTR,
+    [VAL_LABEL]       = &&L_DEFAULT,
+  };
+  // clang-format on
+#endif
+
+  JIT_ENTER(false);
+
+  DISPATCH_BEGIN
+    CASE(CMD_PRINT):
+      CHECK(print(vm, sys, code.code.param));
+      NEXT;
+    CASE(CMD_LET_GLOBAL):
+      iValue = (code.code.param2 > 0) ? castInt(&stack[vm->sp - 2]) : 0;
       if (code.code.param2 > 0)  // Array
       {
-        ENSURE(iValue >= 0 && iValue < code.code.param2, ERR_EXEC_OUT_BOUND);
-        memcpy(&stack[sp - 2], &stack[sp - 1], sizeof(stack[0]));
-        sp--;
+        ENSURE_INDEX(iValue, code.code.param2);
+        memcpy(&stack[vm->sp - 2], &stack[vm->sp - 1], sizeof(stack[0]));
+        vm->sp--;
       }
-      ENSURE(code.code.param >= 0 && code.code.param + iValue < sp,
+      ENSURE(code.code.param >= 0 && code.code.param + iValue < vm->sp,
              ERR_EXEC_VAR_INV);
-      memcpy(&stack[code.code.param + iValue], &stack[--sp], sizeof(stack[0]));
-      return pc;
-    case CMD_LET_LOCAL:
-      iValue = (code.code.param2 > 0) ? castInt(&stack[sp - 2]) : 0;
+      memcpy(&stack[code.code.param + iValue], &stack[--vm->sp],
+             sizeof(stack[0]));
+      NEXT;
+    CASE(CMD_LET_LOCAL):
+      iValue = (code.code.param2 > 0) ? castInt(&stack[vm->sp - 2]) : 0;
       if (code.code.param2 > 0)  // Array
       {
-        ENSURE(iValue >= 0 && iValue < code.code.param2, ERR_EXEC_OUT_BOUND);
-        memcpy(&stack[sp - 2], &stack[sp - 1], sizeof(stack[0]));
-        sp--;
+        ENSURE_INDEX(iValue, code.code.param2);
+        memcpy(&stack[vm->sp - 2], &stack[vm->sp - 1], sizeof(stack[0]));
+        vm->sp--;
       }
-      ENSURE(fp + code.code.param >= 0 && fp + code.code.param + iValue < sp,
+      ENSURE(vm->fp + code.code.param >= 0 &&
+                 vm->fp + code.code.param + iValue < vm->sp,
              ERR_EXEC_VAR_INV);
-      memcpy(&stack[fp + code.code.param + iValue], &stack[--sp],
+      memcpy(&stack[vm->fp + code.code.param + iValue], &stack[--vm->sp],
              sizeof(stack[0]));
-      return pc;
-    case CMD_LET_PTR:
-      sp -= 2;
-      ENSURE(fp + code.code.param >= 0 && fp + code.code.param < sp,
+      NEXT;
+    CASE(CMD_LET_PTR):
+      vm->sp -= 2;
+      ENSURE(vm->fp + code.code.param >= 0 && vm->fp + code.code.param < vm->sp,
              ERR_EXEC_VAR_INV);
-      ptr = &stack[fp + code.code.param];
+      ptr = &stack[vm->fp + code.code.param];
       ENSURE(ptr->op == VAL_PTR, ERR_EXEC_VAR_INV);
-      iValue = castInt(&stack[sp]);
-      ENSURE(iValue >= 0 && iValue < ptr->param2, ERR_EXEC_OUT_BOUND);
-      ENSURE(ptr->param >= 0 && ptr->param + iValue < sp, ERR_EXEC_VAR_INV);
-      memcpy(&stack[ptr->param + iValue], &stack[sp + 1], sizeof(stack[0]));
-      return pc;
-    case CMD_LET_REG:
-      ENSURE(sp > 0, ERR_EXEC_STACK_UF);
-      CHECK(setReg(sys, code.code.param, &stack[--sp]));
-      return pc;
-    case CMD_IF:
-      ENSURE(sp > 0, ERR_EXEC_STACK_UF);
-      return (castBool(&stack[--sp])) ? pc : code.code.param;
-    case CMD_GOTO:
-      return code.code.param;
-    case CMD_GOSUB:
-      CHECK(pushLabel(pc, fp));
-      fp = sp - 1;
-      return code.code.param;
-    case CMD_RETURN:
-      return returnSub(code.code.param);
-    case CMD_POP:
-      ENSURE(sp > code.code.param, ERR_EXEC_STACK_UF);
-      sp -= code.code.param + 1;
-      return pc;
-    case CMD_NOP:
-      return pc;
-    case CMD_END:
+      iValue = castInt(&stack[vm->sp]);
+      ENSURE_INDEX(iValue, ptr->param2);
+      ENSURE(ptr->param >= 0 && ptr->param + iValue < vm->sp, ERR_EXEC_VAR_INV);
+      memcpy(&stack[ptr->param + iValue], &stack[vm->sp + 1], sizeof(stack[0]));
+      NEXT;
+    CASE(CMD_LET_REG):
+      ENSURE_STACK(1);
+      CHECK(setReg(sys, code.code.param, &stack[--vm->sp]));
+      NEXT;
+    CASE(CMD_IF):
+      ENSURE_STACK(1);
+      if (!castBool(&stack[--vm->sp]))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_GOTO):
+      pc = code.code.param;
+      NEXT;
+    CASE(CMD_GOSUB):
+      CHECK(pushLabel(vm, pc, vm->fp));
+      vm->fp = vm->sp - 1;
+      pc = code.code.param;
+      JIT_ENTER(true);
+      NEXT;
+    CASE(CMD_RETURN):
+      CHECK(pc = returnSub(vm, code.code.param));
+      JIT_ENTER(false);
+      NEXT;
+    CASE(CMD_POP):
+      ENSURE_STACK(code.code.param + 1);
+      vm->sp -= code.code.param + 1;
+      NEXT;
+    CASE(CMD_NOP):
+      NEXT;
+    CASE(CMD_END):
       return ERR_EXEC_END;
-    case CMD_SVC:
-      CHECK(svc(sys, code.code.param));
-      return pc;
-    case CMD_GET_GLOBAL:
-      iValue = (code.code.param2 > 0) ? castInt(&stack[--sp]) : 0;
-      ENSURE(
-          code.code.param2 == 0 || (iValue >= 0 && iValue < code.code.param2),
-          ERR_EXEC_OUT_BOUND);
-      ENSURE(code.code.param >= 0 && code.code.param + iValue < sp,
+    CASE(CMD_SVC):
+      CHECK(res = svc(vm, sys, code.code.param));
+      if (res > 0)  // SVC requests to yield
+      {
+        *ppc = pc;
+        return EXEC_RUN_YIELD;
+      }
+      NEXT;
+    CASE(CMD_GET_GLOBAL):
+      iValue = (code.code.param2 > 0) ? castInt(&stack[--vm->sp]) : 0;
+      if (code.code.param2 > 0)
+        ENSURE_INDEX(iValue, code.code.param2);
+      ENSURE(code.code.param >= 0 && code.code.param + iValue < vm->sp,
              ERR_EXEC_VAR_INV);
-      CHECK(pushCode(&stack[code.code.param + iValue]));
-      return pc;
-    case CMD_GET_LOCAL:
-      iValue = (code.code.param2 > 0) ? castInt(&stack[--sp]) : 0;
-      ENSURE(
-          code.code.param2 == 0 || (iValue >= 0 && iValue < code.code.param2),
-          ERR_EXEC_OUT_BOUND);
-      ENSURE(fp + code.code.param >= 0 && fp + code.code.param + iValue < sp,
+      CHECK(pushCode(vm, &stack[code.code.param + iValue]));
+      NEXT;
+    CASE(CMD_GET_LOCAL):
+      iValue = (code.code.param2 > 0) ? castInt(&stack[--vm->sp]) : 0;
+      if (code.code.param2 > 0)
+        ENSURE_INDEX(iValue, code.code.param2);
+      ENSURE(vm->fp + code.code.param >= 0 &&
+                 vm->fp + code.code.param + iValue < vm->sp,
              ERR_EXEC_VAR_INV);
-      CHECK(pushCode(&stack[fp + code.code.param + iValue]));
-      return pc;
-    case CMD_GET_PTR:
-      ENSURE(fp + code.code.param >= 0 && fp + code.code.param < sp,
+      CHECK(pushCode(vm, &stack[vm->fp + code.code.param + iValue]));
+      NEXT;
+    CASE(CMD_GET_PTR):
+      ENSURE(vm->fp + code.code.param >= 0 && vm->fp + code.code.param < vm->sp,
              ERR_EXEC_VAR_INV);
-      ptr = &stack[fp + code.code.param];
+      ptr = &stack[vm->fp + code.code.param];
       ENSURE(ptr->op == VAL_PTR, ERR_EXEC_VAR_INV);
-      iValue = castInt(&stack[--sp]);
-      ENSURE(iValue >= 0 && iValue < ptr->param2, ERR_EXEC_OUT_BOUND);
-      ENSURE(ptr->param >= 0 && ptr->param + iValue < sp, ERR_EXEC_VAR_INV);
-      CHECK(pushCode(&stack[ptr->param + iValue]));
-      return pc;
-    case CMD_GET_REG:
+      iValue = castInt(&stack[--vm->sp]);
+      ENSURE_INDEX(iValue, ptr->param2);
+      ENSURE(ptr->param >= 0 && ptr->param + iValue < vm->sp, ERR_EXEC_VAR_INV);
+      CHECK(pushCode(vm, &stack[ptr->param + iValue]));
+      NEXT;
+    CASE(CMD_GET_REG):
       CHECK(getReg(sys, &value, code.code.param));
-      CHECK(pushCode(&value));
-      return pc;
-    case CMD_CREATE_PTR:
-      ENSURE(fp + code.code.param >= 0 && fp + code.code.param < sp,
+      CHECK(pushCode(vm, &value));
+      NEXT;
+    CASE(CMD_CREATE_PTR):
+      ENSURE(vm->fp + code.code.param >= 0 && vm->fp + code.code.param < vm->sp,
              ERR_EXEC_VAR_INV);
-      if (stack[fp + code.code.param].op == VAL_PTR)
+      if (stack[vm->fp + code.code.param].op == VAL_PTR)
       {
-        CHECK(pushCode(&stack[fp + code.code.param]));
+        CHECK(pushCode(vm, &stack[vm->fp + code.code.param]));
       }
       else
       {
         value.op     = VAL_PTR;
-        value.param  = fp + code.code.param;
+        value.param  = vm->fp + code.code.param;
         value.param2 = code.code.param2;
-        CHECK(pushCode(&value));
+        CHECK(pushCode(vm, &value));
       }
-      return pc;
+      NEXT;
+    CASE(CMD_INC_GLOBAL):
+      CHECK(incVar(vm, code.code.param, code.code.param2));
+      NEXT;
+    CASE(CMD_INC_LOCAL):
+      CHECK(incVar(vm, vm->fp + code.code.param, code.code.param2));
+      NEXT;
+    CASE(CMD_LETI_GLOBAL):
+      CHECK(letInt(vm, code.code.param, code.code.param2));
+      NEXT;
+    CASE(CMD_LETI_LOCAL):
+      CHECK(letInt(vm, vm->fp + code.code.param, code.code.param2));
+      NEXT;
+    CASE(CMD_FOR_GLOBAL):
+      CHECK(res = forTest(vm, code.code.param2));
+      if (!res)
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_FOR_LOCAL):
+      CHECK(res = forTest(vm, vm->fp + code.code.param2));
+      if (!res)
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_NEXT_GLOBAL):
+      CHECK(res = forNext(vm, code.code.param2));
+      if (res)
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_NEXT_LOCAL):
+      CHECK(res = forNext(vm, vm->fp + code.code.param2));
+      if (res)
+        pc = code.code.param;
+      NEXT;
 
     // clang-format off
-    case OP_NEQ:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? (stack[sp].iValue      != stack[sp + 1].iValue)
-          : (castFloat(&stack[sp]) != castFloat(&stack[sp + 1]))) ? -1 : 0));
-      return pc;
-    case OP_LTEQ:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? (stack[sp].iValue      <= stack[sp + 1].iValue)
-          : (castFloat(&stack[sp]) <= castFloat(&stack[sp + 1]))) ? -1 : 0));
-      return pc;
-    case OP_GTEQ:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? (stack[sp].iValue      >= stack[sp + 1].iValue)
-          : (castFloat(&stack[sp]) >= castFloat(&stack[sp + 1]))) ? -1 : 0));
-      return pc;
-    case OP_LT:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? (stack[sp].iValue      < stack[sp + 1].iValue)
-          : (castFloat(&stack[sp]) < castFloat(&stack[sp + 1]))) ? -1 : 0));
-      return pc;
-    case OP_GT:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? (stack[sp].iValue      > stack[sp + 1].iValue)
-          : (castFloat(&stack[sp]) > castFloat(&stack[sp + 1]))) ? -1 : 0));
-      return pc;
-    case OP_EQUAL:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? (stack[sp].iValue      == stack[sp + 1].iValue)
-          : (castFloat(&stack[sp]) == castFloat(&stack[sp + 1]))) ? -1 : 0));
-      return pc;
-    case OP_XOR:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(castInt(&stack[sp]) ^ castInt(&stack[sp + 1])));
-      return pc;
-    case OP_OR:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(castInt(&stack[sp]) | castInt(&stack[sp + 1])));
-      return pc;
-    case OP_AND:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(castInt(&stack[sp]) & castInt(&stack[sp + 1])));
-      return pc;
-    case OP_NOT:
-      ENSURE(sp >= 1, ERR_EXEC_STACK_UF); sp -= 1;
-      CHECK(pushInt(~castInt(&stack[sp])));
-      return pc;
-    case OP_SHL:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(castInt(&stack[sp]) << castInt(&stack[sp + 1])));
-      return pc;
-    case OP_SHR:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK(pushInt(castInt(&stack[sp]) >> castInt(&stack[sp + 1])));
-      return pc;
-    case OP_PLUS:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? pushInt(stack[sp].iValue        + stack[sp + 1].iValue)
-          : pushFloat(castFloat(&stack[sp]) + castFloat(&stack[sp + 1])));
-      return pc;
-    case OP_MINUS:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? pushInt(stack[sp].iValue        - stack[sp + 1].iValue)
-          : pushFloat(castFloat(&stack[sp]) - castFloat(&stack[sp + 1])));
-      return pc;
-    case OP_MOD:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK((pushInt(castInt(&stack[sp]) % castInt(&stack[sp + 1]))));
-      return pc;
-    case OP_MULT:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-                ? pushInt(stack[sp].iValue        * stack[sp + 1].iValue)
-                : pushFloat(castFloat(&stack[sp]) * castFloat(&stack[sp + 1])));
-      return pc;
-    case OP_DIV:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      ENSURE(castFloat(&stack[sp + 1]) != 0.0f, ERR_EXEC_DIV_ZERO);
-      CHECK(pushFloat(castFloat(&stack[sp]) / castFloat(&stack[sp + 1])));
-      return pc;
-    case OP_IDIV:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      ENSURE(castInt(&stack[sp + 1]) != 0, ERR_EXEC_DIV_ZERO);
-      CHECK(pushInt(castInt(&stack[sp]) / castInt(&stack[sp + 1])));
-      return pc;
-    case OP_POW:
-      ENSURE(sp >= 2, ERR_EXEC_STACK_UF); sp -= 2;
-      CHECK((IS_INT(stack[sp]) && IS_INT(stack[sp + 1]))
-          ? pushInt(powf(stack[sp].iValue, stack[sp + 1].iValue) + 0.5f)
-          : pushFloat(powf(castFloat(&stack[sp]), castFloat(&stack[sp + 1]))));
-      return pc;
-    case OP_SIGN:
-      ENSURE(sp >= 1, ERR_EXEC_STACK_UF); sp -= 1;
-      CHECK(IS_INT(stack[sp])
-          ? pushInt(-stack[sp].iValue)
-          : pushFloat(-stack[sp].fValue));
-      return pc;
+    CASE(CMD_IF_NEQ):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], CMD_IF_NEQ_QI, CMD_IF_NEQ_QF);
+      if (!COMPARE(stack[vm->sp], stack[vm->sp + 1], !=)) pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_LTEQ):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], CMD_IF_LTEQ_QI, CMD_IF_LTEQ_QF);
+      if (!COMPARE(stack[vm->sp], stack[vm->sp + 1], <=)) pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_GTEQ):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], CMD_IF_GTEQ_QI, CMD_IF_GTEQ_QF);
+      if (!COMPARE(stack[vm->sp], stack[vm->sp + 1], >=)) pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_LT):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], CMD_IF_LT_QI, CMD_IF_LT_QF);
+      if (!COMPARE(stack[vm->sp], stack[vm->sp + 1], <)) pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_GT):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], CMD_IF_GT_QI, CMD_IF_GT_QF);
+      if (!COMPARE(stack[vm->sp], stack[vm->sp + 1], >)) pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_EQUAL):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], CMD_IF_EQUAL_QI,
+              CMD_IF_EQUAL_QF);
+      if (!COMPARE(stack[vm->sp], stack[vm->sp + 1], ==)) pc = code.code.param;
+      NEXT;
+
+    // Both operands are known to be integers (see optimizer)
+    CASE(CMD_IF_NEQ_II):
+      ENSURE_STACK(2); vm->sp -= 2;
+      if (!(stack[vm->sp].iValue != stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_LTEQ_II):
+      ENSURE_STACK(2); vm->sp -= 2;
+      if (!(stack[vm->sp].iValue <= stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_GTEQ_II):
+      ENSURE_STACK(2); vm->sp -= 2;
+      if (!(stack[vm->sp].iValue >= stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_LT_II):
+      ENSURE_STACK(2); vm->sp -= 2;
+      if (!(stack[vm->sp].iValue < stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_GT_II):
+      ENSURE_STACK(2); vm->sp -= 2;
+      if (!(stack[vm->sp].iValue > stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_EQUAL_II):
+      ENSURE_STACK(2); vm->sp -= 2;
+      if (!(stack[vm->sp].iValue == stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+
+    // Quickened by the generic instructions (see QUICKEN)
+    CASE(CMD_IF_NEQ_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, CMD_IF_NEQ);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].iValue != stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_NEQ_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, CMD_IF_NEQ);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].fValue != stack[vm->sp + 1].fValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_LTEQ_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, CMD_IF_LTEQ);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].iValue <= stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_LTEQ_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, CMD_IF_LTEQ);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].fValue <= stack[vm->sp + 1].fValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_GTEQ_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, CMD_IF_GTEQ);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].iValue >= stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_GTEQ_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, CMD_IF_GTEQ);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].fValue >= stack[vm->sp + 1].fValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_LT_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, CMD_IF_LT);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].iValue < stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_LT_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, CMD_IF_LT);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].fValue < stack[vm->sp + 1].fValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_GT_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, CMD_IF_GT);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].iValue > stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_GT_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, CMD_IF_GT);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].fValue > stack[vm->sp + 1].fValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_EQUAL_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, CMD_IF_EQUAL);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].iValue == stack[vm->sp + 1].iValue))
+        pc = code.code.param;
+      NEXT;
+    CASE(CMD_IF_EQUAL_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, CMD_IF_EQUAL);
+      vm->sp -= 2;
+      if (!(stack[vm->sp].fValue == stack[vm->sp + 1].fValue))
+        pc = code.code.param;
+      NEXT;
+
+    CASE(OP_NEQ):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, COMPARE(stack[vm->sp], stack[vm->sp + 1], !=)
+          ? -1 : 0));
+      NEXT;
+    CASE(OP_LTEQ):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, COMPARE(stack[vm->sp], stack[vm->sp + 1], <=)
+          ? -1 : 0));
+      NEXT;
+    CASE(OP_GTEQ):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, COMPARE(stack[vm->sp], stack[vm->sp + 1], >=)
+          ? -1 : 0));
+      NEXT;
+    CASE(OP_LT):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, COMPARE(stack[vm->sp], stack[vm->sp + 1], <)
+          ? -1 : 0));
+      NEXT;
+    CASE(OP_GT):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, COMPARE(stack[vm->sp], stack[vm->sp + 1], >)
+          ? -1 : 0));
+      NEXT;
+    CASE(OP_EQUAL):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, COMPARE(stack[vm->sp], stack[vm->sp + 1], ==)
+          ? -1 : 0));
+      NEXT;
+    CASE(OP_XOR):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, castInt(&stack[vm->sp]) ^ castInt(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_OR):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, castInt(&stack[vm->sp]) | castInt(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_AND):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm, castInt(&stack[vm->sp]) & castInt(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_NOT):
+      ENSURE_STACK(1); vm->sp -= 1;
+      CHECK(pushInt(vm, ~castInt(&stack[vm->sp])));
+      NEXT;
+    CASE(OP_SHL):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm,
+                    castInt(&stack[vm->sp]) << castInt(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_SHR):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK(pushInt(vm,
+                    castInt(&stack[vm->sp]) >> castInt(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_PLUS):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], OP_PLUS_QI, OP_PLUS_QF);
+      CHECK((IS_INT(stack[vm->sp]) && IS_INT(stack[vm->sp + 1]))
+          ? pushInt(vm, stack[vm->sp].iValue + stack[vm->sp + 1].iValue)
+          : pushFloat(vm, castFloat(&stack[vm->sp]) +
+                              castFloat(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_MINUS):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], OP_MINUS_QI, OP_MINUS_QF);
+      CHECK((IS_INT(stack[vm->sp]) && IS_INT(stack[vm->sp + 1]))
+          ? pushInt(vm, stack[vm->sp].iValue - stack[vm->sp + 1].iValue)
+          : pushFloat(vm, castFloat(&stack[vm->sp]) -
+                              castFloat(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_MOD):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK((pushInt(vm,
+                     castInt(&stack[vm->sp]) % castInt(&stack[vm->sp + 1]))));
+      NEXT;
+    CASE(OP_MULT):
+      ENSURE_STACK(2); vm->sp -= 2;
+      QUICKEN(stack[vm->sp], stack[vm->sp + 1], OP_MULT_QI, OP_MULT_QF);
+      CHECK((IS_INT(stack[vm->sp]) && IS_INT(stack[vm->sp + 1]))
+          ? pushInt(vm, stack[vm->sp].iValue * stack[vm->sp + 1].iValue)
+          : pushFloat(vm, castFloat(&stack[vm->sp]) *
+                              castFloat(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_DIV):
+      ENSURE_STACK(2); vm->sp -= 2;
+      ENSURE(castFloat(&stack[vm->sp + 1]) != 0.0f, ERR_EXEC_DIV_ZERO);
+      CHECK(pushFloat(vm, castFloat(&stack[vm->sp]) /
+                              castFloat(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_IDIV):
+      ENSURE_STACK(2); vm->sp -= 2;
+      ENSURE(castInt(&stack[vm->sp + 1]) != 0, ERR_EXEC_DIV_ZERO);
+      CHECK(pushInt(vm,
+                    castInt(&stack[vm->sp]) / castInt(&stack[vm->sp + 1])));
+      NEXT;
+    CASE(OP_POW):
+      ENSURE_STACK(2); vm->sp -= 2;
+      CHECK((IS_INT(stack[vm->sp]) && IS_INT(stack[vm->sp + 1]))
+          ? pushInt(vm, powf(stack[vm->sp].iValue,
+                             stack[vm->sp + 1].iValue) + 0.5f)
+          : pushFloat(vm, powf(castFloat(&stack[vm->sp]),
+                           castFloat(&stack[vm->sp + 1]))));
+      NEXT;
+    CASE(OP_SIGN):
+      ENSURE_STACK(1); vm->sp -= 1;
+      CHECK(IS_INT(stack[vm->sp])
+          ? pushInt(vm, -stack[vm->sp].iValue)
+          : pushFloat(vm, -stack[vm->sp].fValue));
+      NEXT;
+
+    // Both operands are known to be integers (see optimizer)
+    CASE(OP_NEQ_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          -(stack[vm->sp - 1].iValue != stack[vm->sp].iValue);
+      NEXT;
+    CASE(OP_LTEQ_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          -(stack[vm->sp - 1].iValue <= stack[vm->sp].iValue);
+      NEXT;
+    CASE(OP_GTEQ_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          -(stack[vm->sp - 1].iValue >= stack[vm->sp].iValue);
+      NEXT;
+    CASE(OP_LT_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          -(stack[vm->sp - 1].iValue < stack[vm->sp].iValue);
+      NEXT;
+    CASE(OP_GT_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          -(stack[vm->sp - 1].iValue > stack[vm->sp].iValue);
+      NEXT;
+    CASE(OP_EQUAL_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          -(stack[vm->sp - 1].iValue == stack[vm->sp].iValue);
+      NEXT;
+    CASE(OP_PLUS_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          stack[vm->sp - 1].iValue + stack[vm->sp].iValue;
+      NEXT;
+    CASE(OP_MINUS_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          stack[vm->sp - 1].iValue - stack[vm->sp].iValue;
+      NEXT;
+    CASE(OP_MULT_II):
+      ENSURE_STACK(2); vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          stack[vm->sp - 1].iValue * stack[vm->sp].iValue;
+      NEXT;
+
+    // Quickened by the generic instructions (see QUICKEN)
+    CASE(OP_PLUS_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, OP_PLUS);
+      vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          stack[vm->sp - 1].iValue + stack[vm->sp].iValue;
+      NEXT;
+    CASE(OP_PLUS_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, OP_PLUS);
+      vm->sp -= 1;
+      stack[vm->sp - 1].fValue =
+          stack[vm->sp - 1].fValue + stack[vm->sp].fValue;
+      NEXT;
+    CASE(OP_MINUS_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, OP_MINUS);
+      vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          stack[vm->sp - 1].iValue - stack[vm->sp].iValue;
+      NEXT;
+    CASE(OP_MINUS_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, OP_MINUS);
+      vm->sp -= 1;
+      stack[vm->sp - 1].fValue =
+          stack[vm->sp - 1].fValue - stack[vm->sp].fValue;
+      NEXT;
+    CASE(OP_MULT_QI):
+      ENSURE_STACK(2);
+      GUARD(IS_INT, OP_MULT);
+      vm->sp -= 1;
+      stack[vm->sp - 1].iValue =
+          stack[vm->sp - 1].iValue * stack[vm->sp].iValue;
+      NEXT;
+    CASE(OP_MULT_QF):
+      ENSURE_STACK(2);
+      GUARD(IS_FLOAT, OP_MULT);
+      vm->sp -= 1;
+      stack[vm->sp - 1].fValue =
+          stack[vm->sp - 1].fValue * stack[vm->sp].fValue;
+      NEXT;
+
+    // Three-address instructions on frame slots (see optimizer)
+    CASE(CMD_MOVE):
+      ENSURE_NEED(SLOT_NEED(code.code.param));
+      ptr = slot(vm, SLOT_A(code.code.param2));
+      ENSURE(ptr, ERR_EXEC_VAR_INV);
+      memcpy(&value, ptr, sizeof(value));
+      ptr = slot(vm, SLOT_DST(code.code.param));
+      ENSURE(ptr, ERR_EXEC_VAR_INV);
+      memcpy(ptr, &value, sizeof(value));
+      NEXT;
+    CASE(CMD_IF_NEQ_SS):   SLOT_IF(SLOT_B_VAR(),      !=); NEXT;
+    CASE(CMD_IF_NEQ_SK):   SLOT_IF(SLOT_B_CONST(),    !=); NEXT;
+    CASE(CMD_IF_LTEQ_SS):  SLOT_IF(SLOT_B_VAR(),      <=); NEXT;
+    CASE(CMD_IF_LTEQ_SK):  SLOT_IF(SLOT_B_CONST(),    <=); NEXT;
+    CASE(CMD_IF_GTEQ_SS):  SLOT_IF(SLOT_B_VAR(),      >=); NEXT;
+    CASE(CMD_IF_GTEQ_SK):  SLOT_IF(SLOT_B_CONST(),    >=); NEXT;
+    CASE(CMD_IF_LT_SS):    SLOT_IF(SLOT_B_VAR(),      <);  NEXT;
+    CASE(CMD_IF_LT_SK):    SLOT_IF(SLOT_B_CONST(),    <);  NEXT;
+    CASE(CMD_IF_GT_SS):    SLOT_IF(SLOT_B_VAR(),      >);  NEXT;
+    CASE(CMD_IF_GT_SK):    SLOT_IF(SLOT_B_CONST(),    >);  NEXT;
+    CASE(CMD_IF_EQUAL_SS): SLOT_IF(SLOT_B_VAR(),      ==); NEXT;
+    CASE(CMD_IF_EQUAL_SK): SLOT_IF(SLOT_B_CONST(),    ==); NEXT;
+    CASE(OP_PLUS_SS):      SLOT_ARITH(SLOT_B_VAR(),   +);  NEXT;
+    CASE(OP_PLUS_SK):      SLOT_ARITH(SLOT_B_CONST(), +);  NEXT;
+    CASE(OP_MINUS_SS):     SLOT_ARITH(SLOT_B_VAR(),   -);  NEXT;
+    CASE(OP_MINUS_SK):     SLOT_ARITH(SLOT_B_CONST(), -);  NEXT;
+    CASE(OP_MULT_SS):      SLOT_ARITH(SLOT_B_VAR(),   *);  NEXT;
+    CASE(OP_MULT_SK):      SLOT_ARITH(SLOT_B_CONST(), *);  NEXT;
       // clang-format on
 
-    case VAL_ZERO:
-      CHECK(pushInt(0));
-      return pc;
-    case VAL_INTEGER:
-    case VAL_FLOAT:
-    case VAL_STRING:
-    case VAL_PTR:
-      CHECK(pushCode(&code.code));
-      return pc;
-    default:
+    CASE(VAL_ZERO):
+      CHECK(pushInt(vm, 0));
+      NEXT;
+    CASE(VAL_INTEGER):
+    CASE(VAL_FLOAT):
+    CASE(VAL_STRING):
+    CASE(VAL_PTR):
+      CHECK(pushCode(vm, &code.code));
+      NEXT;
+    DEFAULT:
       return ERR_EXEC_CMD_INV;
+  DISPATCH_END
+#if THREADED
+done:
+#endif
+  *ppc = pc;
+  return EXEC_RUN_BUDGET;
+}
+
+//=============================================================================
+// Public functions
+//=============================================================================
+int exec(sVm* vm, sSys* sys, idxType pc)
+{
+  int res;
+  CHECK(res = run(vm, sys, &pc, 1));
+  return pc;
+}
+
+//-----------------------------------------------------------------------------
+int exec_run(sVm* vm, sSys* sys, idxType* pc, int budget, int timeout)
+{
+  int start = (timeout >= 0 && sys->getTick) ? sys->getTick() : 0;
+  int res;
+
+  while (budget > 0)
+  {
+    // Read the clock only every EXEC_TICK_CHECK instructions
+    int cnt = (budget < EXEC_TICK_CHECK) ? budget : EXEC_TICK_CHECK;
+    budget -= cnt;
+    CHECK(res = run(vm, sys, pc, cnt));
+    if (res != EXEC_RUN_BUDGET)
+      return res;
+    if (timeout >= 0 && sys->getTick && sys->getTick() - start >= timeout)
+      return EXEC_RUN_TIMEOUT;
+  }
+  return EXEC_RUN_BUDGET;
+}
+
+//-----------------------------------------------------------------------------
+int exec_decode(sVm* vm, sSys* sys)
+{
+#if EXEC_DECODE_CACHE > 0
+  for (int i = 0; i < EXEC_DECODE_CACHE; i++)
+    vm->cache[i].idx = -1;
+
+  // Cache covers the whole code memory -> decode everything in advance,
+  // otherwise only the hot instructions are decoded on first execution
+  if (EXEC_DECODE_CACHE >= CODE_MEM)
+  {
+    for (idxType idx = 0; idx < sys->getCodeNextIndex();
+         idx         = vm->cache[idx].next)
+    {
+      CHECK(decode(sys, &vm->cache[idx], idx));
+      if (vm->cache[idx].next <= idx)
+        break;
+    }
   }
+  return sizeof(vm->cache);
+#else
+  (void)vm;
+  (void)sys;
+  return 0;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void exec_stat(const sVm* vm)
+{
+#if STAT
+  printf("BASIC: %lu instructions executed" BASIC_OUT_EOL,
+         (unsigned long)vm->dispatchCnt);
+#else
+  (void)vm;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void exec_reset(sVm* vm)
+{
+  vm->sp = vm->fp = 0;
+#if STAT
+  vm->dispatchCnt = 0;
+#endif
 }
 
 //-----------------------------------------------------------------------------
-void exec_reset(void)
+void exec_flush(const sSys* sys)
 {
-  sp = fp = 0;
+#if JIT
+  jit_reset(sys);
+#else
+  (void)sys;
+#endif
 }
@@ -0,0 +1,298 @@
+#include "basic_image.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include "basic_exec.h"
+#include <stddef.h>
+#include <string.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define IMAGE_OPS  (VAL_LABEL + 1)
+#define CRC_OFFSET offsetof(sImageHeader, crc)
+
+// Instruction lengths: operator byte and the used operand bytes
+#define LEN_OP     1
+#define LEN_PARAM  (LEN_OP + sizeof(idxType))
+#define LEN_PARAM2 (LEN_OP + 2 * sizeof(idxType))
+#define LEN_VALUE  (LEN_OP + sizeof(iType))
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static uint32_t checksum(const sImageHeader* header, const sImage* image)
+{
+  uint32_t crc = image_crc(0, header, CRC_OFFSET);
+  crc          = image_crc(crc, image->code, image->codeLen);
+  return image_crc(crc, image->strings, image->strLen);
+}
+
+//=============================================================================
+// Public functions
+//=============================================================================
+uint32_t image_crc(uint32_t crc, const void* data, int len)
+{
+  // Bitwise CRC-32 (IEEE), no table to save flash
+  const uint8_t* p = data;
+  crc              = ~crc;
+  while (len-- > 0)
+  {
+    crc ^= *p++;
+    for (int i = 0; i < 8; i++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+//-----------------------------------------------------------------------------
+int image_codeLen(eOp op)
+{
+  // Operator byte followed by the used operand bytes
+  switch (op)
+  {
+    case CMD_INVALID:
+    case CMD_NOP:
+    case CMD_END:
+    case OP_NEQ:
+    case OP_LTEQ:
+    case OP_GTEQ:
+    case OP_LT:
+    case OP_GT:
+    case OP_EQUAL:
+    case OP_XOR:
+    case OP_OR:
+    case OP_AND:
+    case OP_NOT:
+    case OP_SHL:
+    case OP_SHR:
+    case OP_PLUS:
+    case OP_MINUS:
+    case OP_MOD:
+    case OP_MULT:
+    case OP_DIV:
+    case OP_IDIV:
+    case OP_POW:
+    case OP_SIGN:
+    case OP_NEQ_II:
+    case OP_LTEQ_II:
+    case OP_GTEQ_II:
+    case OP_LT_II:
+    case OP_GT_II:
+    case OP_EQUAL_II:
+    case OP_PLUS_II:
+    case OP_MINUS_II:
+    case OP_MULT_II:
+    case OP_PLUS_QI:
+    case OP_PLUS_QF:
+    case OP_MINUS_QI:
+    case OP_MINUS_QF:
+    case OP_MULT_QI:
+    case OP_MULT_QF:
+    case VAL_ZERO:
+      return LEN_OP;
+    case CMD_PRINT:
+    case CMD_LET_PTR:
+    case CMD_LET_REG:
+    case CMD_IF:
+    case CMD_GOTO:
+    case LNK_GOTO:
+    case CMD_GOSUB:
+    case LNK_GOSUB:
+    case CMD_RETURN:
+    case CMD_POP:
+    case CMD_SVC:
+    case CMD_GET_PTR:
+    case CMD_GET_REG:
+    case CMD_IF_NEQ:
+    case CMD_IF_LTEQ:
+    case CMD_IF_GTEQ:
+    case CMD_IF_LT:
+    case CMD_IF_GT:
+    case CMD_IF_EQUAL:
+    case CMD_IF_NEQ_II:
+    case CMD_IF_LTEQ_II:
+    case CMD_IF_GTEQ_II:
+    case CMD_IF_LT_II:
+    case CMD_IF_GT_II:
+    case CMD_IF_EQUAL_II:
+    case CMD_IF_NEQ_QI:
+    case CMD_IF_NEQ_QF:
+    case CMD_IF_LTEQ_QI:
+    case CMD_IF_LTEQ_QF:
+    case CMD_IF_GTEQ_QI:
+    case CMD_IF_GTEQ_QF:
+    case CMD_IF_LT_QI:
+    case CMD_IF_LT_QF:
+    case CMD_IF_GT_QI:
+    case CMD_IF_GT_QF:
+    case CMD_IF_EQUAL_QI:
+    case CMD_IF_EQUAL_QF:
+      return LEN_PARAM;
+    case CMD_LET_GLOBAL:
+    case CMD_LET_LOCAL:
+    case CMD_GET_GLOBAL:
+    case CMD_GET_LOCAL:
+    case CMD_CREATE_PTR:
+    case CMD_INC_GLOBAL:
+    case CMD_INC_LOCAL:
+    case CMD_LETI_GLOBAL:
+    case CMD_LETI_LOCAL:
+    case CMD_FOR_GLOBAL:
+    case CMD_FOR_LOCAL:
+    case CMD_NEXT_GLOBAL:
+    case CMD_NEXT_LOCAL:
+    case CMD_MOVE:
+    case CMD_IF_NEQ_SS:
+    case CMD_IF_NEQ_SK:
+    case CMD_IF_LTEQ_SS:
+    case CMD_IF_LTEQ_SK:
+    case CMD_IF_GTEQ_SS:
+    case CMD_IF_GTEQ_SK:
+    case CMD_IF_LT_SS:
+    case CMD_IF_LT_SK:
+    case CMD_IF_GT_SS:
+    case CMD_IF_GT_SK:
+    case CMD_IF_EQUAL_SS:
+    case CMD_IF_EQUAL_SK:
+    case OP_PLUS_SS:
+    case OP_PLUS_SK:
+    case OP_MINUS_SS:
+    case OP_MINUS_SK:
+    case OP_MULT_SS:
+    case OP_MULT_SK:
+    case VAL_STRING:
+    case VAL_PTR:
+      return LEN_PARAM2;
+    case VAL_INTEGER:
+    case VAL_FLOAT:
+      return LEN_VALUE;
+    default:
+      return ERR_EXEC_CMD_INV;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool image_isJump(eOp op)
+{
+  // Instructions with a code index as param
+  switch (op)
+  {
+    case CMD_IF:
+    case CMD_GOTO:
+    case CMD_GOSUB:
+    case CMD_FOR_GLOBAL:
+    case CMD_FOR_LOCAL:
+    case CMD_NEXT_GLOBAL:
+    case CMD_NEXT_LOCAL:
+    case CMD_IF_NEQ:
+    case CMD_IF_LTEQ:
+    case CMD_IF_GTEQ:
+    case CMD_IF_LT:
+    case CMD_IF_GT:
+    case CMD_IF_EQUAL:
+    case CMD_IF_NEQ_II:
+    case CMD_IF_LTEQ_II:
+    case CMD_IF_GTEQ_II:
+    case CMD_IF_LT_II:
+    case CMD_IF_GT_II:
+    case CMD_IF_EQUAL_II:
+    case CMD_IF_NEQ_QI:
+    case CMD_IF_NEQ_QF:
+    case CMD_IF_LTEQ_QI:
+    case CMD_IF_LTEQ_QF:
+    case CMD_IF_GTEQ_QI:
+    case CMD_IF_GTEQ_QF:
+    case CMD_IF_LT_QI:
+    case CMD_IF_LT_QF:
+    case CMD_IF_GT_QI:
+    case CMD_IF_GT_QF:
+    case CMD_IF_EQUAL_QI:
+    case CMD_IF_EQUAL_QF:
+    case CMD_IF_NEQ_SS:
+    case CMD_IF_NEQ_SK:
+    case CMD_IF_LTEQ_SS:
+    case CMD_IF_LTEQ_SK:
+    case CMD_IF_GTEQ_SS:
+    case CMD_IF_GTEQ_SK:
+    case CMD_IF_LT_SS:
+    case CMD_IF_LT_SK:
+    case CMD_IF_GT_SS:
+    case CMD_IF_GT_SK:
+    case CMD_IF_EQUAL_SS:
+    case CMD_IF_EQUAL_SK:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+uint32_t image_signature(const sSys* sys)
+{
+  // Bytecode refers to registers and SVCs by index, the code format is
+  // defined by sys->getCodeLen
+  uint32_t crc = 0;
+  uint8_t  len;
+
+  for (int i = 0; i < (int)ARRAY_SIZE(sys->regs); i++)
+    if (sys->regs[i].name)
+      crc = image_crc(crc, sys->regs[i].name, strlen(sys->regs[i].name) + 1);
+  crc = image_crc(crc, "", 1);
+  for (int i = 0; i < (int)ARRAY_SIZE(sys->svcs); i++)
+  {
+    if (sys->svcs[i].name)
+    {
+      len = sys->svcs[i].argc;
+      crc = image_crc(crc, sys->svcs[i].name, strlen(sys->svcs[i].name) + 1);
+      crc = image_crc(crc, &len, 1);
+    }
+  }
+  for (int op = 0; op < IMAGE_OPS; op++)
+  {
+    len = sys->getCodeLen(op);
+    crc = image_crc(crc, &len, 1);
+  }
+  return crc;
+}
+
+//-----------------------------------------------------------------------------
+int image_header(const sSys* sys, const sImage* image, sImageHeader* header)
+{
+  // Header to store in front of the sections, returns the image size
+  ENSURE(image->codeLen <= CODE_MEM && image->strLen <= STRING_MEM,
+         ERR_IMAGE_SIZE);
+  memset(header, 0, sizeof(*header));
+  header->magic     = IMAGE_MAGIC;
+  header->version   = IMAGE_VERSION;
+  header->ops       = IMAGE_OPS;
+  header->signature = image_signature(sys);
+  header->codeLen   = image->codeLen;
+  header->strLen    = image->strLen;
+  header->crc       = checksum(header, image);
+  return IMAGE_SIZE(image->codeLen, image->strLen);
+}
+
+//-----------------------------------------------------------------------------
+int image_open(const sSys* sys, const void* data, int size, sImage* image)
+{
+  // Checks an image in memory (e.g. flash or a mapped file), the sections
+  // are used in place
+  sImageHeader header;
+
+  ENSURE(size >= (int)sizeof(header), ERR_IMAGE_SIZE);
+  memcpy(&header, data, sizeof(header));  // Data may be unaligned
+  ENSURE(header.magic == IMAGE_MAGIC, ERR_IMAGE_MAGIC);
+  ENSURE(header.version == IMAGE_VERSION && header.ops == IMAGE_OPS,
+         ERR_IMAGE_VERSION);
+  ENSURE(header.codeLen <= CODE_MEM && header.strLen <= STRING_MEM &&
+             IMAGE_SIZE(header.codeLen, header.strLen) <= size,
+         ERR_IMAGE_SIZE);
+
+  image->code    = (const char*)data + sizeof(header);
+  image->codeLen = header.codeLen;
+  image->strings = image->code + header.codeLen;
+  image->strLen  = header.strLen;
+  ENSURE(checksum(&header, image) == header.crc, ERR_IMAGE_CRC);
+  ENSURE(header.signature == image_signature(sys), ERR_IMAGE_SIGNATURE);
+  return 0;
+}
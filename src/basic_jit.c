@@ -0,0 +1,1078 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS with -std=c99
+
+#include "basic_jit.h"
+#include "basic_common.h"
+#include "basic_config.h"
+
+#if JIT
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define JIT_MEM         (EXEC_JIT_MEM * 1024)  // Executable memory [bytes]
+#define JIT_MAX_REGIONS MAX_SUB_NUM            // Subs with call counter
+#define JIT_MAX_INSTR   256                    // Max. instructions of a sub
+#define JIT_MAX_FIXUPS  (JIT_MAX_INSTR * 8)    // Jumps to resolve per sub
+#define JIT_ALIGN       16                     // Alignment of a compiled sub
+
+#define OFS_OP  ((int)offsetof(sCode, op))
+#define OFS_VAL ((int)offsetof(sCode, iValue))
+#define OFS_LBL ((int)offsetof(sCode, lbl.lbl))
+#define OFS_FP  ((int)offsetof(sCode, lbl.fp))
+#define STATE(x) ((int)offsetof(sJitState, x))
+
+// Registers of compiled code
+#define R_STATE  RBX  // sJitState*
+#define R_BUDGET RBP  // Instruction budget
+#define R_STACK  R12  // &stack[0]
+#define R_SP     R13  // Stack pointer
+#define R_FP     R14  // Frame pointer
+#define R_CNT    R15  // Executed instructions
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// x86-64 registers (encoding)
+typedef enum
+{
+  NONE = -1,
+  RAX  = 0,
+  RCX,
+  RDX,
+  RBX,
+  RSP,
+  RBP,
+  RSI,
+  RDI,
+  R12 = 12,
+  R13,
+  R14,
+  R15,
+} eReg;
+
+//-----------------------------------------------------------------------------
+// x86-64 condition codes (negated by ^ 1)
+typedef enum
+{
+  CC_ALWAYS = -1,
+  CC_AE     = 0x3,
+  CC_E      = 0x4,
+  CC_NE     = 0x5,
+  CC_S      = 0x8,
+  CC_L      = 0xC,
+  CC_GE     = 0xD,
+  CC_LE     = 0xE,
+  CC_G      = 0xF,
+} eCond;
+
+//-----------------------------------------------------------------------------
+typedef enum
+{
+  REGION_FREE,      // Unused
+  REGION_COUNTING,  // Sub is called, not hot yet
+  REGION_COMPILED,  // Native code available
+  REGION_FAILED,    // Can't be compiled, interpreter only
+} eRegion;
+
+//-----------------------------------------------------------------------------
+typedef struct
+{
+  const sSys* sys;                  // Program of the sub
+  idxType     entry;                // Code index of the sub
+  idxType     end;                  // Code index after the last instruction
+  eRegion     state;                //
+  int         calls;                // Calls while counting
+  int         cnt;                  // Compiled instructions
+  uint8_t*    code;                 // Native code (starts with the prologue)
+  idxType     pcs[JIT_MAX_INSTR];   // Code index of the instructions
+  uint32_t    ofs[JIT_MAX_INSTR];   // Native offset of the instructions
+} sRegion;
+
+//-----------------------------------------------------------------------------
+typedef enum
+{
+  FIX_INSTR,     // Jump to a compiled instruction
+  FIX_EXIT,      // Leave compiled code, interpreter continues at <pc>
+  FIX_EPILOGUE,  // Leave compiled code, pc is in eax
+} eFixup;
+
+//-----------------------------------------------------------------------------
+typedef struct
+{
+  int    pos;     // Position of rel32
+  eFixup kind;    //
+  int    target;  // FIX_INSTR: instruction, FIX_EXIT: code index
+  int    stub;    // FIX_EXIT: position of the exit stub
+} sFixup;
+
+//-----------------------------------------------------------------------------
+// Stack entry: stack[<index> + idx] (index NONE: absolute)
+typedef struct
+{
+  eReg index;
+  int  idx;
+} sVar;
+
+//-----------------------------------------------------------------------------
+typedef void (*fNative)(sJitState* state, const uint8_t* start);
+
+//=============================================================================
+// Private variables
+//=============================================================================
+// The JIT is used by one thread at a time, others execute in the interpreter
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static sRegion  regions[JIT_MAX_REGIONS];
+static uint8_t* mem;      // Executable memory
+static int      memUsed;  // Used by compiled subs
+static int      compiled; // Number of compiled subs
+static bool     disabled; // Interpreter only (see jit_enable())
+
+// Compiler state
+static sRegion* region;   // Region being compiled
+static sCode    ins[JIT_MAX_INSTR];
+static idxType  curPc;    // Code index of the current instruction
+static uint8_t* out;      // Native code of the region
+static int      pos;      // Emit position
+static int      room;     // Available bytes at out
+static sFixup   fixups[JIT_MAX_FIXUPS];
+static int      fixupCnt;
+
+//=============================================================================
+// Private functions: Assembler
+//=============================================================================
+static void emit8(int value)
+{
+  if (pos < room)
+    out[pos] = (uint8_t)value;
+  pos++;
+}
+
+//-----------------------------------------------------------------------------
+static void emit32(int32_t value)
+{
+  for (int i = 0; i < 4; i++)
+    emit8((uint32_t)value >> (8 * i));
+}
+
+//-----------------------------------------------------------------------------
+static void emitRex(int w, int reg, int index, int base)
+{
+  int rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) |
+            ((index != NONE && (index & 8)) ? 2 : 0) | ((base & 8) ? 1 : 0);
+  if (rex != 0x40)
+    emit8(rex);
+}
+
+//-----------------------------------------------------------------------------
+static void emitOp(int op)
+{
+  // Two byte opcodes are passed as 0x0Fxx
+  if (op > 0xFF)
+    emit8(op >> 8);
+  emit8(op & 0xFF);
+}
+
+//-----------------------------------------------------------------------------
+static void opReg(int w, int op, int reg, int rm)
+{
+  // <op> reg, rm (reg: register or opcode extension)
+  emitRex(w, reg, NONE, rm);
+  emitOp(op);
+  emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+//-----------------------------------------------------------------------------
+static void opMem(int w, int op, int reg, int base, int index, int32_t disp)
+{
+  // <op> reg, [base + index * 8 + disp32]
+  emitRex(w, reg, index, base);
+  emitOp(op);
+  if (index == NONE && (base & 7) != RSP)
+  {
+    emit8(0x80 | ((reg & 7) << 3) | (base & 7));
+  }
+  else
+  {
+    emit8(0x84 | ((reg & 7) << 3));
+    emit8((index == NONE) ? (0x20 | (base & 7))
+                          : (0xC0 | ((index & 7) << 3) | (base & 7)));
+  }
+  emit32(disp);
+}
+
+//-----------------------------------------------------------------------------
+static void opVar(int w, int op, int reg, sVar var, int ofs)
+{
+  opMem(w, op, reg, R_STACK, var.index, var.idx * (int)sizeof(sCode) + ofs);
+}
+
+//-----------------------------------------------------------------------------
+static void opImm(int op, int ext, int rm, int32_t imm)
+{
+  // <op> rm, imm32 (0x81: ext = 0 add, 5 sub, 7 cmp)
+  opReg(0, op, ext, rm);
+  emit32(imm);
+}
+
+//-----------------------------------------------------------------------------
+static void push(eReg reg)
+{
+  emitRex(0, 0, NONE, reg);
+  emit8(0x50 | (reg & 7));
+}
+
+//-----------------------------------------------------------------------------
+static void pop(eReg reg)
+{
+  emitRex(0, 0, NONE, reg);
+  emit8(0x58 | (reg & 7));
+}
+
+//-----------------------------------------------------------------------------
+static int jump(eCond cc)
+{
+  // jcc/jmp rel32, returns the position of rel32
+  if (cc == CC_ALWAYS)
+  {
+    emit8(0xE9);
+  }
+  else
+  {
+    emit8(0x0F);
+    emit8(0x80 | cc);
+  }
+  emit32(0);
+  return pos - 4;
+}
+
+//-----------------------------------------------------------------------------
+static void patch(int at, int target)
+{
+  int32_t rel = target - (at + 4);
+  for (int i = 0; i < 4 && at + i < room; i++)
+    out[at + i] = (uint8_t)((uint32_t)rel >> (8 * i));
+}
+
+//-----------------------------------------------------------------------------
+static void fixup(int at, eFixup kind, int target)
+{
+  if (fixupCnt < JIT_MAX_FIXUPS)
+  {
+    fixups[fixupCnt].pos    = at;
+    fixups[fixupCnt].kind   = kind;
+    fixups[fixupCnt].target = target;
+  }
+  fixupCnt++;  // Overflow fails the compilation
+}
+
+//=============================================================================
+// Private functions: Templates
+//=============================================================================
+static int findInstr(const sRegion* r, idxType pc)
+{
+  int lo = 0;
+  int hi = r->cnt - 1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    if (r->pcs[mid] == pc)
+      return mid;
+    if (r->pcs[mid] < pc)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+static void branch(eCond cc, idxType pc)
+{
+  // Jump to bytecode pc, compiled or back to the interpreter
+  int idx = findInstr(region, pc);
+  if (idx >= 0)
+    fixup(jump(cc), FIX_INSTR, idx);
+  else
+    fixup(jump(cc), FIX_EXIT, pc);
+}
+
+//-----------------------------------------------------------------------------
+static void bail(eCond cc)
+{
+  // Let the interpreter execute the current instruction (nothing changed yet)
+  fixup(jump(cc), FIX_EXIT, curPc);
+}
+
+//-----------------------------------------------------------------------------
+static sVar top(int n)
+{
+  sVar var = {R_SP, -n};  // stack[sp - n]
+  return var;
+}
+
+//-----------------------------------------------------------------------------
+static sVar frame(int idx)
+{
+  sVar var = {R_FP, idx};  // stack[fp + idx]
+  return var;
+}
+
+//-----------------------------------------------------------------------------
+static sVar global(int idx)
+{
+  sVar var = {NONE, idx};  // stack[idx]
+  return var;
+}
+
+//-----------------------------------------------------------------------------
+static void checkBudget(void)
+{
+  opReg(0, 0x85, R_BUDGET, R_BUDGET);  // test ebp, ebp
+  bail(CC_LE);
+}
+
+//-----------------------------------------------------------------------------
+static void checkDepth(int n)
+{
+  opImm(0x81, 7, R_SP, n);  // cmp r13d, n
+  bail(CC_L);
+}
+
+//-----------------------------------------------------------------------------
+static void checkRoom(void)
+{
+  opImm(0x81, 7, R_SP, STACK_SIZE);  // cmp r13d, STACK_SIZE
+  bail(CC_GE);
+}
+
+//-----------------------------------------------------------------------------
+static void checkNeed(int n)
+{
+  // Room of the stack code a slot instruction replaces (see SLOT_NEED)
+  opImm(0x81, 7, R_SP, STACK_SIZE - n);  // cmp r13d, STACK_SIZE - n
+  bail(CC_G);
+}
+
+//-----------------------------------------------------------------------------
+static void checkInt(sVar var)
+{
+  opVar(0, 0x81, 7, var, OFS_OP);  // cmp dword [var.op], VAL_INTEGER
+  emit32(VAL_INTEGER);
+  bail(CC_NE);
+}
+
+//-----------------------------------------------------------------------------
+static void checkVar(sVar var, int above)
+{
+  // Variable must be on the stack, below <above> entries (FOR/NEXT)
+  if (var.index == NONE)
+  {
+    if (var.idx < 0)
+    {
+      bail(CC_ALWAYS);
+      return;
+    }
+    opImm(0x81, 7, R_SP, var.idx + above);  // cmp r13d, idx + above
+    bail(CC_LE);
+    return;
+  }
+  opMem(0, 0x8D, RAX, R_FP, NONE, var.idx);  // lea eax, [r14 + idx]
+  opReg(0, 0x85, RAX, RAX);                  // test eax, eax
+  bail(CC_S);
+  opMem(0, 0x8D, RAX, RAX, NONE, above);     // lea eax, [rax + above]
+  opReg(0, 0x3B, RAX, R_SP);                 // cmp eax, r13d
+  bail(CC_GE);
+}
+
+//-----------------------------------------------------------------------------
+static void checkSlot(int idx)
+{
+  // Slot instructions only check the stack array (see slot())
+  opMem(0, 0x8D, RAX, R_FP, NONE, idx);  // lea eax, [r14 + idx]
+  opImm(0x81, 7, RAX, STACK_SIZE);       // cmp eax, STACK_SIZE
+  bail(CC_AE);
+}
+
+//-----------------------------------------------------------------------------
+static void commit(void)
+{
+  // All checks passed: count the instruction (flags are modified)
+  opReg(0, 0xFF, 1, R_BUDGET);  // dec ebp
+  opReg(0, 0xFF, 0, R_CNT);     // inc r15d
+}
+
+//-----------------------------------------------------------------------------
+static void pushConst(const sCode* value)
+{
+  uint64_t raw;
+  memcpy(&raw, value, sizeof(raw));
+  checkBudget();
+  checkRoom();
+  commit();
+  emitRex(1, 0, NONE, RAX);  // mov rax, imm64
+  emit8(0xB8);
+  emit32((uint32_t)raw);
+  emit32((uint32_t)(raw >> 32));
+  opVar(1, 0x89, RAX, top(0), 0);  // mov [stack[sp]], rax
+  opReg(0, 0xFF, 0, R_SP);         // inc r13d
+}
+
+//-----------------------------------------------------------------------------
+static void getVar(sVar var)
+{
+  checkBudget();
+  checkVar(var, 0);
+  checkRoom();
+  commit();
+  opVar(1, 0x8B, RAX, var, 0);     // mov rax, [var]
+  opVar(1, 0x89, RAX, top(0), 0);  // mov [stack[sp]], rax
+  opReg(0, 0xFF, 0, R_SP);         // inc r13d
+}
+
+//-----------------------------------------------------------------------------
+static void letVar(sVar var)
+{
+  checkBudget();
+  checkVar(var, 0);
+  commit();
+  opVar(1, 0x8B, RAX, top(1), 0);  // mov rax, [stack[sp - 1]]
+  opVar(1, 0x89, RAX, var, 0);     // mov [var], rax
+  opReg(0, 0xFF, 1, R_SP);         // dec r13d
+}
+
+//-----------------------------------------------------------------------------
+static void incVar(sVar var, int value)
+{
+  checkBudget();
+  checkVar(var, 0);
+  checkInt(var);
+  commit();
+  opVar(0, 0x81, 0, var, OFS_VAL);  // add dword [var.iValue], value
+  emit32(value);
+}
+
+//-----------------------------------------------------------------------------
+static void letInt(sVar var, int value)
+{
+  checkBudget();
+  checkVar(var, 0);
+  commit();
+  opVar(0, 0xC7, 0, var, OFS_OP);  // mov dword [var.op], VAL_INTEGER
+  emit32(VAL_INTEGER);
+  opVar(0, 0xC7, 0, var, OFS_VAL);  // mov dword [var.iValue], value
+  emit32(value);
+}
+
+//-----------------------------------------------------------------------------
+static void forLoop(sVar var, idxType lbl, bool next)
+{
+  // Integer loops only, limit and step are on top of the stack. FOR leaves
+  // the loop if the variable is out of range, NEXT jumps back if in range
+  int neg, done;
+  checkBudget();
+  checkVar(var, 2);
+  checkInt(var);
+  checkInt(top(2));
+  checkInt(top(1));
+  commit();
+  opVar(0, 0x8B, RCX, var, OFS_VAL);  // mov ecx, [var]
+  if (next)
+  {
+    opVar(0, 0x03, RCX, top(1), OFS_VAL);  // add ecx, [step]
+    opVar(0, 0x89, RCX, var, OFS_VAL);     // mov [var], ecx
+  }
+  opVar(0, 0x81, 7, top(1), OFS_VAL);  // cmp dword [step], 0
+  emit32(0);
+  neg = jump(CC_L);
+  opVar(0, 0x3B, RCX, top(2), OFS_VAL);  // cmp ecx, [limit]
+  branch(next ? CC_LE : CC_G, lbl);
+  done = jump(CC_ALWAYS);
+  patch(neg, pos);
+  opVar(0, 0x3B, RCX, top(2), OFS_VAL);  // cmp ecx, [limit]
+  branch(next ? CC_GE : CC_L, lbl);
+  patch(done, pos);
+}
+
+//-----------------------------------------------------------------------------
+static void ifCompare(eCond cc, idxType lbl, bool guard)
+{
+  checkBudget();
+  checkDepth(2);
+  if (guard)
+  {
+    checkInt(top(2));
+    checkInt(top(1));
+  }
+  commit();
+  opVar(0, 0x8B, RAX, top(2), OFS_VAL);   // mov eax, [a]
+  opVar(0, 0x3B, RAX, top(1), OFS_VAL);   // cmp eax, [b]
+  opMem(0, 0x8D, R_SP, R_SP, NONE, -2);   // lea r13d, [r13 - 2]
+  branch(cc ^ 1, lbl);
+}
+
+//-----------------------------------------------------------------------------
+static void arith(int op, bool guard)
+{
+  // a = a <op> b, op: add, sub, imul, and, or, xor eax, [b]
+  checkBudget();
+  checkDepth(2);
+  if (guard)
+  {
+    checkInt(top(2));
+    checkInt(top(1));
+  }
+  commit();
+  opVar(0, 0x8B, RAX, top(2), OFS_VAL);  // mov eax, [a]
+  opVar(0, op, RAX, top(1), OFS_VAL);    // <op> eax, [b]
+  opVar(0, 0x89, RAX, top(2), OFS_VAL);  // mov [a], eax
+  opReg(0, 0xFF, 1, R_SP);               // dec r13d
+}
+
+//-----------------------------------------------------------------------------
+static void compare(eCond cc, bool guard)
+{
+  // a = (a <cc> b) ? -1 : 0
+  checkBudget();
+  checkDepth(2);
+  if (guard)
+  {
+    checkInt(top(2));
+    checkInt(top(1));
+  }
+  commit();
+  opVar(0, 0x8B, RAX, top(2), OFS_VAL);  // mov eax, [a]
+  opVar(0, 0x3B, RAX, top(1), OFS_VAL);  // cmp eax, [b]
+  opReg(0, 0x0F90 | cc, 0, RAX);         // setcc al
+  opReg(0, 0x0FB6, RAX, RAX);            // movzx eax, al
+  opReg(0, 0xF7, 3, RAX);                // neg eax
+  opVar(0, 0x89, RAX, top(2), OFS_VAL);  // mov [a], eax
+  opReg(0, 0xFF, 1, R_SP);               // dec r13d
+}
+
+//-----------------------------------------------------------------------------
+static void unary(int ext)
+{
+  // a = <op> a, ext: 2 not, 3 neg
+  checkBudget();
+  checkDepth(1);
+  checkInt(top(1));
+  commit();
+  opVar(0, 0xF7, ext, top(1), OFS_VAL);
+}
+
+//-----------------------------------------------------------------------------
+static void ifTrue(idxType lbl)
+{
+  checkBudget();
+  checkDepth(1);
+  checkInt(top(1));
+  commit();
+  opVar(0, 0x8B, RAX, top(1), OFS_VAL);  // mov eax, [a]
+  opReg(0, 0xFF, 1, R_SP);               // dec r13d
+  opReg(0, 0x85, RAX, RAX);              // test eax, eax
+  branch(CC_E, lbl);
+}
+
+//-----------------------------------------------------------------------------
+static void returnSub(int cnt)
+{
+  checkBudget();
+  opMem(0, 0x8D, RAX, R_FP, NONE, 1);  // lea eax, [r14 + 1]
+  opReg(0, 0x3B, R_SP, RAX);           // cmp r13d, eax
+  bail(CC_L);
+  opMem(0, 0x81, 7, R_STACK, R_FP, OFS_OP);  // cmp [stack[fp].op], VAL_LABEL
+  emit32(VAL_LABEL);
+  bail(CC_NE);
+  opMem(0, 0x0FBF, RAX, R_STACK, R_FP, OFS_LBL);  // movsx eax, [stack[fp].lbl]
+  opReg(0, 0x85, RAX, RAX);                       // test eax, eax
+  bail(CC_S);
+  commit();
+  opMem(0, 0x0FBF, RCX, R_STACK, R_FP, OFS_FP);  // movsx ecx, [stack[fp].fp]
+  opMem(0, 0x8D, R_SP, R_FP, NONE, -cnt);        // lea r13d, [r14 - cnt]
+  opReg(0, 0x8B, R_FP, RCX);                     // mov r14d, ecx
+  fixup(jump(CC_ALWAYS), FIX_EPILOGUE, 0);
+}
+
+//-----------------------------------------------------------------------------
+static void slotMove(int dst, int need, int a)
+{
+  checkBudget();
+  checkNeed(need);
+  checkSlot(a);
+  checkSlot(dst);
+  commit();
+  opVar(1, 0x8B, RAX, frame(a), 0);    // mov rax, [a]
+  opVar(1, 0x89, RAX, frame(dst), 0);  // mov [dst], rax
+}
+
+//-----------------------------------------------------------------------------
+static void slotLoad(int need, int a, int b, bool isConst)
+{
+  // Checks of a slot instruction: stack room, slots valid, operands integer
+  checkBudget();
+  checkNeed(need);
+  checkSlot(a);
+  if (!isConst)
+    checkSlot(b);
+  checkInt(frame(a));
+  if (!isConst)
+    checkInt(frame(b));
+}
+
+//-----------------------------------------------------------------------------
+static void slotArith(int op, int ext, idxType param, int a, int b,
+                      bool isConst)
+{
+  // dst = a <op> b (op: add, sub, imul eax, [b], ext: 0x81 extension)
+  int dst = SLOT_DST(param);
+
+  slotLoad(SLOT_NEED(param), a, b, isConst);
+  checkSlot(dst);
+  commit();
+  opVar(0, 0x8B, RAX, frame(a), OFS_VAL);  // mov eax, [a]
+  if (!isConst)
+    opVar(0, op, RAX, frame(b), OFS_VAL);  // <op> eax, [b]
+  else if (ext >= 0)
+    opImm(0x81, ext, RAX, b);  // add/sub eax, k
+  else
+    opImm(0x69, RAX, RAX, b);  // imul eax, eax, k
+  opVar(0, 0xC7, 0, frame(dst), OFS_OP);  // mov dword [dst.op], VAL_INTEGER
+  emit32(VAL_INTEGER);
+  opVar(0, 0x89, RAX, frame(dst), OFS_VAL);  // mov [dst], eax
+}
+
+//-----------------------------------------------------------------------------
+static void slotIf(eCond cc, idxType lbl, int a, int b, bool isConst)
+{
+  slotLoad(SLOT_NEED_IF, a, b, isConst);
+  commit();
+  opVar(0, 0x8B, RAX, frame(a), OFS_VAL);  // mov eax, [a]
+  if (isConst)
+    opImm(0x81, 7, RAX, b);  // cmp eax, k
+  else
+    opVar(0, 0x3B, RAX, frame(b), OFS_VAL);  // cmp eax, [b]
+  branch(cc ^ 1, lbl);
+}
+
+//-----------------------------------------------------------------------------
+static eCond condition(eOp op)
+{
+  // Compare instructions are ordered NEQ, LTEQ, GTEQ, LT, GT, EQUAL
+  static const eCond cc[] = {CC_NE, CC_LE, CC_GE, CC_L, CC_G, CC_E};
+  if (op >= CMD_IF_NEQ && op <= CMD_IF_EQUAL)
+    return cc[op - CMD_IF_NEQ];
+  if (op >= CMD_IF_NEQ_II && op <= CMD_IF_EQUAL_II)
+    return cc[op - CMD_IF_NEQ_II];
+  if (op >= CMD_IF_NEQ_QI && op <= CMD_IF_EQUAL_QF)
+    return cc[(op - CMD_IF_NEQ_QI) / 2];
+  if (op >= CMD_IF_NEQ_SS && op <= CMD_IF_EQUAL_SK)
+    return cc[(op - CMD_IF_NEQ_SS) / 2];
+  if (op >= OP_NEQ && op <= OP_EQUAL)
+    return cc[op - OP_NEQ];
+  return cc[op - OP_NEQ_II];
+}
+
+//-----------------------------------------------------------------------------
+static void compileInstr(const sCode* code)
+{
+  // Fast path of an instruction, everything else is left to the interpreter
+  sCode zero;
+  int   a = SLOT_A(code->param2);
+  int   b = SLOT_B(code->param2);
+
+  switch (code->op)
+  {
+    case CMD_LET_GLOBAL:
+      if (code->param2 > 0)
+        break;  // Array
+      letVar(global(code->param));
+      return;
+    case CMD_LET_LOCAL:
+      if (code->param2 > 0)
+        break;
+      letVar(frame(code->param));
+      return;
+    case CMD_GET_GLOBAL:
+      if (code->param2 > 0)
+        break;
+      getVar(global(code->param));
+      return;
+    case CMD_GET_LOCAL:
+      if (code->param2 > 0)
+        break;
+      getVar(frame(code->param));
+      return;
+    case CMD_IF:
+      ifTrue(code->param);
+      return;
+    case CMD_GOTO:
+      checkBudget();
+      commit();
+      branch(CC_ALWAYS, code->param);
+      return;
+    case CMD_RETURN:
+      returnSub(code->param);
+      return;
+    case CMD_POP:
+      checkBudget();
+      checkDepth(code->param + 1);
+      commit();
+      opImm(0x81, 5, R_SP, code->param + 1);  // sub r13d, cnt + 1
+      return;
+    case CMD_NOP:
+      checkBudget();
+      commit();
+      return;
+
+    // clang-format off
+    case CMD_INC_GLOBAL:  incVar(global(code->param), code->param2); return;
+    case CMD_INC_LOCAL:   incVar(frame(code->param), code->param2);  return;
+    case CMD_LETI_GLOBAL: letInt(global(code->param), code->param2); return;
+    case CMD_LETI_LOCAL:  letInt(frame(code->param), code->param2);  return;
+    case CMD_FOR_GLOBAL:  forLoop(global(code->param2), code->param, false); return;
+    case CMD_FOR_LOCAL:   forLoop(frame(code->param2),  code->param, false); return;
+    case CMD_NEXT_GLOBAL: forLoop(global(code->param2), code->param, true);  return;
+    case CMD_NEXT_LOCAL:  forLoop(frame(code->param2),  code->param, true);  return;
+
+    case CMD_IF_NEQ:    case CMD_IF_LTEQ:    case CMD_IF_GTEQ:
+    case CMD_IF_LT:     case CMD_IF_GT:      case CMD_IF_EQUAL:
+    case CMD_IF_NEQ_QI: case CMD_IF_LTEQ_QI: case CMD_IF_GTEQ_QI:
+    case CMD_IF_LT_QI:  case CMD_IF_GT_QI:   case CMD_IF_EQUAL_QI:
+      ifCompare(condition(code->op), code->param, true);
+      return;
+    case CMD_IF_NEQ_II: case CMD_IF_LTEQ_II: case CMD_IF_GTEQ_II:
+    case CMD_IF_LT_II:  case CMD_IF_GT_II:   case CMD_IF_EQUAL_II:
+      ifCompare(condition(code->op), code->param, false);
+      return;
+
+    case CMD_MOVE:
+      slotMove(SLOT_DST(code->param), SLOT_NEED(code->param), a);
+      return;
+    case CMD_IF_NEQ_SS: case CMD_IF_LTEQ_SS: case CMD_IF_GTEQ_SS:
+    case CMD_IF_LT_SS:  case CMD_IF_GT_SS:   case CMD_IF_EQUAL_SS:
+      slotIf(condition(code->op), code->param, a, b, false);
+      return;
+    case CMD_IF_NEQ_SK: case CMD_IF_LTEQ_SK: case CMD_IF_GTEQ_SK:
+    case CMD_IF_LT_SK:  case CMD_IF_GT_SK:   case CMD_IF_EQUAL_SK:
+      slotIf(condition(code->op), code->param, a, b, true);
+      return;
+    case OP_PLUS_SS:  slotArith(0x03,   -1, code->param, a, b, false); return;
+    case OP_PLUS_SK:  slotArith(0x03,    0, code->param, a, b, true);  return;
+    case OP_MINUS_SS: slotArith(0x2B,   -1, code->param, a, b, false); return;
+    case OP_MINUS_SK: slotArith(0x2B,    5, code->param, a, b, true);  return;
+    case OP_MULT_SS:  slotArith(0x0FAF, -1, code->param, a, b, false); return;
+    case OP_MULT_SK:  slotArith(0x0FAF, -1, code->param, a, b, true);  return;
+
+    case OP_NEQ:    case OP_LTEQ:    case OP_GTEQ:
+    case OP_LT:     case OP_GT:      case OP_EQUAL:
+      compare(condition(code->op), true);
+      return;
+    case OP_NEQ_II: case OP_LTEQ_II: case OP_GTEQ_II:
+    case OP_LT_II:  case OP_GT_II:   case OP_EQUAL_II:
+      compare(condition(code->op), false);
+      return;
+
+    case OP_PLUS:    case OP_PLUS_QI:  arith(0x03,   true);  return;
+    case OP_MINUS:   case OP_MINUS_QI: arith(0x2B,   true);  return;
+    case OP_MULT:    case OP_MULT_QI:  arith(0x0FAF, true);  return;
+    case OP_PLUS_II:                   arith(0x03,   false); return;
+    case OP_MINUS_II:                  arith(0x2B,   false); return;
+    case OP_MULT_II:                   arith(0x0FAF, false); return;
+    case OP_AND:                       arith(0x23,   true);  return;
+    case OP_OR:                        arith(0x0B,   true);  return;
+    case OP_XOR:                       arith(0x33,   true);  return;
+    case OP_NOT:                       unary(2);             return;
+    case OP_SIGN:                      unary(3);             return;
+      // clang-format on
+
+    case VAL_ZERO:
+      zero.op     = VAL_INTEGER;
+      zero.iValue = 0;
+      pushConst(&zero);
+      return;
+    case VAL_INTEGER:
+    case VAL_FLOAT:
+    case VAL_STRING:
+    case VAL_PTR:
+      pushConst(code);
+      return;
+    default:
+      break;
+  }
+  bail(CC_ALWAYS);  // Calls, SVCs, floats, arrays, ... are interpreted
+}
+
+//=============================================================================
+// Private functions: Regions
+//=============================================================================
+static idxType jumpTarget(const sCode* code)
+{
+  // Code index of a jump inside the sub (GOSUB leaves it), else -1
+  eOp op = code->op;
+  if (op == CMD_IF || op == CMD_GOTO ||
+      (op >= CMD_FOR_GLOBAL && op <= CMD_IF_EQUAL_QF) ||
+      (op >= CMD_IF_NEQ_SS && op <= CMD_IF_EQUAL_SK))
+    return code->param;
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+static int scan(const sSys* sys, sRegion* r)
+{
+  // Instructions of the sub: up to an unconditional jump, return or end,
+  // which is behind all forward jumps seen so far
+  sCodeIdx code;
+  idxType  pc  = r->entry;
+  idxType  max = r->entry;
+  int      len;
+
+  r->cnt = 0;
+  while (r->cnt < JIT_MAX_INSTR)
+  {
+    memset(&code, 0, sizeof(code));
+    if (sys->getCode(&code, pc) < 0 || code.code.op == CMD_INVALID)
+      break;
+    len = sys->getCodeLen(code.code.op);
+    if (len <= 0)
+      break;
+    r->pcs[r->cnt]  = pc;
+    ins[r->cnt++]   = code.code;
+    pc             += len;
+    if (jumpTarget(&code.code) > max)
+      max = jumpTarget(&code.code);
+    if ((code.code.op == CMD_GOTO || code.code.op == CMD_RETURN ||
+         code.code.op == CMD_END) &&
+        pc > max)
+      break;
+  }
+  r->end = pc;
+  return r->cnt;
+}
+
+//-----------------------------------------------------------------------------
+static void prologue(void)
+{
+  // void native(sJitState* state (rdi), const uint8_t* start (rsi))
+  push(RBX);
+  push(RBP);
+  push(R12);
+  push(R13);
+  push(R14);
+  push(R15);
+  opReg(1, 0x8B, R_STATE, RDI);
+  opMem(1, 0x8B, R_STACK, R_STATE, NONE, STATE(stack));
+  opMem(0, 0x8B, R_SP, R_STATE, NONE, STATE(sp));
+  opMem(0, 0x8B, R_FP, R_STATE, NONE, STATE(fp));
+  opMem(0, 0x8B, R_BUDGET, R_STATE, NONE, STATE(budget));
+  opReg(0, 0x33, R_CNT, R_CNT);  // xor r15d, r15d
+  opReg(0, 0xFF, 4, RSI);        // jmp rsi
+}
+
+//-----------------------------------------------------------------------------
+static void epilogue(void)
+{
+  // eax: code index where the interpreter continues
+  opMem(0, 0x89, RAX, R_STATE, NONE, STATE(pc));
+  opMem(0, 0x89, R_SP, R_STATE, NONE, STATE(sp));
+  opMem(0, 0x89, R_FP, R_STATE, NONE, STATE(fp));
+  opMem(0, 0x89, R_BUDGET, R_STATE, NONE, STATE(budget));
+  opMem(0, 0x89, R_CNT, R_STATE, NONE, STATE(cnt));
+  pop(R15);
+  pop(R14);
+  pop(R13);
+  pop(R12);
+  pop(RBP);
+  pop(RBX);
+  emit8(0xC3);  // ret
+}
+
+//-----------------------------------------------------------------------------
+static void resolve(int epi)
+{
+  // Exits load the code index and jump to the epilogue, one stub per index
+  for (int i = 0; i < fixupCnt; i++)
+  {
+    sFixup* f = &fixups[i];
+    if (f->kind == FIX_INSTR)
+    {
+      patch(f->pos, region->ofs[f->target]);
+    }
+    else if (f->kind == FIX_EPILOGUE)
+    {
+      patch(f->pos, epi);
+    }
+    else
+    {
+      f->stub = -1;
+      for (int j = 0; j < i && f->stub < 0; j++)
+        if (fixups[j].kind == FIX_EXIT && fixups[j].target == f->target)
+          f->stub = fixups[j].stub;
+      if (f->stub < 0)
+      {
+        f->stub = pos;
+        emit8(0xB8);  // mov eax, pc
+        emit32(f->target);
+        patch(jump(CC_ALWAYS), epi);
+      }
+      patch(f->pos, f->stub);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+static bool compile(const sSys* sys, sRegion* r)
+{
+  int  epi;
+  bool ok;
+
+  // Templates rely on the layout of a stack entry
+  if (sizeof(sCode) != 8 || OFS_VAL != 4 || scan(sys, r) == 0)
+    return false;
+  if (!mem)
+  {
+    mem = mmap(NULL, JIT_MEM, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+      mem = NULL;
+      return false;
+    }
+  }
+  else if (mprotect(mem, JIT_MEM, PROT_READ | PROT_WRITE) < 0)
+  {
+    return false;
+  }
+
+  region   = r;
+  memUsed  = (memUsed + JIT_ALIGN - 1) & ~(JIT_ALIGN - 1);
+  out      = mem + memUsed;
+  room     = JIT_MEM - memUsed;
+  pos      = 0;
+  fixupCnt = 0;
+
+  prologue();
+  for (int i = 0; i < r->cnt; i++)
+  {
+    r->ofs[i] = pos;
+    curPc     = r->pcs[i];
+    compileInstr(&ins[i]);
+  }
+  fixup(jump(CC_ALWAYS), FIX_EXIT, r->end);
+  epi = pos;
+  epilogue();
+  if (fixupCnt <= JIT_MAX_FIXUPS)
+    resolve(epi);
+
+  // Executable, but not writable anymore
+  ok = (pos <= room && fixupCnt <= JIT_MAX_FIXUPS);
+  if (ok)
+  {
+    r->code  = out;
+    memUsed += pos;
+  }
+  if (mprotect(mem, JIT_MEM, PROT_READ | PROT_EXEC) < 0)
+    return false;
+  return ok;
+}
+
+//-----------------------------------------------------------------------------
+static sRegion* findRegion(const sSys* sys, idxType pc, int* idx)
+{
+  for (int i = 0; i < JIT_MAX_REGIONS; i++)
+  {
+    sRegion* r = &regions[i];
+    if (r->state == REGION_COMPILED && r->sys == sys && pc >= r->entry &&
+        pc < r->end && (*idx = findInstr(r, pc)) >= 0)
+      return r;
+  }
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+static sRegion* hotRegion(const sSys* sys, idxType pc)
+{
+  // Count the calls of a sub, compile it once it's hot
+  sRegion* r = NULL;
+  for (int i = 0; i < JIT_MAX_REGIONS && !r; i++)
+    if (regions[i].state != REGION_FREE && regions[i].sys == sys &&
+        regions[i].entry == pc)
+      r = &regions[i];
+  for (int i = 0; i < JIT_MAX_REGIONS && !r; i++)
+  {
+    if (regions[i].state == REGION_FREE)
+    {
+      r        = &regions[i];
+      r->sys   = sys;
+      r->entry = pc;
+      r->calls = 0;
+      r->state = REGION_COUNTING;
+    }
+  }
+  if (!r || r->state != REGION_COUNTING || ++r->calls < EXEC_JIT_CALLS)
+    return NULL;
+  if (!compile(sys, r))
+  {
+    r->state = REGION_FAILED;
+    return NULL;
+  }
+  r->state = REGION_COMPILED;
+  compiled++;
+  return r;
+}
+
+//=============================================================================
+// Public functions
+//=============================================================================
+int jit_enter(const sSys* sys, sJitState* state, bool call)
+{
+  sRegion* r   = NULL;
+  int      idx = 0;
+
+  // Held while compiling and running native code, compiling remaps the
+  // memory of all subs. Another thread doesn't wait, it interprets
+  if (state->pc < 0 || pthread_mutex_trylock(&lock) != 0)
+    return 0;
+  if (!disabled && (compiled || call))
+  {
+    r = findRegion(sys, state->pc, &idx);
+    if (!r && call)
+      r = hotRegion(sys, state->pc);
+    if (r)
+      ((fNative)(void*)r->code)(state, r->code + r->ofs[idx]);
+  }
+  pthread_mutex_unlock(&lock);
+  return r ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+void jit_enable(bool enable)
+{
+  pthread_mutex_lock(&lock);
+  disabled = !enable;
+  pthread_mutex_unlock(&lock);
+}
+
+//-----------------------------------------------------------------------------
+void jit_reset(const sSys* sys)
+{
+  // Drop the subs of one program (NULL: all), the memory is reused once
+  // no compiled sub is left
+  pthread_mutex_lock(&lock);
+  compiled = 0;
+  for (int i = 0; i < JIT_MAX_REGIONS; i++)
+  {
+    if (!sys || regions[i].sys == sys)
+      memset(&regions[i], 0, sizeof(regions[i]));
+    else if (regions[i].state == REGION_COMPILED)
+      compiled++;
+  }
+  if (!compiled)
+    memUsed = 0;
+  pthread_mutex_unlock(&lock);
+}
+#endif
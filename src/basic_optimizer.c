@@ -1,16 +1,202 @@
 #include "basic_optimizer.h"
 #include "basic_common.h"
+#include "basic_image.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define IS_VAL_INT(x)  ((x).op == VAL_INTEGER || (x).op == VAL_ZERO)
+#define VAL_INT(x)     (((x).op == VAL_ZERO) ? 0 : (x).iValue)
+#define FITS_PARAM(x)  ((x) == (idxType)(x))
+#define BIT(x)         (((x) >= 0 && (x) < 32) ? (1UL << (x)) : 0)
+#define MAX_SWEEPS     32  // Stack analysis gives up after this many sweeps
+#define SLOT_WINDOW    16  // Max. instructions of a statement for slot form
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+typedef enum
+{
+  SWEEP_TYPES,    // Infer types
+  SWEEP_REWRITE,  // Replace generic operators by integer operators
+  SWEEP_VERIFY,   // Verify stack depth and indices
+  SWEEP_SLOTS,    // Translate statements to slot instructions
+} eSweep;
+
+//-----------------------------------------------------------------------------
+typedef struct
+{
+  bool isConst;  // Constant, else frame slot
+  int  value;    // Frame slot (relative to fp) or constant
+} sOperand;
+
+//=============================================================================
+// Private variables
+//=============================================================================
+static sOptimizer optimizerState;  // Of optimize() and verify()
 
 //=============================================================================
 // Private functions
 //=============================================================================
-int optimizeGoto(const sSys* sys)
+static void indexCode(sOptimizer* o, const sSys* sys, int len)
+{
+#if BASIC_LARGE
+  // Jump targets and the first instruction of each block of OPT_BLOCK bytes
+  // with the NOPs in front of it. Valid as long as no jump target changes
+  sCodeIdx code;
+  idxType  nops  = 0;
+  int      block = 0;
+
+  memset(o->jumpTo, 0, sizeof(o->jumpTo));
+  for (idxType idx = 0; idx < len && sys->getCode(&code, idx) >= 0;
+       idx += sys->getCodeLen(code.code.op))
+  {
+    for (; block * OPT_BLOCK <= idx; block++)
+    {
+      o->blockInstr[block] = idx;
+      o->blockNops[block]  = nops;
+    }
+    if (image_isJump(code.code.op) && code.code.param >= 0 &&
+        code.code.param <= len)
+      o->jumpTo[code.code.param / 32] |= 1u << (code.code.param % 32);
+    nops += (code.code.op == CMD_NOP);
+  }
+  for (; block * OPT_BLOCK <= len; block++)
+  {
+    o->blockInstr[block] = len;
+    o->blockNops[block]  = nops;
+  }
+#else
+  (void)o;
+  (void)sys;
+  (void)len;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+static bool isTarget(const sOptimizer* o, const sSys* sys, int len,
+                     idxType idx)
+{
+#if BASIC_LARGE
+  (void)sys;
+  return idx >= 0 && idx <= len && (o->jumpTo[idx / 32] >> (idx % 32)) & 1;
+#else
+  sCodeIdx code;
+
+  (void)o;
+
+  for (idxType i = 0; i < len && sys->getCode(&code, i) >= 0;
+       i += sys->getCodeLen(code.code.op))
+  {
+    if (image_isJump(code.code.op) && code.code.param == idx)
+      return true;
+  }
+  return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+static idxType nopsBefore(const sOptimizer* o, const sSys* sys, int len,
+                          idxType idx)
+{
+  // NOPs at instructions in front of idx
+  sCodeIdx code;
+  idxType  nops = 0;
+  idxType  i    = 0;
+
+#if BASIC_LARGE
+  if (idx <= 0)
+    return 0;
+  if (idx > len)
+    idx = len;
+  nops = o->blockNops[idx / OPT_BLOCK];
+  i    = o->blockInstr[idx / OPT_BLOCK];
+#else
+  (void)o;
+  (void)len;
+#endif
+  for (; i < idx && sys->getCode(&code, i) >= 0;
+       i += sys->getCodeLen(code.code.op))
+    nops += (code.code.op == CMD_NOP);
+  return nops;
+}
+
+//-----------------------------------------------------------------------------
+static int readCode(const sSys* sys, int len, sCodeIdx* code, int cnt,
+                    idxType idx)
+{
+  int n;
+  for (n = 0; n < cnt && idx < len; n++)
+  {
+    CHECK(sys->getCode(&code[n], idx));
+    idx += sys->getCodeLen(code[n].code.op);
+  }
+  return n;
+}
+
+//-----------------------------------------------------------------------------
+static int fill(const sSys* sys, eOp op, idxType idx, idxType end)
+{
+  sCodeIdx code = {.code.op = op};
+  for (code.idx = idx; code.idx < end; code.idx++)
+    CHECK(sys->setCode(&code));
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int replace(const sSys* sys, const sCodeIdx* first,
+                   const sCodeIdx* last, eOp op, idxType param,
+                   idxType param2)
+{
+  // Fused instruction + NOPs up to the end of the replaced sequence
+  sCodeIdx code = {.code = {.op = op, .param = param, .param2 = param2},
+                   .idx  = first->idx};
+  CHECK(sys->setCode(&code));
+  return fill(sys, CMD_NOP, code.idx + sys->getCodeLen(op),
+              last->idx + sys->getCodeLen(last->code.op));
+}
+
+//-----------------------------------------------------------------------------
+static int compact(sOptimizer* o, const sSys* sys, int len)
+{
+  // Remove NOPs (only created by the optimizer) and relocate jumps
+  sCodeIdx code;
+  idxType  dst = 0;
+
+  indexCode(o, sys, len);
+  for (idxType idx = 0; idx < len && sys->getCode(&code, idx) >= 0;
+       idx += sys->getCodeLen(code.code.op))
+  {
+    if (!image_isJump(code.code.op))
+      continue;
+    code.code.param -= nopsBefore(o, sys, len, code.code.param);
+    CHECK(sys->setCode(&code));
+  }
+
+  for (idxType idx = 0; idx < len && sys->getCode(&code, idx) >= 0;
+       idx += sys->getCodeLen(code.code.op))
+  {
+    if (code.code.op == CMD_NOP)
+      continue;
+    code.idx = dst;
+    CHECK(sys->setCode(&code));
+    dst += sys->getCodeLen(code.code.op);
+  }
+  CHECK(fill(sys, CMD_INVALID, dst, len));
+  return dst;
+}
+
+//-----------------------------------------------------------------------------
+static int optimizeGoto(const sSys* sys, int len)
 {
   sCodeIdx code;
   sCodeIdx dest;
   int      timeout;
 
-  for (idxType idx = 0; sys->getCode(&code, idx) >= 0;
+  for (idxType idx = 0; idx < len && sys->getCode(&code, idx) >= 0;
        idx += sys->getCodeLen(code.code.op))
   {
     if (code.code.op != CMD_GOTO)
@@ -31,11 +217,864 @@ int optimizeGoto(const sSys* sys)
   return 0;
 }
 
+//-----------------------------------------------------------------------------
+static int optimizeFuse(sOptimizer* o, const sSys* sys, int len)
+{
+  sCodeIdx c[4];
+  int      n;
+  int      value;
+  bool     fused = false;
+
+  indexCode(o, sys, len);
+  for (idxType idx = 0; idx < len; idx += sys->getCodeLen(c[0].code.op))
+  {
+    CHECK(n = readCode(sys, len, c, ARRAY_SIZE(c), idx));
+
+    // <var> = <var> +/- <int>  ->  CMD_INC_GLOBAL, CMD_INC_LOCAL
+    if (n >= 4 &&
+        (c[0].code.op == CMD_GET_GLOBAL || c[0].code.op == CMD_GET_LOCAL) &&
+        c[0].code.param2 == 0 && IS_VAL_INT(c[1].code) &&
+        (c[2].code.op == OP_PLUS || c[2].code.op == OP_MINUS) &&
+        c[3].code.op == ((c[0].code.op == CMD_GET_GLOBAL) ? CMD_LET_GLOBAL
+                                                          : CMD_LET_LOCAL) &&
+        c[3].code.param == c[0].code.param && c[3].code.param2 == 0 &&
+        FITS_PARAM(VAL_INT(c[1].code)) && !isTarget(o, sys, len, c[1].idx) &&
+        !isTarget(o, sys, len, c[2].idx) && !isTarget(o, sys, len, c[3].idx))
+    {
+      value = VAL_INT(c[1].code);
+      CHECK(replace(sys, &c[0], &c[3],
+                    (c[0].code.op == CMD_GET_GLOBAL) ? CMD_INC_GLOBAL
+                                                     : CMD_INC_LOCAL,
+                    c[0].code.param,
+                    (c[2].code.op == OP_PLUS) ? value : -value));
+      fused = true;
+      CHECK(sys->getCode(&c[0], idx));  // Skip fused instruction
+      continue;
+    }
+
+    // <var> = <int>  ->  CMD_LETI_GLOBAL, CMD_LETI_LOCAL
+    if (n >= 2 && IS_VAL_INT(c[0].code) &&
+        (c[1].code.op == CMD_LET_GLOBAL || c[1].code.op == CMD_LET_LOCAL) &&
+        c[1].code.param2 == 0 && FITS_PARAM(VAL_INT(c[0].code)) &&
+        !isTarget(o, sys, len, c[1].idx))
+    {
+      CHECK(replace(sys, &c[0], &c[1],
+                    (c[1].code.op == CMD_LET_GLOBAL) ? CMD_LETI_GLOBAL
+                                                     : CMD_LETI_LOCAL,
+                    c[1].code.param, VAL_INT(c[0].code)));
+      fused = true;
+      CHECK(sys->getCode(&c[0], idx));  // Skip fused instruction
+      continue;
+    }
+
+    // <compare> + CMD_IF  ->  CMD_IF_<compare>
+    if (n >= 2 && c[1].code.op == CMD_IF && !isTarget(o, sys, len, c[1].idx))
+    {
+      eOp op;
+      // clang-format off
+      switch (c[0].code.op)
+      {
+        case OP_NEQ:   op = CMD_IF_NEQ;   break;
+        case OP_LTEQ:  op = CMD_IF_LTEQ;  break;
+        case OP_GTEQ:  op = CMD_IF_GTEQ;  break;
+        case OP_LT:    op = CMD_IF_LT;    break;
+        case OP_GT:    op = CMD_IF_GT;    break;
+        case OP_EQUAL: op = CMD_IF_EQUAL; break;
+        default:       op = CMD_INVALID;  break;
+      }
+      // clang-format on
+      if (op != CMD_INVALID)
+      {
+        CHECK(replace(sys, &c[0], &c[1], op, c[1].code.param, 0));
+        fused = true;
+        CHECK(sys->getCode(&c[0], idx));  // Skip fused instruction
+        continue;
+      }
+    }
+  }
+  return fused ? compact(o, sys, len) : len;
+}
+
+#if OPT_MAX_TARGETS > 0
+//-----------------------------------------------------------------------------
+static eOp intOp(eOp op)
+{
+  // clang-format off
+  switch (op)
+  {
+    case CMD_IF_NEQ:   return CMD_IF_NEQ_II;
+    case CMD_IF_LTEQ:  return CMD_IF_LTEQ_II;
+    case CMD_IF_GTEQ:  return CMD_IF_GTEQ_II;
+    case CMD_IF_LT:    return CMD_IF_LT_II;
+    case CMD_IF_GT:    return CMD_IF_GT_II;
+    case CMD_IF_EQUAL: return CMD_IF_EQUAL_II;
+    case OP_NEQ:       return OP_NEQ_II;
+    case OP_LTEQ:      return OP_LTEQ_II;
+    case OP_GTEQ:      return OP_GTEQ_II;
+    case OP_LT:        return OP_LT_II;
+    case OP_GT:        return OP_GT_II;
+    case OP_EQUAL:     return OP_EQUAL_II;
+    case OP_PLUS:      return OP_PLUS_II;
+    case OP_MINUS:     return OP_MINUS_II;
+    case OP_MULT:      return OP_MULT_II;
+    default:           return op;
+  }
+  // clang-format on
+}
+
+//-----------------------------------------------------------------------------
+static sTarget* findTarget(sOptimizer* o, idxType idx)
+{
+  for (int i = 0; i < o->targetCnt; i++)
+    if (o->targets[i].idx == idx)
+      return &o->targets[i];
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+static bool isInstr(const sOptimizer* o, const sSys* sys, int len,
+                    idxType idx)
+{
+  sCodeIdx code;
+  idxType  i = 0;
+
+  if (idx == len)  // End of code
+    return true;
+#if BASIC_LARGE
+  if (idx < 0 || idx > len)
+    return false;
+  i = o->blockInstr[idx / OPT_BLOCK];
+#else
+  (void)o;
+#endif
+  for (; i < len && i <= idx && sys->getCode(&code, i) >= 0;
+       i += sys->getCodeLen(code.code.op))
+  {
+    if (i == idx)
+      return true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+static int addTarget(sOptimizer* o, const sSys* sys, int len, idxType idx,
+                     idxType argc)
+{
+  sTarget* target = findTarget(o, idx);
+
+  if (target)
+  {
+    // Jumps to a sub entry are possible within the sub (e.g. loop)
+    ENSURE(argc < 0 || target->argc < 0 || target->argc == argc,
+           ERR_VERIFY_JUMP);
+    if (argc >= 0)
+      target->argc = argc;
+    return 0;
+  }
+  ENSURE(idx >= 0 && idx <= len && isInstr(o, sys, len, idx), ERR_VERIFY_JUMP);
+  ENSURE(o->targetCnt < (int)ARRAY_SIZE(o->targets), ERR_VERIFY_LIMIT);
+  o->targets[o->targetCnt++] = (sTarget){.idx = idx, .argc = argc};
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int collectTargets(sOptimizer* o, const sSys* sys, int len)
+{
+  sCodeIdx code;
+  sCodeIdx ret;
+  idxType  i;
+
+  o->targetCnt = 0;
+  o->subWrites = 0;
+  o->mainNeed  = 0;
+  indexCode(o, sys, len);
+  for (idxType idx = 0; idx < len; idx += sys->getCodeLen(code.code.op))
+  {
+    CHECK(sys->getCode(&code, idx));
+    if (code.code.op == CMD_GOSUB)
+    {
+      // Number of arguments is only known by the RETURN of the sub
+      ENSURE(code.code.param >= 0, ERR_VERIFY_JUMP);
+      for (i = code.code.param; i < len; i += sys->getCodeLen(ret.code.op))
+      {
+        CHECK(sys->getCode(&ret, i));
+        if (ret.code.op == CMD_RETURN)
+          break;
+      }
+      ENSURE(i < len && ret.code.param >= 0, ERR_VERIFY_JUMP);
+      CHECK(addTarget(o, sys, len, code.code.param, ret.code.param));
+    }
+    else if (image_isJump(code.code.op))
+    {
+      CHECK(addTarget(o, sys, len, code.code.param, -1));
+    }
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int mergeTypes(sTarget* target, const sTypes* types)
+{
+  // Returns 1 if the types at the jump target changed
+  if (!target->valid)
+  {
+    target->valid = true;
+    target->types = *types;
+    return 1;
+  }
+  ENSURE(target->types.depth == types->depth, ERR_VERIFY_STACK);
+  ENSURE(target->types.sub == types->sub, ERR_VERIFY_STACK);
+  if ((target->types.ints & types->ints) == target->types.ints)
+    return 0;
+  target->types.ints &= types->ints;
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+static idxType* need(sOptimizer* o, const sTypes* types)
+{
+  // Max. stack depth of the current sub or main program
+  return types->sub ? &types->sub->need : &o->mainNeed;
+}
+
+//-----------------------------------------------------------------------------
+static int mergeNeed(idxType* need, int depth)
+{
+  // Returns 1 if the max. stack depth grew
+  ENSURE(depth <= STACK_SIZE, ERR_VERIFY_DEPTH);  // Also endless recursion
+  if (depth <= *need)
+    return 0;
+  *need = depth;
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+static bool isInt(const sTypes* types, int entry)
+{
+  return (types->ints & BIT(entry)) != 0;
+}
+
+//-----------------------------------------------------------------------------
+static void setInt(sTypes* types, int entry, bool isInt)
+{
+  if (isInt)
+    types->ints |= BIT(entry);
+  else
+    types->ints &= ~BIT(entry);
+}
+
+//-----------------------------------------------------------------------------
+static int pop(sTypes* types, int cnt)
+{
+  // Return label of a sub (at fp) can't be removed
+  ENSURE(cnt >= 0 && types->depth - cnt >= (types->sub ? 1 : 0),
+         ERR_VERIFY_STACK);
+  types->depth -= cnt;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int push(sTypes* types, bool isInt)
+{
+  ENSURE(types->depth < STACK_SIZE, ERR_VERIFY_DEPTH);
+  setInt(types, types->depth++, isInt);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int varEntry(const sTypes* types, eOp op, idxType idx)
+{
+  // Stack entry of a variable, -1 for globals inside a sub
+  bool global = (op == CMD_GET_GLOBAL || op == CMD_LET_GLOBAL ||
+                 op == CMD_INC_GLOBAL || op == CMD_LETI_GLOBAL ||
+                 op == CMD_FOR_GLOBAL || op == CMD_NEXT_GLOBAL);
+  return (global && types->sub) ? -1 : idx;
+}
+
+//-----------------------------------------------------------------------------
+static void setVar(sOptimizer* o, sTypes* types, eOp op, idxType idx,
+                   bool isInt)
+{
+  int entry = varEntry(types, op, idx);
+  if (entry >= 0)
+    setInt(types, entry, isInt);
+  else if (!isInt)
+    o->subWrites |= BIT(idx);
+}
+
+//-----------------------------------------------------------------------------
+static int checkSlot(sOptimizer* o, const sTypes* types, int slot)
+{
+  // Arguments, return value, variables or temporaries of the frame.
+  // Returns 1 if the max. stack depth grew
+  ENSURE(slot >= (types->sub ? -types->sub->argc - 1 : 0), ERR_VERIFY_STACK);
+  return mergeNeed(need(o, types), slot + 1);
+}
+
+//-----------------------------------------------------------------------------
+static bool isSlotB(eOp op)
+{
+  // Second operand of a slot instruction is a frame slot (else constant)
+  switch (op)
+  {
+    case CMD_IF_NEQ_SS:
+    case CMD_IF_LTEQ_SS:
+    case CMD_IF_GTEQ_SS:
+    case CMD_IF_LT_SS:
+    case CMD_IF_GT_SS:
+    case CMD_IF_EQUAL_SS:
+    case OP_PLUS_SS:
+    case OP_MINUS_SS:
+    case OP_MULT_SS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static bool slotVar(const sTypes* types, const sCode* code, int* slot)
+{
+  // Globals are fp relative in the main program only (fp = 0)
+  if (code->param2 != 0 || (types->sub && (code->op == CMD_GET_GLOBAL ||
+                                           code->op == CMD_LET_GLOBAL)))
+    return false;
+  *slot = code->param;
+  return SLOT_FITS(*slot);
+}
+
+//-----------------------------------------------------------------------------
+static eOp slotOp(eOp op)
+{
+  // clang-format off
+  switch (op)
+  {
+    case CMD_IF_NEQ:
+    case CMD_IF_NEQ_II:   return CMD_IF_NEQ_SS;
+    case CMD_IF_LTEQ:
+    case CMD_IF_LTEQ_II:  return CMD_IF_LTEQ_SS;
+    case CMD_IF_GTEQ:
+    case CMD_IF_GTEQ_II:  return CMD_IF_GTEQ_SS;
+    case CMD_IF_LT:
+    case CMD_IF_LT_II:    return CMD_IF_LT_SS;
+    case CMD_IF_GT:
+    case CMD_IF_GT_II:    return CMD_IF_GT_SS;
+    case CMD_IF_EQUAL:
+    case CMD_IF_EQUAL_II: return CMD_IF_EQUAL_SS;
+    case OP_PLUS:
+    case OP_PLUS_II:      return OP_PLUS_SS;
+    case OP_MINUS:
+    case OP_MINUS_II:     return OP_MINUS_SS;
+    case OP_MULT:
+    case OP_MULT_II:      return OP_MULT_SS;
+    default:              return CMD_INVALID;
+  }
+  // clang-format on
+}
+
+//-----------------------------------------------------------------------------
+static eOp mirrorOp(eOp op)
+{
+  // Compare with swapped operands (a < b  ->  b > a)
+  // clang-format off
+  switch (op)
+  {
+    case CMD_IF_LTEQ_SS: return CMD_IF_GTEQ_SS;
+    case CMD_IF_GTEQ_SS: return CMD_IF_LTEQ_SS;
+    case CMD_IF_LT_SS:   return CMD_IF_GT_SS;
+    case CMD_IF_GT_SS:   return CMD_IF_LT_SS;
+    case OP_MINUS_SS:    return CMD_INVALID;
+    default:             return op;
+  }
+  // clang-format on
+}
+
+//-----------------------------------------------------------------------------
+static int translateSlots(const sOptimizer* o, const sSys* sys, int len,
+                          const sTypes* types, idxType idx)
+{
+  // Statement (<var> = <expr> or If <a> <cmp> <b>) of variables and small
+  // integers -> slot instructions, temporaries stay at their stack entry.
+  // Returns 1 if translated
+  sCodeIdx c[SLOT_WINDOW];
+  sOperand stk[SLOT_WINDOW];
+  sCode    out[SLOT_WINDOW];
+  sOperand a, b;
+  int      n, i, slot;
+  int      cnt  = 0;
+  int      sp   = 0;
+  int      peak = 0;  // Stack entries the replaced code needs (SLOT_NEED)
+  eOp      op;
+
+  CHECK(n = readCode(sys, len, c, ARRAY_SIZE(c), idx));
+  for (i = 0; i < n; i++)
+  {
+    if (i > 0 && isTarget(o, sys, len, c[i].idx))
+      return 0;
+    op = c[i].code.op;
+    if ((op == CMD_GET_GLOBAL || op == CMD_GET_LOCAL) &&
+        slotVar(types, &c[i].code, &slot))
+    {
+      stk[sp++] = (sOperand){.isConst = false, .value = slot};
+    }
+    else if (IS_VAL_INT(c[i].code) && SLOT_FITS(VAL_INT(c[i].code)))
+    {
+      stk[sp++] = (sOperand){.isConst = true, .value = VAL_INT(c[i].code)};
+    }
+    else if (slotOp(op) != CMD_INVALID && sp >= 2)
+    {
+      op = slotOp(op);
+      b  = stk[--sp];
+      a = stk[--sp];
+      if (a.isConst && !b.isConst && mirrorOp(op) != CMD_INVALID)
+      {
+        stk[sp] = a;  // Constant must be the second operand
+        a       = b;
+        b       = stk[sp];
+        op      = mirrorOp(op);
+      }
+      if (a.isConst)
+        return 0;
+      out[cnt] = (sCode){.op     = op + b.isConst,  // _SS -> _SK
+                         .param2 = SLOT_PACK(a.value, b.value)};
+      if (op >= CMD_IF_NEQ_SS && op <= CMD_IF_EQUAL_SS)
+      {
+        out[cnt++].param = c[i].code.param;  // Label
+        if (sp != 0)
+          return 0;
+        break;
+      }
+      out[cnt].param = types->depth + sp;  // Temporary at its stack entry
+      if (!SLOT_FITS(out[cnt].param))
+        return 0;
+      stk[sp++] = (sOperand){.isConst = false, .value = out[cnt++].param};
+    }
+    else if ((op == CMD_LET_GLOBAL || op == CMD_LET_LOCAL) && sp == 1 &&
+             !stk[0].isConst && slotVar(types, &c[i].code, &slot))
+    {
+      if (cnt > 0 && stk[0].value == out[cnt - 1].param)
+        out[cnt - 1].param = slot;  // Result directly to the variable
+      else
+        out[cnt++] = (sCode){.op     = CMD_MOVE,
+                             .param  = slot,
+                             .param2 = SLOT_PACK(stk[0].value, 0)};
+      break;
+    }
+    else
+    {
+      return 0;
+    }
+    if (sp > peak)
+      peak = sp;
+  }
+
+  // Replace, if it saves instructions and fits
+  if (i == n || cnt > i)
+    return 0;
+  int size = 0;
+  for (int k = 0; k < cnt; k++)
+    size += sys->getCodeLen(out[k].op);
+  if (idx + size > c[i].idx + sys->getCodeLen(c[i].code.op))
+    return 0;
+
+  sCodeIdx code = {.idx = idx};
+  for (int k = 0; k < cnt; k++)
+  {
+    code.code = out[k];
+    if (out[k].op < CMD_IF_NEQ_SS || out[k].op > CMD_IF_EQUAL_SK)
+      code.code.param = SLOT_PACK(out[k].param, peak);  // <dst>:<n>
+    CHECK(sys->setCode(&code));
+    code.idx += sys->getCodeLen(out[k].op);
+  }
+  CHECK(fill(sys, CMD_NOP, code.idx,
+             c[i].idx + sys->getCodeLen(c[i].code.op)));
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+static int sweep(sOptimizer* o, const sSys* sys, int len, eSweep mode)
+{
+  // Follows the stack through the code (merging at jump targets).
+  // Returns 1 if another sweep is needed (e.g. types at a loop head changed)
+  sCodeIdx code;
+  sTypes   types   = {0};
+  bool     live    = true;
+  bool     a, b;
+  int      changed = 0;
+  int      res;
+  uint32_t writes  = o->subWrites;
+  sTarget* target;
+
+  for (idxType idx = 0; idx < len; idx += sys->getCodeLen(code.code.op))
+  {
+    CHECK(sys->getCode(&code, idx));
+    if ((target = findTarget(o, idx)) != NULL)
+    {
+      if (target->argc >= 0)  // Sub entry: fp points to the return label
+      {
+        ENSURE(!live, ERR_VERIFY_STACK);
+        if (!target->valid)
+        {
+          target->valid = true;
+          target->types = (sTypes){.depth = 1, .ints = 0, .sub = target};
+        }
+      }
+      else if (live)
+      {
+        CHECK(mergeTypes(target, &types));
+      }
+      live  = target->valid;
+      types = target->types;
+    }
+    if (!live)  // Unreachable (so far)
+      continue;
+    if (mode == SWEEP_SLOTS)
+    {
+      CHECK(res = translateSlots(o, sys, len, &types, idx));
+      if (res)
+        CHECK(sys->getCode(&code, idx));
+    }
+
+    a = isInt(&types, types.depth - 2);
+    b = isInt(&types, types.depth - 1);
+    switch (code.code.op)
+    {
+      case CMD_PRINT:
+      case CMD_POP:
+        CHECK(pop(&types, code.code.param + 1));
+        break;
+      case CMD_LET_GLOBAL:
+      case CMD_LET_LOCAL:
+        if (code.code.param2 > 0)  // Array
+        {
+          CHECK(pop(&types, 2));
+          for (int i = 0; i < code.code.param2; i++)
+            setVar(o, &types, code.code.op, code.code.param + i, false);
+        }
+        else
+        {
+          CHECK(pop(&types, 1));
+          setVar(o, &types, code.code.op, code.code.param, b);
+        }
+        break;
+      case CMD_LET_PTR:
+        CHECK(pop(&types, 2));
+        break;
+      case CMD_LET_REG:
+        ENSURE(code.code.param >= 0 && code.code.param < MAX_REG_NUM &&
+                   sys->regs[code.code.param].setter,
+               ERR_VERIFY_REG);
+        CHECK(pop(&types, 1));
+        break;
+      case CMD_IF:
+        CHECK(pop(&types, 1));
+        CHECK(res = mergeTypes(findTarget(o, code.code.param), &types));
+        changed |= (res && code.code.param <= idx);
+        break;
+      case CMD_IF_NEQ:
+      case CMD_IF_LTEQ:
+      case CMD_IF_GTEQ:
+      case CMD_IF_LT:
+      case CMD_IF_GT:
+      case CMD_IF_EQUAL:
+      case CMD_IF_NEQ_II:
+      case CMD_IF_LTEQ_II:
+      case CMD_IF_GTEQ_II:
+      case CMD_IF_LT_II:
+      case CMD_IF_GT_II:
+      case CMD_IF_EQUAL_II:
+        CHECK(pop(&types, 2));
+        CHECK(res = mergeTypes(findTarget(o, code.code.param), &types));
+        changed |= (res && code.code.param <= idx);
+        if (mode == SWEEP_REWRITE && a && b &&
+            intOp(code.code.op) != code.code.op)
+        {
+          code.code.op = intOp(code.code.op);
+          CHECK(sys->setCode(&code));
+        }
+        break;
+      case CMD_GOTO:
+        CHECK(res = mergeTypes(findTarget(o, code.code.param), &types));
+        changed |= (res && code.code.param <= idx);
+        live = false;
+        break;
+      case CMD_IF_NEQ_SS:
+      case CMD_IF_NEQ_SK:
+      case CMD_IF_LTEQ_SS:
+      case CMD_IF_LTEQ_SK:
+      case CMD_IF_GTEQ_SS:
+      case CMD_IF_GTEQ_SK:
+      case CMD_IF_LT_SS:
+      case CMD_IF_LT_SK:
+      case CMD_IF_GT_SS:
+      case CMD_IF_GT_SK:
+      case CMD_IF_EQUAL_SS:
+      case CMD_IF_EQUAL_SK:
+        if (mode == SWEEP_VERIFY)
+        {
+          CHECK(res = checkSlot(o, &types, types.depth + SLOT_NEED_IF - 1));
+          changed |= res;
+          CHECK(res = checkSlot(o, &types, SLOT_A(code.code.param2)));
+          changed |= res;
+          if (isSlotB(code.code.op))
+          {
+            CHECK(res = checkSlot(o, &types, SLOT_B(code.code.param2)));
+            changed |= res;
+          }
+        }
+        CHECK(res = mergeTypes(findTarget(o, code.code.param), &types));
+        changed |= (res && code.code.param <= idx);
+        break;
+      case CMD_MOVE:
+      case OP_PLUS_SS:
+      case OP_PLUS_SK:
+      case OP_MINUS_SS:
+      case OP_MINUS_SK:
+      case OP_MULT_SS:
+      case OP_MULT_SK:
+        // Stack unchanged, result to a variable or temporary
+        a = isInt(&types, SLOT_A(code.code.param2));
+        b = !isSlotB(code.code.op) || isInt(&types, SLOT_B(code.code.param2));
+        if (mode == SWEEP_VERIFY)
+        {
+          CHECK(res = checkSlot(o, &types, types.depth +
+                                               SLOT_NEED(code.code.param) - 1));
+          changed |= res;
+          CHECK(res = checkSlot(o, &types, SLOT_DST(code.code.param)));
+          changed |= res;
+          CHECK(res = checkSlot(o, &types, SLOT_A(code.code.param2)));
+          changed |= res;
+          if (isSlotB(code.code.op))
+          {
+            CHECK(res = checkSlot(o, &types, SLOT_B(code.code.param2)));
+            changed |= res;
+          }
+        }
+        setVar(o, &types, CMD_LET_LOCAL, SLOT_DST(code.code.param), a && b);
+        break;
+      case CMD_FOR_GLOBAL:  // Limit and step on the stack
+      case CMD_FOR_LOCAL:
+      case CMD_NEXT_GLOBAL:
+      case CMD_NEXT_LOCAL:
+        ENSURE(types.depth >= (types.sub ? 3 : 2), ERR_VERIFY_STACK);
+        if (code.code.op == CMD_NEXT_GLOBAL || code.code.op == CMD_NEXT_LOCAL)
+        {
+          // var += step keeps an integer variable an integer
+          a = isInt(&types, varEntry(&types, code.code.op, code.code.param2));
+          setVar(o, &types, code.code.op, code.code.param2, a && b);
+        }
+        CHECK(res = mergeTypes(findTarget(o, code.code.param), &types));
+        changed |= (res && code.code.param <= idx);
+        break;
+      case CMD_GOSUB:
+        // Sub removes its arguments and may change globals
+        target = findTarget(o, code.code.param);
+        if (mode == SWEEP_VERIFY)
+        {
+          CHECK(res = mergeNeed(need(o, &types), types.depth + target->need));
+          changed |= res;
+        }
+        CHECK(pop(&types, target->argc));
+        ENSURE(types.depth > (types.sub ? 1 : 0), ERR_VERIFY_STACK);
+        setInt(&types, types.depth - 1, false);
+        if (!types.sub)
+          types.ints &= ~o->subWrites;
+        break;
+      case CMD_RETURN:
+        ENSURE(types.sub && code.code.param == types.sub->argc,
+               ERR_VERIFY_STACK);
+        live = false;
+        break;
+      case CMD_END:
+        live = false;
+        break;
+      case CMD_NOP:
+      case CMD_INC_GLOBAL:  // Type doesn't change
+      case CMD_INC_LOCAL:
+        break;
+      case CMD_SVC:
+        ENSURE(code.code.param >= 0 && code.code.param < MAX_SVC_NUM &&
+                   sys->svcs[code.code.param].func,
+               ERR_VERIFY_SVC);
+        CHECK(pop(&types, sys->svcs[code.code.param].argc));
+        ENSURE(types.depth > (types.sub ? 1 : 0), ERR_VERIFY_STACK);
+        setInt(&types, types.depth - 1, false);
+        break;
+      case CMD_GET_GLOBAL:
+      case CMD_GET_LOCAL:
+        if (code.code.param2 > 0)  // Array
+        {
+          CHECK(pop(&types, 1));
+          CHECK(push(&types, false));
+        }
+        else
+        {
+          CHECK(push(&types, isInt(&types, varEntry(&types, code.code.op,
+                                                    code.code.param))));
+        }
+        break;
+      case CMD_GET_PTR:
+        CHECK(pop(&types, 1));
+        CHECK(push(&types, false));
+        break;
+      case CMD_LETI_GLOBAL:
+      case CMD_LETI_LOCAL:
+        setVar(o, &types, code.code.op, code.code.param, true);
+        break;
+      case OP_NEQ:
+      case OP_LTEQ:
+      case OP_GTEQ:
+      case OP_LT:
+      case OP_GT:
+      case OP_EQUAL:
+      case OP_PLUS:
+      case OP_MINUS:
+      case OP_MULT:
+        CHECK(pop(&types, 2));
+        CHECK(push(&types, (a && b) || (code.code.op <= OP_EQUAL)));
+        if (mode == SWEEP_REWRITE && a && b)
+        {
+          code.code.op = intOp(code.code.op);
+          CHECK(sys->setCode(&code));
+        }
+        break;
+      case OP_XOR:
+      case OP_OR:
+      case OP_AND:
+      case OP_SHL:
+      case OP_SHR:
+      case OP_MOD:
+      case OP_IDIV:
+      case OP_NEQ_II:
+      case OP_LTEQ_II:
+      case OP_GTEQ_II:
+      case OP_LT_II:
+      case OP_GT_II:
+      case OP_EQUAL_II:
+      case OP_PLUS_II:
+      case OP_MINUS_II:
+      case OP_MULT_II:
+        CHECK(pop(&types, 2));
+        CHECK(push(&types, true));
+        break;
+      case OP_NOT:
+        CHECK(pop(&types, 1));
+        CHECK(push(&types, true));
+        break;
+      case OP_DIV:
+        CHECK(pop(&types, 2));
+        CHECK(push(&types, false));
+        break;
+      case OP_POW:
+        CHECK(pop(&types, 2));
+        CHECK(push(&types, a && b));
+        break;
+      case OP_SIGN:
+        CHECK(pop(&types, 1));
+        CHECK(push(&types, b));
+        break;
+      case VAL_ZERO:
+      case VAL_INTEGER:
+        CHECK(push(&types, true));
+        break;
+      case CMD_GET_REG:
+        ENSURE(code.code.param >= 0 && code.code.param < MAX_REG_NUM &&
+                   sys->regs[code.code.param].getter,
+               ERR_VERIFY_REG);
+        CHECK(push(&types, false));
+        break;
+      case CMD_CREATE_PTR:
+      case VAL_FLOAT:
+      case VAL_STRING:
+      case VAL_PTR:
+        CHECK(push(&types, false));
+        break;
+      default:
+        return ERR_VERIFY_CMD;
+    }
+    if (mode == SWEEP_VERIFY)
+    {
+      CHECK(res = mergeNeed(need(o, &types), types.depth));
+      changed |= res;
+    }
+  }
+  return changed || (o->subWrites != writes);
+}
+
+//-----------------------------------------------------------------------------
+static int analyze(sOptimizer* o, const sSys* sys, int len, eSweep mode)
+{
+  int res;
+  int cnt = 0;
+
+  CHECK(collectTargets(o, sys, len));
+  do
+  {
+    CHECK(res = sweep(o, sys, len, mode));
+    ENSURE(++cnt <= MAX_SWEEPS, ERR_VERIFY_LIMIT);
+  } while (res > 0);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int optimizeTypes(sOptimizer* o, const sSys* sys, int len)
+{
+  // Replace generic operators by integer ones, where both operands are
+  // known to be integers. Any problem -> keep the generic operators.
+  if (analyze(o, sys, len, SWEEP_TYPES) < 0)
+    return 0;
+  return sweep(o, sys, len, SWEEP_REWRITE);
+}
+
+//-----------------------------------------------------------------------------
+static int optimizeSlots(sOptimizer* o, const sSys* sys, int len)
+{
+  // Translate statements to slot instructions (needs the stack depth of
+  // each instruction). Any problem -> keep the stack instructions
+  if (analyze(o, sys, len, SWEEP_TYPES) < 0)
+    return len;
+  CHECK(sweep(o, sys, len, SWEEP_SLOTS));
+  return compact(o, sys, len);
+}
+#endif
+
 //=============================================================================
 // Public functions
 //=============================================================================
+int optimize_code(sOptimizer* o, const sSys* system)
+{
+  int len = system->getCodeNextIndex();
+
+  CHECK(optimizeGoto(system, len));
+  CHECK(len = optimizeFuse(o, system, len));
+#if OPT_MAX_TARGETS > 0
+  CHECK(optimizeTypes(o, system, len));
+#if OPT_SLOTS
+  CHECK(len = optimizeSlots(o, system, len));
+#endif
+#endif
+  return len;
+}
+
+//-----------------------------------------------------------------------------
+int optimize_verify(sOptimizer* o, const sSys* system, int len)
+{
+#if OPT_MAX_TARGETS > 0
+  CHECK(analyze(o, system, len, SWEEP_VERIFY));
+  return o->mainNeed;
+#else
+  return ERR_VERIFY_LIMIT;
+#endif
+}
+
+//-----------------------------------------------------------------------------
 int optimize(const sSys* system)
 {
-  CHECK(optimizeGoto(system));
-  return 0;
+  return optimize_code(&optimizerState, system);
+}
+
+//-----------------------------------------------------------------------------
+int verify(const sSys* system, int len)
+{
+  return optimize_verify(&optimizerState, system, len);
 }
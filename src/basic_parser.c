@@ -12,10 +12,26 @@
 //=============================================================================
 // Defines
 //=============================================================================
-#define READ_AHEAD_BUF_SIZE (MAX_NAME + 2)
-
 #define UPPER_CASE(x)       (((x) >= 'a' && (x) <= 'z') ? ((x)&0xDF) : (x))
-#define parseExpr(l)        (parser[l](l))
+#define parseExpr(l)        (parser[l](p, l))
+
+// Candidates for a name in a table: its hash chain (large programs) or all
+// entries
+#if BASIC_LARGE
+#define FOR_NAME(idx, tbl, cnt, name, len)                                     \
+  for (idx = *hashHead(p->tbl##Head, 2 * (cnt), name, len); idx >= 0;         \
+       idx = p->tbl##Next[idx])
+#define HASH_ADD(tbl, cnt, idx, name, len)                                     \
+  hashAdd(p->tbl##Head, 2 * (cnt), p->tbl##Next, idx, name, len)
+#define HASH_DEL(tbl, cnt, idx, name)                                          \
+  hashDel(p->tbl##Head, 2 * (cnt), p->tbl##Next, idx, name)
+#define HASH_BYTES (3 * (int)sizeof(idxType))  // Per name: 2 heads, 1 next
+#else
+#define FOR_NAME(idx, tbl, cnt, name, len) for (idx = 0; idx < (cnt); idx++)
+#define HASH_ADD(tbl, cnt, idx, name, len)
+#define HASH_DEL(tbl, cnt, idx, name)
+#define HASH_BYTES 0
+#endif
 
 //=============================================================================
 // Typedefs
@@ -28,17 +44,17 @@ typedef struct
 } sOperators;
 
 //-----------------------------------------------------------------------------
-typedef int (*fParser)(int);
+typedef int (*fParser)(sParser* p, int level);
 
 //=============================================================================
 // Prototypes
 //=============================================================================
-static int addInt(int value);
-static int parseDual(int level);
-static int parsePrefix(int level);
-static int parseVal(int level);
-static int parseStmt(void);
-static int parseBlock(void);
+static int addInt(sParser* p, int value);
+static int parseDual(sParser* p, int level);
+static int parsePrefix(sParser* p, int level);
+static int parseVal(sParser* p, int level);
+static int parseStmt(sParser* p);
+static int parseBlock(sParser* p);
 
 //=============================================================================
 // Constants
@@ -85,200 +101,208 @@ static const fParser parser[] =
 };
 // clang-format on
 
+#if PARSE_STATIC
 //=============================================================================
 // Private variables
 //=============================================================================
-static char    varName[MAX_VAR_NUM][MAX_NAME];
-static idxType varIndex[MAX_VAR_NUM];
-static idxType varLevel[MAX_VAR_NUM];
-static idxType varDim[MAX_VAR_NUM];
-static char    labels[MAX_LABELS][MAX_NAME];
-static idxType labelDst[MAX_LABELS];
-static char    subName[MAX_SUB_NUM][MAX_NAME];
-static idxType subLabel[MAX_SUB_NUM];
-static idxType subArgc[MAX_SUB_NUM];
-#if STAT
-static idxType maxVarNum;
+static sParser parserState;  // Of parseAll(), parseMem(), link(), parseStat()
+static char    parserArena[PARSE_ARENA_SIZE];  // Tables of parserState
 #endif
-static bool    optionExplicit = false;
-
-static char    exitLabel[2]   = "!";
-static idxType spAtBeginOfDo  = -1;
-static idxType spAtBeginOfFor = -1;
-static idxType exitDo         = -1;
-static idxType exitFor        = -1;
-
-static int curArgc = -1;
-
-static int sp = 0;  // Stack pointer tracking
-static int level;
-
-static const sSys* sys;
-static const char* s       = NULL;
-static int         lineNum = 1;
-static int         lineCol = 1;
 
 //=============================================================================
 // Private functions
 //=============================================================================
-static int fillBuffer(char* buffer, int len)
+static void* arenaAlloc(sParser* p, int size, int align)
+{
+  // Bump allocation, the arena is only checked at the end (parse_arena())
+  uintptr_t base = (uintptr_t)p->arena;
+  uintptr_t at   = (base + p->arenaUsed + align - 1) & ~(uintptr_t)(align - 1);
+
+  p->arenaUsed = at - base + size;
+  return (void*)at;
+}
+
+//-----------------------------------------------------------------------------
+static char nextChar(sParser* p)
 {
-  static bool quote = false;
-  char        c     = ' ';
+  if (!p->mem)
+    return p->sys->getNextChar();
+  return (p->mem < p->memEnd) ? *p->mem++ : '\0';
+}
 
-  while (len < READ_AHEAD_BUF_SIZE - 1 && c != '\n')
+//-----------------------------------------------------------------------------
+static void fillBuffer(sParser* p)
+{
+  // Keeps the previous char (see keycmp()) and reads until the end of the
+  // line, so the listing ends with the line of an error
+  int  keep = p->readEnd - p->s + 1;
+  char c    = ' ';
+
+  memmove(p->readBuf, p->s - 1, keep);
+  p->s       = &p->readBuf[1];
+  p->readEnd = &p->readBuf[keep];
+
+  while (p->readEnd < &p->readBuf[READ_BUF_SIZE] && c != '\n')
   {
-    c = sys->getNextChar();
+    c = nextChar(p);
 
     switch (c)
     {
       case '"':
-        quote = !quote;
+        p->quote = !p->quote;
         break;
       case '\n':
-        quote = false;
+        p->quote = false;
         break;
       case '\t':
         c = ' ';
         break;
       case '\'':
-        if (!quote)
-          while (c != '\n')
+        if (!p->quote)
+          while (c != '\n' && c != '\0')
           {
-            putchar(c);
-            c = sys->getNextChar();
+            if (p->sys->echo)
+              p->sys->echo(c);
+            c = nextChar(p);
           }
         break;
     }
 
     if (c != '\r')
-      buffer[++len] = c;
+      *p->readEnd++ = c;
 
     if (c == '\0')
-      return len;
-    putchar(c);
+      break;
+    if (p->sys->echo)
+      p->sys->echo(c);
   }
-  return len;
+  *p->readEnd = '\0';  // Numbers end here at the latest
 }
 
 //-----------------------------------------------------------------------------
-static void readChars(int cnt, bool skipSpace)
+static void readChars(sParser* p, int cnt, bool skipSpace)
 {
-  static char buffer[READ_AHEAD_BUF_SIZE];
-  static int  buflen = 0;
-
-  if (!s)
+  if (!p->s)
   {
-    buffer[0] = '\n';
-    buflen    = fillBuffer(buffer, 0);
-    s         = &buffer[1];
+    p->readBuf[0] = '\n';
+    p->s = p->readEnd = &p->readBuf[1];
+    fillBuffer(p);
   }
 
-  while ((cnt > 0 && cnt--) || (skipSpace && *s == ' '))
+  while ((cnt > 0 && cnt--) || (skipSpace && *p->s == ' '))
   {
-    lineCol = (*s == '\n') ? (++lineNum, 1) : lineCol + 1;
-    memmove(buffer, buffer + 1, sizeof(buffer) - 1);
-    buflen--;
-    if (buflen == 0 || buffer[buflen] != '\n')
-      buflen = fillBuffer(buffer, buflen);
+    p->lineCol = (*p->s == '\n') ? (++p->lineNum, 1) : p->lineCol + 1;
+    p->s++;
+    p->pos++;
+    if (p->s == p->readEnd ||
+        (p->readEnd - p->s < READ_AHEAD && p->readEnd[-1] != '\n' &&
+         p->readEnd[-1] != '\0'))
+      fillBuffer(p);
   }
 }
 
 //-----------------------------------------------------------------------------
 static bool isKeyword(const char* str, int len)
 {
+  // Perfect hash of the first and the last char and the length
   // clang-format off
-  const struct
-  {
-    const char* name;
-    int         len;
-  } keywords[] =
+  static const char* const keywords[64] =
   {
-    { "AND",    3 },
-    { "DIM",    3 },
-    { "DO",     2 },
-    { "ELSE",   4 },
-    { "ELSEIF", 6 },
-    { "END",    3 },
-    { "EXIT",   4 },
-    { "FALSE",  5 },
-    { "FOR",    3 },
-    { "GOTO",   4 },
-    { "IF",     2 },
-    { "LET",    3 },
-    { "LOOP",   4 },
-    { "MOD",    3 },
-    { "NEXT",   4 },
-    { "NOT",    3 },
-    { "OPTION", 6 },
-    { "OR",     2 },
-    { "PRINT",  5 },
-    { "REM",    3 },
-    { "RETURN", 6 },
-    { "STEP",   4 },
-    { "SUB",    3 },
-    { "THEN",   4 },
-    { "TO",     2 },
-    { "TRUE",   4 },
-    { "UNTIL",  5 },
-    { "WHILE",  5 },
+    NULL,     NULL,     NULL,     "OPTION", //  0
+    NULL,     "FOR",    "TO",     "LET",    //  4
+    NULL,     NULL,     "MOD",    NULL,     //  8
+    "RETURN", "NOT",    "NEXT",   NULL,     // 12
+    "THEN",   "REM",    NULL,     NULL,     // 16
+    NULL,     "PRINT",  "DO",     NULL,     // 20
+    "TRUE",   NULL,     NULL,     NULL,     // 24
+    NULL,     NULL,     NULL,     "OR",     // 28
+    NULL,     "GOTO",   "WHILE",  NULL,     // 32
+    "UNTIL",  "ELSEIF", "AND",    "DIM",    // 36
+    "LOOP",   NULL,     NULL,     "ELSE",   // 40
+    "SUB",    "IF",     NULL,     "FALSE",  // 44
+    NULL,     NULL,     "END",    "EXIT",   // 48
+    NULL,     NULL,     NULL,     NULL,     // 52
+    NULL,     NULL,     NULL,     NULL,     // 56
+    NULL,     "STEP",   NULL,     NULL,     // 60
   };
   // clang-format on
 
-  for (int i = 0; i < ARRAY_SIZE(keywords); i++)
-  {
-    if (len == keywords[i].len)
-    {
-      int j;
-      for (j = 0; j < len && keywords[i].name[j] == (str[j] & 0xDF); j++)
-        ;
-      if (j == len)
-        return true;
-    }
-  }
-  return false;
+  const char* kw = keywords[(3 * (str[0] & 0xDF) + 56 * (str[len - 1] & 0xDF) +
+                             len) & 63];
+  int         j;
+
+  if (!kw)
+    return false;
+  for (j = 0; j < len && kw[j] == (str[j] & 0xDF); j++)
+    ;
+  return j == len && kw[j] == '\0';
 }
 
 //-----------------------------------------------------------------------------
-static int keycmp(const char* kw)
+static int keycmp(sParser* p, const char* kw)
 {
-  if (s[-1] != ' ' && s[-1] != '\n')
+  if (p->s[-1] != ' ' && p->s[-1] != '\n')
     return 0;
 
   int l = 0;
-  while (kw[l] && ((s[l] & 0xDF) == kw[l]))
+  while (kw[l] && ((p->s[l] & 0xDF) == kw[l]))
     l++;
-  return (kw[l] == '\0' && (s[l] == ' ' || s[l] == '\n')) ? l : 0;
+  return (kw[l] == '\0' && (p->s[l] == ' ' || p->s[l] == '\n')) ? l : 0;
 }
 
 //-----------------------------------------------------------------------------
-static int keycon(const char* kw)
+static int keycon(sParser* p, const char* kw)
 {
-  int l = keycmp(kw);
+  int l = keycmp(p, kw);
   if (l > 0)
-    readChars(l, true);
+    readChars(p, l, true);
   return l;
 }
 
 //-----------------------------------------------------------------------------
-static int strcon(const char* str)
+static int symcmp(sParser* p, const char* str)
 {
   int l = 0;
-  while (str[l] && (UPPER_CASE(s[l]) == str[l]))
+  while (str[l] && (UPPER_CASE(p->s[l]) == str[l]))
     l++;
-  if (str[l])
-    return 0;
+  return str[l] ? 0 : l;
+}
+
+//-----------------------------------------------------------------------------
+static int strcon(sParser* p, const char* str)
+{
+  int l = symcmp(p, str);
   if (l > 0)
-    readChars(l, true);
+    readChars(p, l, true);
   return l;
 }
 
 //-----------------------------------------------------------------------------
-static int chrcon(char c)
+static uint32_t opTokens(sParser* p)
+{
+  // Operators at the current position (bit per entry of operators[]). All
+  // levels of an expression ask at the same position, it's scanned once
+  if (p->opPos != p->pos)
+  {
+    p->opPos  = p->pos;
+    p->opMask = 0;
+    for (int op = 0; op < (int)ARRAY_SIZE(operators); op++)
+    {
+      const char* str = operators[op].str;
+      if (str[0] == ' ' ? (str[1] == (*p->s & 0xDF) && keycmp(p, str + 1))
+                        : (str[0] == UPPER_CASE(*p->s) && symcmp(p, str)))
+        p->opMask |= 1u << op;
+    }
+  }
+  return p->opMask;
+}
+
+//-----------------------------------------------------------------------------
+static int chrcon(sParser* p, char c)
 {
-  if (c != *s)
+  if (c != *p->s)
     return 0;
-  readChars(1, true);
+  readChars(p, 1, true);
   return 1;
 }
 
@@ -294,10 +318,60 @@ static bool namecmp(const char* ref, const char* name, int len)
   return true;
 }
 
+#if BASIC_LARGE
+//----------------------------------------------------------------------------
+static idxType* hashHead(idxType* head, int buckets, const char* name,
+                         int len)
+{
+  // FNV-1a, case insensitive like namecmp()
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < len && i < MAX_NAME && name[i]; i++)
+    hash = (hash ^ (name[i] & 0xDF)) * 16777619u;
+  return &head[hash % buckets];
+}
+
 //----------------------------------------------------------------------------
-static int namecon(const char** name)
+static void hashAdd(idxType* head, int buckets, idxType* next, int idx,
+                    const char* name, int len)
 {
-  static char buf[MAX_NAME];
+  head      = hashHead(head, buckets, name, len);
+  next[idx] = *head;
+  *head     = idx;
+}
+
+//----------------------------------------------------------------------------
+static void hashDel(idxType* head, int buckets, idxType* next, int idx,
+                    const char* name)
+{
+  head = hashHead(head, buckets, name, MAX_NAME);
+  while (*head != idx)
+    head = &next[*head];
+  *head = next[idx];
+}
+
+//----------------------------------------------------------------------------
+static void hashInit(sParser* p)
+{
+  memset(p->varHead, 0xFF, 2 * MAX_VAR_NUM * sizeof(idxType));
+  memset(p->lblHead, 0xFF, 2 * MAX_LABELS * sizeof(idxType));
+  memset(p->subHead, 0xFF, 2 * MAX_SUB_NUM * sizeof(idxType));
+  memset(p->regHead, 0xFF, 2 * MAX_REG_NUM * sizeof(idxType));
+  memset(p->svcHead, 0xFF, 2 * MAX_SVC_NUM * sizeof(idxType));
+
+  // Registers and SVCs in ascending order, the first one of a name is found
+  for (int idx = MAX_REG_NUM - 1; idx >= 0; idx--)
+    if (p->sys->regs[idx].name)
+      HASH_ADD(reg, MAX_REG_NUM, idx, p->sys->regs[idx].name, MAX_NAME);
+  for (int idx = MAX_SVC_NUM - 1; idx >= 0; idx--)
+    if (p->sys->svcs[idx].name)
+      HASH_ADD(svc, MAX_SVC_NUM, idx, p->sys->svcs[idx].name, MAX_NAME);
+}
+#endif
+
+//----------------------------------------------------------------------------
+static int namecon(sParser* p, const char** name)
+{
+  const char* s = p->s;
 
   // clang-format off
   ENSURE((*s >= 'A' && *s <= 'Z') ||
@@ -305,7 +379,7 @@ static int namecon(const char** name)
          (*s == '$' || *s == '_'), ERR_NAME_INV);
 
   int l = 1;
-  while ((l < sizeof(buf)              ) &&
+  while ((l < (int)sizeof(p->name)     ) &&
          ((s[l] >= 'A' && s[l] <= 'Z') ||
           (s[l] >= 'a' && s[l] <= 'z') ||
           (s[l] >= '0' && s[l] <= '9') ||
@@ -317,73 +391,75 @@ static int namecon(const char** name)
 
   ENSURE(!isKeyword(s, l), ERR_NAME_KEYWORD);
 
-  memcpy(buf, s, l);
-  readChars(l, true);
+  memcpy(p->name, s, l);
+  readChars(p, l, true);
   if (name)
-    *name = buf;
+    *name = p->name;
   return l;
 }
 
 //-----------------------------------------------------------------------------
-static int getVar(const char* name, int len)
+static int getVar(sParser* p, const char* name, int len)
 {
-  for (int idx = MAX_VAR_NUM - 1; idx >= 0; idx--)
+  // Highest index of that name
+  int found = ERR_VAR_UNDEF;
+  int idx;
+
+  FOR_NAME(idx, var, MAX_VAR_NUM, name, len)
   {
-    if (namecmp(varName[idx], name, len))
-      return idx;
+    if (idx > found && namecmp(p->varName[idx], name, len))
+      found = idx;
   }
-  return ERR_VAR_UNDEF;
+  return found;
 }
 
 //-----------------------------------------------------------------------------
-static int addVar(const char* name, int len, int level)
+static int addVar(sParser* p, const char* name, int len, int level)
 {
-  int idx = getVar(name, len);
-  ENSURE(idx < 0 || varLevel[idx] != level, ERR_VAR_NAME);
-
-  for (idx = 0; idx < MAX_VAR_NUM; idx++)
-  {
-    if (varName[idx][0] == '\0')
-    {
-      memcpy(varName[idx], name, len);
-      if (len < MAX_NAME)
-        varName[idx][len] = '\0';
-      varLevel[idx] = level;
-      varDim[idx]   = 0;
+  // Added at the current level, which is the deepest one so far. So the
+  // levels of the slots never decrease and clrVar() frees the last ones
+  int idx = getVar(p, name, len);
+  ENSURE(idx < 0 || p->varLevel[idx] != level, ERR_VAR_NAME);
+  ENSURE(p->varCnt < MAX_VAR_NUM, ERR_VAR_COUNT);
+
+  idx = p->varCnt++;
+  memcpy(p->varName[idx], name, len);
+  if (len < MAX_NAME)
+    p->varName[idx][len] = '\0';
+  HASH_ADD(var, MAX_VAR_NUM, idx, name, len);
+  p->varLevel[idx] = level;
+  p->varDim[idx]   = 0;
 #if STAT
-      if (maxVarNum < idx + 1)
-        maxVarNum = idx + 1;
+  if (p->maxVarNum < idx + 1)
+    p->maxVarNum = idx + 1;
 #endif
-      return idx;
-    }
-  }
-  return ERR_VAR_COUNT;
+  return idx;
 }
 
 //-----------------------------------------------------------------------------
-static int getOrAddVar(const char* name, int len, bool allowAdd)
+static int getOrAddVar(sParser* p, const char* name, int len, bool allowAdd)
 {
-  int idx = getVar(name, len);
+  int idx = getVar(p, name, len);
   if (idx < 0 && allowAdd)
   {
-    CHECK(idx = addVar(name, len, level));
-    varIndex[idx] = sp;
-    CHECK(addInt(0));
+    CHECK(idx = addVar(p, name, len, p->level));
+    p->varIndex[idx] = p->sp;
+    CHECK(addInt(p, 0));
   }
   return idx;
 }
 
 //-----------------------------------------------------------------------------
-static int clrVar(int level)
+static int clrVar(sParser* p, int level)
 {
   int cnt = 0;
-  for (int idx = 0; idx < ARRAY_SIZE(varName); idx++)
+  while (p->varCnt > 0 && p->varLevel[p->varCnt - 1] >= level)
   {
-    if (varName[idx][0] == '\0' || varLevel[idx] < level)
-      continue;
-    varName[idx][0] = '\0';
-    if (varDim[idx] > 0)
-      cnt += varDim[idx];
+    int idx = --p->varCnt;
+    HASH_DEL(var, MAX_VAR_NUM, idx, p->varName[idx]);
+    p->varName[idx][0] = '\0';
+    if (p->varDim[idx] > 0)
+      cnt += p->varDim[idx];
     else
       cnt++;
   }
@@ -391,94 +467,84 @@ static int clrVar(int level)
 }
 
 //-----------------------------------------------------------------------------
-static int regIndex(const char* name, int len)
+static int regIndex(sParser* p, const char* name, int len)
 {
-  for (int idx = 0; idx < MAX_REG_NUM; idx++)
+  int idx;
+  FOR_NAME(idx, reg, MAX_REG_NUM, name, len)
   {
-    if (sys->regs[idx].name && namecmp(sys->regs[idx].name, name, len))
+    if (p->sys->regs[idx].name && namecmp(p->sys->regs[idx].name, name, len))
       return idx;
   }
   return ERR_REG_NOT_FOUND;
 }
 
 //-----------------------------------------------------------------------------
-static int svcIndex(const char* name, int len)
+static int svcIndex(sParser* p, const char* name, int len)
 {
-  for (int idx = 0; idx < MAX_SVC_NUM; idx++)
+  int idx;
+  FOR_NAME(idx, svc, MAX_SVC_NUM, name, len)
   {
-    if (sys->svcs[idx].name && namecmp(sys->svcs[idx].name, name, len))
+    if (p->sys->svcs[idx].name && namecmp(p->sys->svcs[idx].name, name, len))
       return idx;
   }
   return ERR_SUB_NOT_FOUND;
 }
 
 //-----------------------------------------------------------------------------
-static int subIndex(const char* name, int len)
+static int subIndex(sParser* p, const char* name, int len)
 {
   int idx;
-  for (idx = 0; idx < ARRAY_SIZE(subName); idx++)
+  FOR_NAME(idx, sub, MAX_SUB_NUM, name, len)
   {
-    if (namecmp(subName[idx], name, len))
+    if (namecmp(p->subName[idx], name, len))
       return idx;
   }
 
   // not found -> add
-  for (idx = 0; idx < ARRAY_SIZE(subName); idx++)
-  {
-    if (subName[idx][0] == '\0')
-    {
-      memcpy(subName[idx], name, len);
-      if (len < MAX_NAME)
-        subName[idx][len] = '\0';
-      subArgc[idx] = subLabel[idx] = -1;
-      return idx;
-    }
-  }
-
-  // no free slot found -> error
-  return ERR_SUB_COUNT;
+  ENSURE(p->subCnt < MAX_SUB_NUM, ERR_SUB_COUNT);
+  idx = p->subCnt++;
+  memcpy(p->subName[idx], name, len);
+  if (len < MAX_NAME)
+    p->subName[idx][len] = '\0';
+  HASH_ADD(sub, MAX_SUB_NUM, idx, name, len);
+  p->subArgc[idx] = p->subLabel[idx] = -1;
+  return idx;
 }
 
 //-----------------------------------------------------------------------------
-static int lblIndex(const char* name, int len, int dst)
+static int lblIndex(sParser* p, const char* name, int len, int dst)
 {
   int idx;
-  for (idx = 0; idx < ARRAY_SIZE(labels); idx++)
+  FOR_NAME(idx, lbl, MAX_LABELS, name, len)
   {
-    if (namecmp(labels[idx], name, len))
+    if (namecmp(p->labels[idx], name, len))
     {
-      ENSURE(dst == -1 || labelDst[idx] == (idxType)-1, ERR_LABEL_DUPL);
+      ENSURE(dst == -1 || p->labelDst[idx] == (idxType)-1, ERR_LABEL_DUPL);
       if (dst != -1)
-        labelDst[idx] = dst;
+        p->labelDst[idx] = dst;
       return idx;
     }
   }
 
   // not found -> add
-  for (idx = 0; idx < ARRAY_SIZE(labels); idx++)
-  {
-    if (labels[idx][0] == '\0')
-    {
-      memcpy(labels[idx], name, len);
-      if (len < MAX_NAME)
-        labels[idx][len] = '\0';
-      labelDst[idx] = dst;
-      return idx;
-    }
-  }
-
-  // no free slot found -> error
-  return ERR_LABEL_COUNT;
+  ENSURE(p->lblCnt < MAX_LABELS, ERR_LABEL_COUNT);
+  idx = p->lblCnt++;
+  memcpy(p->labels[idx], name, len);
+  if (len < MAX_NAME)
+    p->labels[idx][len] = '\0';
+  HASH_ADD(lbl, MAX_LABELS, idx, name, len);
+  p->labelDst[idx] = dst;
+  return idx;
 }
 
 //-----------------------------------------------------------------------------
-static void trackStack(eOp op, int param, int param2)
+static void trackStack(sParser* p, eOp op, int param, int param2)
 {
   switch (op)
   {
     case CMD_PRINT:
     case CMD_POP:
-      sp -= param + 1;
+      p->sp -= param + 1;
       break;
     case CMD_RETURN:
     case CMD_GOSUB:
@@ -488,10 +554,10 @@ static void trackStack(eOp op, int param, int param2)
       break;
     case CMD_LET_GLOBAL:
     case CMD_LET_LOCAL:
-      sp -= (param2 > 0) ? 2 : 1;
+      p->sp -= (param2 > 0) ? 2 : 1;
       break;
     case CMD_LET_PTR:
-      sp -= 2;
+      p->sp -= 2;
       break;
     case CMD_LET_REG:
     case CMD_IF:
@@ -513,7 +579,7 @@ static void trackStack(eOp op, int param, int param2)
     case OP_DIV:
     case OP_IDIV:
     case OP_POW:
-      sp--;
+      p->sp--;
       break;
     case VAL_ZERO:
     case VAL_INTEGER:
@@ -522,223 +588,228 @@ static void trackStack(eOp op, int param, int param2)
     case VAL_PTR:
     case CMD_GET_REG:
     case CMD_CREATE_PTR:
-      sp++;
+      p->sp++;
       break;
     case CMD_GET_GLOBAL:
     case CMD_GET_LOCAL:
       if (param2 == 0)
-        sp++;
+        p->sp++;
       break;
   }
 }
 
 //-----------------------------------------------------------------------------
-static int newCode(sCodeIdx* code, eOp op)
+static int newCode(sParser* p, sCodeIdx* code, eOp op)
 {
-  CHECK(sys->newCode(code, op));
-  trackStack(op, 0, 0);
+  CHECK(p->sys->newCode(code, op));
+  trackStack(p, op, 0, 0);
   return code->idx;
 }
 
 //-----------------------------------------------------------------------------
-static int addCode(eOp op, int param)
+static int addCode(sParser* p, eOp op, int param)
 {
   sCode code = {.op = op, .param = param, .param2 = 0};
   // Local var and ptr can have neg param
   if (op != CMD_GET_LOCAL && op != CMD_LET_LOCAL && op != CMD_GET_PTR &&
       op != CMD_LET_PTR)
     CHECK(param);
-  trackStack(op, param, 0);
-  return sys->addCode(&code);
+  trackStack(p, op, param, 0);
+  return p->sys->addCode(&code);
 }
 
 //-----------------------------------------------------------------------------
-static int addCode2(eOp op, int param, int param2)
+static int addCode2(sParser* p, eOp op, int param, int param2)
 {
   sCode code = {.op = op, .param = param, .param2 = param2};
   // Local var and ptr can have neg param / param 2
   if (op != CMD_GET_LOCAL && op != CMD_LET_LOCAL && op != CMD_GET_PTR &&
       op != CMD_LET_PTR && op != CMD_CREATE_PTR)
     CHECK(param);
-  if (op != CMD_CREATE_PTR)
+  if (op != CMD_CREATE_PTR && op != CMD_NEXT_LOCAL)
     CHECK(param2);
-  trackStack(op, param, param2);
-  return sys->addCode(&code);
+  trackStack(p, op, param, param2);
+  return p->sys->addCode(&code);
 }
 
 //-----------------------------------------------------------------------------
-static int addStr(const char* str, sLenType len)
+static int addStr(sParser* p, const char* str, sLenType len)
 {
-  sCode code = {
-      .op = VAL_STRING, .str.start = sys->setString(str, len), .str.len = len};
+  sCode code = {.op        = VAL_STRING,
+                .str.start = p->sys->setString(str, len),
+                .str.len   = len};
   CHECK(code.str.start);
-  trackStack(code.op, 0, 0);
-  return sys->addCode(&code);
+#if STAT
+  p->strBytes += len;
+#endif
+  trackStack(p, code.op, 0, 0);
+  return p->sys->addCode(&code);
 }
 
 //-----------------------------------------------------------------------------
-static int addFloat(float value)
+static int addFloat(sParser* p, float value)
 {
   sCode code = {.op = VAL_FLOAT, .fValue = value};
-  trackStack(code.op, 0, 0);
-  return sys->addCode(&code);
+  trackStack(p, code.op, 0, 0);
+  return p->sys->addCode(&code);
 }
 
 //-----------------------------------------------------------------------------
-static int addInt(int value)
+static int addInt(sParser* p, int value)
 {
   sCode code = {.op = (value == 0) ? VAL_ZERO : VAL_INTEGER, .iValue = value};
-  trackStack(code.op, 0, 0);
-  return sys->addCode(&code);
+  trackStack(p, code.op, 0, 0);
+  return p->sys->addCode(&code);
 }
 
 //-----------------------------------------------------------------------------
-static int parseArray(idxType idx)
+static int parseArray(sParser* p, idxType idx)
 {
-  ENSURE(varDim[idx] != 0, ERR_NOT_ARRAY);
+  ENSURE(p->varDim[idx] != 0, ERR_NOT_ARRAY);
   CHECK(parseExpr(0));
-  ENSURE(chrcon(')'), ERR_BRACKETS_MISS);
-  if (varDim[idx] > 0)
-    return addCode2(varLevel[idx] ? CMD_GET_LOCAL : CMD_GET_GLOBAL,
-                    varIndex[idx], varDim[idx]);
-  ENSURE(varLevel[idx] > 0, ERR_NOT_IMPL);  // Ptr can't exist globally
-  return addCode(CMD_GET_PTR, varIndex[idx]);
+  ENSURE(chrcon(p, ')'), ERR_BRACKETS_MISS);
+  if (p->varDim[idx] > 0)
+    return addCode2(p, p->varLevel[idx] ? CMD_GET_LOCAL : CMD_GET_GLOBAL,
+                    p->varIndex[idx], p->varDim[idx]);
+  ENSURE(p->varLevel[idx] > 0, ERR_NOT_IMPL);  // Ptr can't exist globally
+  return addCode(p, CMD_GET_PTR, p->varIndex[idx]);
 }
 
 //-----------------------------------------------------------------------------
-static int parseFunc(const char* name, int len, bool sub)
+static int parseFunc(sParser* p, const char* name, int len, bool sub)
 {
   int     argc = 0;
-  idxType idx  = svcIndex(name, len);
+  idxType idx  = svcIndex(p, name, len);
   bool    svc  = (idx >= 0);
   char    end  = sub ? '\n' : ')';
 
   if (!svc)
-    CHECK(idx = subIndex(name, len));
+    CHECK(idx = subIndex(p, name, len));
 
-  CHECK(addInt(0));  // Return value
-  if (*s != end)
+  CHECK(addInt(p, 0));  // Return value
+  if (*p->s != end)
     do
     {
       CHECK(parseExpr(0));
       argc++;
-    } while (chrcon(','));
-  ENSURE(chrcon(end), sub ? ERR_NEWLINE : ERR_BRACKETS_MISS);
+    } while (chrcon(p, ','));
+  ENSURE(chrcon(p, end), sub ? ERR_NEWLINE : ERR_BRACKETS_MISS);
 
   if (svc)
   {
-    ENSURE(argc == sys->svcs[idx].argc, ERR_ARG_MISMATCH);
-    CHECK(addCode(CMD_SVC, idx));
+    ENSURE(argc == p->sys->svcs[idx].argc, ERR_ARG_MISMATCH);
+    CHECK(addCode(p, CMD_SVC, idx));
   }
   else
   {
-    ENSURE(subArgc[idx] < 0 || subArgc[idx] == argc, ERR_ARG_MISMATCH);
-    CHECK(addCode(LNK_GOSUB, idx));
+    ENSURE(p->subArgc[idx] < 0 || p->subArgc[idx] == argc, ERR_ARG_MISMATCH);
+    CHECK(addCode(p, LNK_GOSUB, idx));
   }
-  sp -= argc;
+  p->sp -= argc;
 
   if (sub)
-    CHECK(addCode(CMD_POP, 0));  // Return value not used -> consume
+    CHECK(addCode(p, CMD_POP, 0));  // Return value not used -> consume
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static int parseVal(int level)
+static int parseVal(sParser* p, int level)
 {
   const char* name;
   int         len;
   (void)level;
 
   // Empty
-  if (*s == '\n')
+  if (*p->s == '\n')
     return ERR_EXPR_MISSING;
 
   // Constants
-  if (keycon("TRUE"))
-    return addInt(-1);
-  if (keycon("FALSE"))
-    return addInt(0);
+  if (keycon(p, "TRUE"))
+    return addInt(p, -1);
+  if (keycon(p, "FALSE"))
+    return addInt(p, 0);
 
   // String
-  if (*s == '"')
+  if (*p->s == '"')
   {
     char str[MAX_STRING];
     int  len = 0;
-    readChars(1, false);
-    while (*s != '"')
+    readChars(p, 1, false);
+    while (*p->s != '"')
     {
-      ENSURE(*s >= ' ', ERR_STR_INV);
+      ENSURE(*p->s >= ' ', ERR_STR_INV);
       ENSURE(len < sizeof(str), ERR_STR_LENGTH);
-      str[len++] = *s;
-      readChars(1, false);
+      str[len++] = *p->s;
+      readChars(p, 1, false);
     }
-    readChars(1, true);
-    return addStr(str, len);
+    readChars(p, 1, true);
+    return addStr(p, str, len);
   }
 
   // Bracket
-  if (chrcon('('))
+  if (chrcon(p, '('))
   {
     CHECK(parseExpr(0));
-    ENSURE(chrcon(')'), ERR_EXPR_BRACKETS);
+    ENSURE(chrcon(p, ')'), ERR_EXPR_BRACKETS);
     return 0;
   }
 
   // Hex
-  if (memcmp(s, "0x", 2) == 0 || memcmp(s, "&H", 2) == 0)
+  if (memcmp(p->s, "0x", 2) == 0 || memcmp(p->s, "&H", 2) == 0)
   {
-    readChars(2, false);
+    readChars(p, 2, false);
     char* end;
-    int   res = strtoul(s, &end, 16);
-    ENSURE(end > s, ERR_NUM_INV);
-    readChars(end - s, true);
-    return addInt(res);
+    int   res = strtoul(p->s, &end, 16);
+    ENSURE(end > p->s, ERR_NUM_INV);
+    readChars(p, end - p->s, true);
+    return addInt(p, res);
   }
 
   // Decimal
-  if (*s >= '0' && *s <= '9')
+  if (*p->s >= '0' && *p->s <= '9')
   {
     char* end;
-    int   res = strtoul(s, &end, 10);
-    ENSURE(end > s, ERR_NUM_INV);
+    int   res = strtoul(p->s, &end, 10);
+    ENSURE(end > p->s, ERR_NUM_INV);
     if (*end == '.' || *end == 'E' || *end == 'e')  // float
     {
-      float val = strtof(s, &end);
-      readChars(end - s, true);
-      return addFloat(val);
+      float val = strtof(p->s, &end);
+      readChars(p, end - p->s, true);
+      return addFloat(p, val);
     }
-    readChars(end - s, true);
-    return addInt(res);
+    readChars(p, end - p->s, true);
+    return addInt(p, res);
   }
 
   // Registers
-  if (*s == '$')
+  if (*p->s == '$')
   {
-    CHECK(len = namecon(&name));
-    return addCode(CMD_GET_REG, regIndex(name, len));
+    CHECK(len = namecon(p, &name));
+    return addCode(p, CMD_GET_REG, regIndex(p, name, len));
   }
 
   // Functions / Arrays
-  CHECK(len = namecon(&name));
-  if (chrcon('('))
+  CHECK(len = namecon(p, &name));
+  if (chrcon(p, '('))
   {
-    idxType idx = getVar(name, len);
+    idxType idx = getVar(p, name, len);
     if (idx >= 0)
-      return parseArray(idx);
-    return parseFunc(name, len, false);
+      return parseArray(p, idx);
+    return parseFunc(p, name, len, false);
   }
 
   // Variables
   idxType idx;
-  CHECK(idx = getVar(name, len));
-  if (varDim[idx] != 0)  // Array without index
-    return addCode2(varLevel[idx] ? CMD_CREATE_PTR : VAL_PTR, varIndex[idx],
-                    varDim[idx]);
-  return addCode(varLevel[idx] ? CMD_GET_LOCAL : CMD_GET_GLOBAL, varIndex[idx]);
+  CHECK(idx = getVar(p, name, len));
+  if (p->varDim[idx] != 0)  // Array without index
+    return addCode2(p, p->varLevel[idx] ? CMD_CREATE_PTR : VAL_PTR,
+                    p->varIndex[idx], p->varDim[idx]);
+  return addCode(p, p->varLevel[idx] ? CMD_GET_LOCAL : CMD_GET_GLOBAL,
+                 p->varIndex[idx]);
 }
 
 //-----------------------------------------------------------------------------
-static int parseDual(int level)
+static int parseDual(sParser* p, int level)
 {
   int op;
 
@@ -746,608 +817,679 @@ static int parseDual(int level)
 
   while (1)
   {
+    uint32_t mask = opTokens(p);
+    if (mask == 0)
+      return 0;
     for (op = 0; op < ARRAY_SIZE(operators); op++)
-    {
-      if (operators[op].level != level)
-        continue;
-
-      if ((operators[op].str[0] == ' ' && keycon(operators[op].str + 1)) ||
-          (operators[op].str[0] != ' ' && strcon(operators[op].str)))
+      if (operators[op].level == level && (mask & (1u << op)))
         break;
-    }
     if (op >= ARRAY_SIZE(operators))
       return 0;
 
+    if (operators[op].str[0] == ' ')
+      keycon(p, operators[op].str + 1);
+    else
+      strcon(p, operators[op].str);
     CHECK(parseExpr(level + 1));
-    addCode(operators[op].operator, 0);
+    addCode(p, operators[op].operator, 0);
   }
 }
 
 //-----------------------------------------------------------------------------
-static int parsePrefix(int level)
+static int parsePrefix(sParser* p, int level)
 {
-  int op;
+  uint32_t mask = opTokens(p);
+  int      op;
 
-  for (op = 0; op < ARRAY_SIZE(operators); op++)
-  {
-    if (operators[op].level != level)
-      continue;
-
-    if (strcon(operators[op].str))
+  for (op = 0; op < (int)ARRAY_SIZE(operators) && mask; op++)
+    if (operators[op].level == level && (mask & (1u << op)))
       break;
-  }
-  if (op >= ARRAY_SIZE(operators))
+  if (!mask || op >= (int)ARRAY_SIZE(operators))
     return parseExpr(level + 1);
 
+  strcon(p, operators[op].str);
   CHECK(parseExpr(level));
-  return addCode(operators[op].operator, 0);
+  return addCode(p, operators[op].operator, 0);
 }
 
 //-----------------------------------------------------------------------------
-static int parseDim()
+static int parseDim(sParser* p)
 {
   const char* name;
   int         len;
   idxType     idx;
   int         dim = 0;
-  ENSURE(*s != '$', ERR_VAR_NAME);
-  CHECK(len = namecon(&name));
-  if (chrcon('('))  // Array
+  ENSURE(*p->s != '$', ERR_VAR_NAME);
+  CHECK(len = namecon(p, &name));
+  if (chrcon(p, '('))  // Array
   {
     char* end;
-    dim = strtoul(s, &end, 10);
-    ENSURE(end > s, ERR_NUM_INV);
+    dim = strtoul(p->s, &end, 10);
+    ENSURE(end > p->s, ERR_NUM_INV);
     ENSURE(dim > 0, ERR_DIM_INV);
-    readChars(end - s, true);
-    ENSURE(chrcon(')'), ERR_BRACKETS_MISS);
+    readChars(p, end - p->s, true);
+    ENSURE(chrcon(p, ')'), ERR_BRACKETS_MISS);
   }
-  CHECK(idx = addVar(name, len, level));
-  varIndex[idx] = sp;
-  varDim[idx]   = dim;
+  CHECK(idx = addVar(p, name, len, p->level));
+  p->varIndex[idx] = p->sp;
+  p->varDim[idx]   = dim;
   if (dim > 0)         // No assignment allowed for array
     for (int i = 0; i < dim; i++)
-      CHECK(addInt(0));
-  else if (chrcon('=')) // Dim with assignment
+      CHECK(addInt(p, 0));
+  else if (chrcon(p, '=')) // Dim with assignment
     CHECK(parseExpr(0));
   else                  // No assignment -> default = 0
-    CHECK(addInt(0));
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
+    CHECK(addInt(p, 0));
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static int parsePrint()
+static int parsePrint(sParser* p)
 {
   int cnt = 0;
   CHECK(parseExpr(0));
-  while (chrcon(';'))
+  while (chrcon(p, ';'))
   {
-    if (chrcon('\n'))
-      return addCode(CMD_PRINT, cnt);
+    if (chrcon(p, '\n'))
+      return addCode(p, CMD_PRINT, cnt);
     CHECK(parseExpr(0));
     cnt++;
   }
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-  CHECK(addStr(BASIC_OUT_EOL, strlen(BASIC_OUT_EOL)));
-  return addCode(CMD_PRINT, cnt + 1);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  CHECK(addStr(p, BASIC_OUT_EOL, strlen(BASIC_OUT_EOL)));
+  return addCode(p, CMD_PRINT, cnt + 1);
 }
 
 //-----------------------------------------------------------------------------
-static int parseAssign(const char* name, int len)
+static int parseAssign(sParser* p, const char* name, int len)
 {
   bool    reg = (name[0] == '$');
   idxType idx;
-  CHECK(idx = reg ? regIndex(name, len) : getOrAddVar(name, len, !optionExplicit));
-  ENSURE(reg || varDim[idx] == 0, ERR_ARRAY);
+  CHECK(idx = reg ? regIndex(p, name, len)
+                  : getOrAddVar(p, name, len, !p->optionExplicit));
+  ENSURE(reg || p->varDim[idx] == 0, ERR_ARRAY);
   CHECK(parseExpr(0));
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
 
   if (reg)
-    return addCode(CMD_LET_REG, idx);
-  return addCode(varLevel[idx] ? CMD_LET_LOCAL : CMD_LET_GLOBAL, varIndex[idx]);
+    return addCode(p, CMD_LET_REG, idx);
+  return addCode(p, p->varLevel[idx] ? CMD_LET_LOCAL : CMD_LET_GLOBAL,
+                 p->varIndex[idx]);
 }
 
 //-----------------------------------------------------------------------------
-static int parseArrayAssign(const char* name, int len)
+static int parseArrayAssign(sParser* p, const char* name, int len)
 {
-  idxType idx = getVar(name, len);
+  idxType idx = getVar(p, name, len);
   ENSURE(name[0] != '$', ERR_NOT_IMPL);  // TODO: Implement array registers
   ENSURE(idx >= 0, ERR_ARRAY_NOT_FOUND);
-  ENSURE(varDim[idx] != 0, ERR_NOT_ARRAY);
+  ENSURE(p->varDim[idx] != 0, ERR_NOT_ARRAY);
   CHECK(parseExpr(0));
-  ENSURE(chrcon(')'), ERR_BRACKETS_MISS);
-  ENSURE(chrcon('='), ERR_ASSIGN);
+  ENSURE(chrcon(p, ')'), ERR_BRACKETS_MISS);
+  ENSURE(chrcon(p, '='), ERR_ASSIGN);
   CHECK(parseExpr(0));
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-  if (varDim[idx] > 0)
-    return addCode2(varLevel[idx] ? CMD_LET_LOCAL : CMD_LET_GLOBAL,
-                    varIndex[idx], varDim[idx]);
-  ENSURE(varLevel[idx] > 0, ERR_NOT_IMPL);  // Ptr can't exist globally
-  return addCode(CMD_LET_PTR, varIndex[idx]);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  if (p->varDim[idx] > 0)
+    return addCode2(p, p->varLevel[idx] ? CMD_LET_LOCAL : CMD_LET_GLOBAL,
+                    p->varIndex[idx], p->varDim[idx]);
+  ENSURE(p->varLevel[idx] > 0, ERR_NOT_IMPL);  // Ptr can't exist globally
+  return addCode(p, CMD_LET_PTR, p->varIndex[idx]);
 }
 
 //-----------------------------------------------------------------------------
-static int parseExit()
+static int parseExit(sParser* p)
 {
-  if (keycon("SUB"))
+  if (keycon(p, "SUB"))
   {
-    ENSURE(chrcon('\n'), ERR_NEWLINE);
-    ENSURE(curArgc >= 0, ERR_EXIT_SUB);
-    return addCode(CMD_RETURN, curArgc);
+    ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+    ENSURE(p->curArgc >= 0, ERR_EXIT_SUB);
+    return addCode(p, CMD_RETURN, p->curArgc);
   }
 
   idxType* exit;
-  if (keycon("DO"))
-    exit = &exitDo;
-  else if (keycon("FOR"))
-    exit = &exitFor;
+  if (keycon(p, "DO"))
+    exit = &p->exitDo;
+  else if (keycon(p, "FOR"))
+    exit = &p->exitFor;
   else
     return ERR_NOT_IMPL;
 
-  idxType spAtBegin = (exit == &exitDo) ? spAtBeginOfDo : spAtBeginOfFor;
-  ENSURE(spAtBegin >= 0, (exit == &exitDo) ? ERR_EXIT_DO : ERR_EXIT_FOR);
+  idxType spAtBegin =
+      (exit == &p->exitDo) ? p->spAtBeginOfDo : p->spAtBeginOfFor;
+  ENSURE(spAtBegin >= 0, (exit == &p->exitDo) ? ERR_EXIT_DO : ERR_EXIT_FOR);
   if (*exit < 0)
   {
-    CHECK(*exit = lblIndex(exitLabel, 2, -1));
-    exitLabel[1]++;
+    CHECK(*exit = lblIndex(p, p->exitLabel, 2, -1));
+    p->exitLabel[1]++;
   }
-  if (sp > spAtBegin)
-    CHECK(addCode(CMD_POP, sp - spAtBegin - 1));
-  CHECK(addCode(LNK_GOTO, *exit));
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
+  int oldSp = p->sp;  // Following code continues with the stack of the loop
+  if (p->sp > spAtBegin)
+    CHECK(addCode(p, CMD_POP, p->sp - spAtBegin - 1));
+  CHECK(addCode(p, LNK_GOTO, *exit));
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  p->sp = oldSp;
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static int parseReturn()
+static int parseReturn(sParser* p)
 {
-  ENSURE(curArgc >= 0, ERR_EXIT_SUB);
+  ENSURE(p->curArgc >= 0, ERR_EXIT_SUB);
   CHECK(parseExpr(0));
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-  CHECK(addCode(CMD_LET_LOCAL, -curArgc - 1));
-  return addCode(CMD_RETURN, curArgc);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  CHECK(addCode(p, CMD_LET_LOCAL, -p->curArgc - 1));
+  return addCode(p, CMD_RETURN, p->curArgc);
 }
 
 //-----------------------------------------------------------------------------
-static int parseGoto()
+static int parseGoto(sParser* p)
 {
   const char* name;
   int         len;
-  CHECK(len = namecon(&name));
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-  return addCode(LNK_GOTO, lblIndex(name, len, -1));
+  CHECK(len = namecon(p, &name));
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  return addCode(p, LNK_GOTO, lblIndex(p, name, len, -1));
 }
 
 //-----------------------------------------------------------------------------
-static int parseIf()
+static int parseIf(sParser* p)
 {
   sCodeIdx cond;
   sCodeIdx eob = {.idx = -1};
 
   CHECK(parseExpr(0));
-  CHECK(newCode(&cond, CMD_IF));
-  ENSURE(keycon("THEN"), ERR_IF_THEN);
-  if (chrcon('\n'))  // multi line IF
+  CHECK(newCode(p, &cond, CMD_IF));
+  ENSURE(keycon(p, "THEN"), ERR_IF_THEN);
+  if (chrcon(p, '\n'))  // multi line IF
   {
-    CHECK(parseBlock());
-    while (keycon("ELSEIF"))
+    CHECK(parseBlock(p));
+    while (keycon(p, "ELSEIF"))
     {
       if (eob.idx >= 0)
       {
-        CHECK(eob.code.param = sys->getCodeNextIndex());
-        CHECK(sys->setCode(&eob));
+        CHECK(eob.code.param = p->sys->getCodeNextIndex());
+        CHECK(p->sys->setCode(&eob));
       }
-      CHECK(newCode(&eob, CMD_GOTO));
+      CHECK(newCode(p, &eob, CMD_GOTO));
 
-      CHECK(cond.code.param = sys->getCodeNextIndex());
-      CHECK(sys->setCode(&cond));
+      CHECK(cond.code.param = p->sys->getCodeNextIndex());
+      CHECK(p->sys->setCode(&cond));
       CHECK(parseExpr(0));
-      CHECK(newCode(&cond, CMD_IF));
-      ENSURE(keycon("THEN"), ERR_IF_THEN);
-      ENSURE(chrcon('\n'), ERR_NEWLINE);
-      CHECK(parseBlock());
+      CHECK(newCode(p, &cond, CMD_IF));
+      ENSURE(keycon(p, "THEN"), ERR_IF_THEN);
+      ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+      CHECK(parseBlock(p));
     }
     if (eob.idx >= 0)
     {
-      CHECK(eob.code.param = sys->getCodeNextIndex());
-      CHECK(sys->setCode(&eob));
+      CHECK(eob.code.param = p->sys->getCodeNextIndex());
+      CHECK(p->sys->setCode(&eob));
     }
 
-    if (keycon("ELSE"))
+    if (keycon(p, "ELSE"))
     {
-      ENSURE(chrcon('\n'), ERR_NEWLINE);
-      CHECK(newCode(&eob, CMD_GOTO));
-      CHECK(cond.code.param = sys->getCodeNextIndex());
-      CHECK(sys->setCode(&cond));
-      CHECK(parseBlock());
-      CHECK(eob.code.param = sys->getCodeNextIndex());
-      CHECK(sys->setCode(&eob));
+      ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+      CHECK(newCode(p, &eob, CMD_GOTO));
+      CHECK(cond.code.param = p->sys->getCodeNextIndex());
+      CHECK(p->sys->setCode(&cond));
+      CHECK(parseBlock(p));
+      CHECK(eob.code.param = p->sys->getCodeNextIndex());
+      CHECK(p->sys->setCode(&eob));
     }
     else  // End If
     {
-      CHECK(cond.code.param = sys->getCodeNextIndex());
-      CHECK(sys->setCode(&cond));
+      CHECK(cond.code.param = p->sys->getCodeNextIndex());
+      CHECK(p->sys->setCode(&cond));
     }
-    ENSURE(keycon("IF"), ERR_IF_ENDIF);
-    ENSURE(chrcon('\n'), ERR_NEWLINE);
+    ENSURE(keycon(p, "IF"), ERR_IF_ENDIF);
+    ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
   }
   else  // single line IF (no ELSE allowed)
   {
-    CHECK(parseStmt());
-    CHECK(cond.code.param = sys->getCodeNextIndex());
-    CHECK(sys->setCode(&cond));
+    CHECK(parseStmt(p));
+    CHECK(cond.code.param = p->sys->getCodeNextIndex());
+    CHECK(p->sys->setCode(&cond));
   }
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static int parseDo()
+static int parseDo(sParser* p)
 {
   sCodeIdx top = {.idx = -1};
   idxType  hdr;
-  idxType  oldSp = spAtBeginOfDo;
+  idxType  oldSp = p->spAtBeginOfDo;
 
-  spAtBeginOfDo = sp;
-  CHECK(hdr = sys->getCodeNextIndex());
-  if (keycon("WHILE"))
+  p->spAtBeginOfDo = p->sp;
+  CHECK(hdr = p->sys->getCodeNextIndex());
+  if (keycon(p, "WHILE"))
   {
     CHECK(parseExpr(0));
-    CHECK(newCode(&top, CMD_IF));
+    CHECK(newCode(p, &top, CMD_IF));
   }
-  else if (keycon("UNTIL"))
+  else if (keycon(p, "UNTIL"))
   {
     CHECK(parseExpr(0));
-    CHECK(addCode(OP_NOT, 0));
-    CHECK(newCode(&top, CMD_IF));
+    CHECK(addCode(p, OP_NOT, 0));
+    CHECK(newCode(p, &top, CMD_IF));
   }
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
 
-  CHECK(parseBlock());
-  ENSURE(keycon("LOOP"), ERR_DO_LOOP);
+  CHECK(parseBlock(p));
+  ENSURE(keycon(p, "LOOP"), ERR_DO_LOOP);
 
-  if (keycon("UNTIL"))
+  if (keycon(p, "UNTIL"))
   {
     CHECK(parseExpr(0));
-    CHECK(addCode(CMD_IF, hdr));
+    CHECK(addCode(p, CMD_IF, hdr));
   }
-  else if (keycon("WHILE"))
+  else if (keycon(p, "WHILE"))
   {
     CHECK(parseExpr(0));
-    CHECK(addCode(OP_NOT, 0));
-    CHECK(addCode(CMD_IF, hdr));
+    CHECK(addCode(p, OP_NOT, 0));
+    CHECK(addCode(p, CMD_IF, hdr));
   }
   else
-    CHECK(addCode(CMD_GOTO, hdr));
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
+    CHECK(addCode(p, CMD_GOTO, hdr));
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
   if (top.idx != -1)
   {
-    CHECK(top.code.param = sys->getCodeNextIndex());
-    CHECK(sys->setCode(&top));
+    CHECK(top.code.param = p->sys->getCodeNextIndex());
+    CHECK(p->sys->setCode(&top));
   }
-  if (exitDo >= 0)
+  if (p->exitDo >= 0)
   {
-    CHECK(labelDst[exitDo] = sys->getCodeNextIndex());
-    exitDo = -1;
+    CHECK(p->labelDst[p->exitDo] = p->sys->getCodeNextIndex());
+    p->exitDo = -1;
   }
-  spAtBeginOfDo = oldSp;
+  p->spAtBeginOfDo = oldSp;
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static int parseFor()
+static int parseFor(sParser* p)
 {
-  idxType     hdr;
+  idxType     body;
   sCodeIdx    cond;
   int         varIdx;
   eOp         varSet;
-  eOp         varGet;
+  eOp         varNext;
   const char* name;
   int         len;
-  idxType     oldSp = spAtBeginOfFor;
-  spAtBeginOfFor    = sp;
-
-  level++;
-  ENSURE(*s != '$', ERR_VAR_NAME);
-  CHECK(len = namecon(&name));
-  varIdx = getOrAddVar(name, len, true);
-  varGet = varLevel[varIdx] ? CMD_GET_LOCAL : CMD_GET_GLOBAL;
-  varSet = varLevel[varIdx] ? CMD_LET_LOCAL : CMD_LET_GLOBAL;
-  varIdx = varIndex[varIdx];
-
-  ENSURE(chrcon('='), ERR_ASSIGN);
-  CHECK(parseExpr(0));
-  CHECK(addCode(varSet, varIdx));
-  ENSURE(keycon("TO"), ERR_FOR_TO);
-  CHECK(hdr = sys->getCodeNextIndex());
-  CHECK(addCode(varGet, varIdx));
+  idxType     oldSp = p->spAtBeginOfFor;
+  p->spAtBeginOfFor = p->sp;
+
+  p->level++;
+  ENSURE(*p->s != '$', ERR_VAR_NAME);
+  CHECK(len = namecon(p, &name));
+  varIdx = getOrAddVar(p, name, len, true);
+  varSet  = p->varLevel[varIdx] ? CMD_LET_LOCAL : CMD_LET_GLOBAL;
+  varNext = p->varLevel[varIdx] ? CMD_NEXT_LOCAL : CMD_NEXT_GLOBAL;
+  varIdx  = p->varIndex[varIdx];
+
+  ENSURE(chrcon(p, '='), ERR_ASSIGN);
   CHECK(parseExpr(0));
-  CHECK(addCode(OP_LTEQ, 0));
-  CHECK(newCode(&cond, CMD_IF));
-  CHECK(keycon("STEP") ? parseExpr(0) : addInt(1));
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-
-  CHECK(parseBlock());
-
-  ENSURE(keycon("NEXT"), ERR_FOR_NEXT);
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-  CHECK(addCode(varGet, varIdx));
-  CHECK(addCode(OP_PLUS, 0));
-  CHECK(addCode(varSet, varIdx));
-  CHECK(addCode(CMD_GOTO, hdr));
-  cond.code.param = sys->getCodeNextIndex();
-  CHECK(sys->setCode(&cond));
-
-  idxType cnt = clrVar(level--);
-  if (cnt > 0)
-    addCode(CMD_POP, cnt - 1);
-  if (exitFor >= 0)
+  CHECK(addCode(p, varSet, varIdx));
+  ENSURE(keycon(p, "TO"), ERR_FOR_TO);
+  CHECK(parseExpr(0));  // Limit and step stay on the stack until the end
+  CHECK(keycon(p, "STEP") ? parseExpr(0) : addInt(p, 1));
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  CHECK(newCode(p, &cond, (varNext == CMD_NEXT_LOCAL) ? CMD_FOR_LOCAL
+                                                      : CMD_FOR_GLOBAL));
+  CHECK(body = p->sys->getCodeNextIndex());
+
+  CHECK(parseBlock(p));
+
+  ENSURE(keycon(p, "NEXT"), ERR_FOR_NEXT);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  CHECK(addCode2(p, varNext, body, varIdx));
+  CHECK(cond.code.param = p->sys->getCodeNextIndex());
+  cond.code.param2 = varIdx;
+  CHECK(p->sys->setCode(&cond));
+
+  // Remove limit, step and the variables of the loop
+  idxType cnt = clrVar(p, p->level--);
+  CHECK(addCode(p, CMD_POP, cnt + 1));
+  if (p->exitFor >= 0)
   {
-    CHECK(labelDst[exitFor] = sys->getCodeNextIndex());
-    exitFor = -1;
+    CHECK(p->labelDst[p->exitFor] = p->sys->getCodeNextIndex());
+    p->exitFor = -1;
   }
-  spAtBeginOfFor = oldSp;
+  p->spAtBeginOfFor = oldSp;
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static int parseRem()
+static int parseRem(sParser* p)
 {
-  while (*s != '\n')
-    readChars(1, true);
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
+  while (*p->s != '\n')
+    readChars(p, 1, true);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static int parseSub()
+static int parseSub(sParser* p)
 {
   sCodeIdx    skip;
   idxType     subIdx;
   idxType     varIdx;
-  idxType     oldSp = sp;
+  idxType     oldSp = p->sp;
   const char* name;
   int         len;
 
-  ENSURE(level == 0, ERR_NESTED_SUB);
-  curArgc = 0;
+  ENSURE(p->level == 0, ERR_NESTED_SUB);
+  p->curArgc = 0;
 
-  CHECK(len = namecon(&name));
-  ENSURE(svcIndex(name, len) < 0, ERR_SUB_CONFLICT);
-  subIdx = subIndex(name, len);
-  ENSURE(subLabel[subIdx] == -1, ERR_SUB_REDEF);
+  CHECK(len = namecon(p, &name));
+  ENSURE(svcIndex(p, name, len) < 0, ERR_SUB_CONFLICT);
+  subIdx = subIndex(p, name, len);
+  ENSURE(p->subLabel[subIdx] == -1, ERR_SUB_REDEF);
 
-  CHECK(newCode(&skip, CMD_GOTO));
+  CHECK(newCode(p, &skip, CMD_GOTO));
 
-  subLabel[subIdx] = sys->getCodeNextIndex();
-  CHECK(varIdx = addVar(name, len, 1));
+  p->subLabel[subIdx] = p->sys->getCodeNextIndex();
+  CHECK(varIdx = addVar(p, name, len, 1));
 
-  ENSURE(chrcon('('), ERR_BRACKETS_MISS);
-  if (*s != ')')
+  ENSURE(chrcon(p, '('), ERR_BRACKETS_MISS);
+  if (*p->s != ')')
     do
     {
-      CHECK(len = namecon(&name));
-      curArgc++;
-      CHECK(varIdx = addVar(name, len, 1));
-      if (chrcon('('))
+      CHECK(len = namecon(p, &name));
+      p->curArgc++;
+      CHECK(varIdx = addVar(p, name, len, 1));
+      if (chrcon(p, '('))
       {
-        varDim[varIdx] = -1;
-        ENSURE(chrcon(')'), ERR_BRACKETS_MISS);
+        p->varDim[varIdx] = -1;
+        ENSURE(chrcon(p, ')'), ERR_BRACKETS_MISS);
       }
-    } while (chrcon(','));
-  ENSURE(chrcon(')'), ERR_BRACKETS_MISS);
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-
-  for (int i = -curArgc; i <= 0; i++)
-    varIndex[varIdx + i] = i - 1;
-  subArgc[subIdx] = curArgc;
-
-  sp = 1;
-  level++;
-  CHECK(parseBlock());
-  CHECK(clrVar(level--));  // don't pop, this is done by return
-  sp = oldSp;
-
-  ENSURE(keycon("SUB"), ERR_END_SUB_EXP);
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-  CHECK(addCode(CMD_RETURN, curArgc));
-  curArgc = -1;
-
-  CHECK(skip.code.param = sys->getCodeNextIndex());
-  return sys->setCode(&skip);
+    } while (chrcon(p, ','));
+  ENSURE(chrcon(p, ')'), ERR_BRACKETS_MISS);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+
+  for (int i = -p->curArgc; i <= 0; i++)
+    p->varIndex[varIdx + i] = i - 1;
+  p->subArgc[subIdx] = p->curArgc;
+
+  p->sp = 1;
+  p->level++;
+  CHECK(parseBlock(p));
+  CHECK(clrVar(p, p->level--));  // don't pop, this is done by return
+  p->sp = oldSp;
+
+  ENSURE(keycon(p, "SUB"), ERR_END_SUB_EXP);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  CHECK(addCode(p, CMD_RETURN, p->curArgc));
+  p->curArgc = -1;
+
+  CHECK(skip.code.param = p->sys->getCodeNextIndex());
+  return p->sys->setCode(&skip);
 }
 
 //-----------------------------------------------------------------------------
-static int parseEnd()
+static int parseEnd(sParser* p)
 {
-  ENSURE(chrcon('\n'), ERR_NEWLINE);
-  return addCode(CMD_END, 0);
+  ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
+  return addCode(p, CMD_END, 0);
 }
 
 //-----------------------------------------------------------------------------
-static int parseOption()
+static int parseOption(sParser* p)
 {
-  if (keycon("EXPLICIT"))
+  if (keycon(p, "EXPLICIT"))
   {
-    if (keycon("OFF"))
-      optionExplicit = false;
-    else if (keycon("ON"))
-      optionExplicit = true;
+    if (keycon(p, "OFF"))
+      p->optionExplicit = false;
+    else if (keycon(p, "ON"))
+      p->optionExplicit = true;
     else
-      optionExplicit = true;
-    ENSURE(chrcon('\n'), ERR_NEWLINE);
+      p->optionExplicit = true;
+    ENSURE(chrcon(p, '\n'), ERR_NEWLINE);
     return 0;
   }
   return ERR_EXPR_MISSING;
 }
 
 //-----------------------------------------------------------------------------
-static int parseLabel(const char* name, int len)
+static int parseLabel(sParser* p, const char* name, int len)
 {
-  CHECK(lblIndex(name, len, sys->getCodeNextIndex()));
-  if (!chrcon('\n'))
-    return parseStmt();
+  CHECK(lblIndex(p, name, len, p->sys->getCodeNextIndex()));
+  if (!chrcon(p, '\n'))
+    return parseStmt(p);
   return 0;
 }
 
 //-----------------------------------------------------------------------------
-static int parseStmt(void)
+static int parseStmt(sParser* p)
 {
   const char* name;
   int         len;
 
-  while (chrcon('\n'))
+  while (chrcon(p, '\n'))
     ;
 
-  if (keycon("DIM"))
-    return parseDim();
-  if (keycon("PRINT"))
-    return parsePrint();
-  if (keycon("EXIT"))
-    return parseExit();
-  if (keycon("RETURN"))
-    return parseReturn();
-  if (keycon("GOTO"))
-    return parseGoto();
-  if (keycon("IF"))
-    return parseIf();
-  if (keycon("DO"))
-    return parseDo();
-  if (keycon("FOR"))
-    return parseFor();
-  if (keycon("REM"))
-    return parseRem();
-  if (keycon("SUB"))
-    return parseSub();
-  if (keycon("END"))
-    return parseEnd();
-  if (keycon("OPTION"))
-    return parseOption();
-  if (keycon("LET"))
+  if (keycon(p, "DIM"))
+    return parseDim(p);
+  if (keycon(p, "PRINT"))
+    return parsePrint(p);
+  if (keycon(p, "EXIT"))
+    return parseExit(p);
+  if (keycon(p, "RETURN"))
+    return parseReturn(p);
+  if (keycon(p, "GOTO"))
+    return parseGoto(p);
+  if (keycon(p, "IF"))
+    return parseIf(p);
+  if (keycon(p, "DO"))
+    return parseDo(p);
+  if (keycon(p, "FOR"))
+    return parseFor(p);
+  if (keycon(p, "REM"))
+    return parseRem(p);
+  if (keycon(p, "SUB"))
+    return parseSub(p);
+  if (keycon(p, "END"))
+    return parseEnd(p);
+  if (keycon(p, "OPTION"))
+    return parseOption(p);
+  if (keycon(p, "LET"))
   {
-    CHECK(len = namecon(&name));
-    if (chrcon('='))  // Variable assignment
-      return parseAssign(name, len);
-    if (chrcon('('))  // Array assignment
-      return parseArrayAssign(name, len);
+    CHECK(len = namecon(p, &name));
+    if (chrcon(p, '='))  // Variable assignment
+      return parseAssign(p, name, len);
+    if (chrcon(p, '('))  // Array assignment
+      return parseArrayAssign(p, name, len);
     return ERR_ASSIGN;
   }
 
   // Commands without keyword
-  CHECK(len = namecon(&name));
-  if (chrcon(':'))  // Label
-    return parseLabel(name, len);
-  if (chrcon('='))  // Variable assignment
-    return parseAssign(name, len);
-  if (chrcon('('))  // Array assignment
-    return parseArrayAssign(name, len);
-  return parseFunc(name, len, true);
+  CHECK(len = namecon(p, &name));
+  if (chrcon(p, ':'))  // Label
+    return parseLabel(p, name, len);
+  if (chrcon(p, '='))  // Variable assignment
+    return parseAssign(p, name, len);
+  if (chrcon(p, '('))  // Array assignment
+    return parseArrayAssign(p, name, len);
+  return parseFunc(p, name, len, true);
 }
 
 //-----------------------------------------------------------------------------
-static int parseBlock(void)
+static int parseBlock(sParser* p)
 {
-  level++;
+  p->level++;
   while (1)
   {
-    if (chrcon('\n'))
+    if (chrcon(p, '\n'))
       continue;  // Skip empty lines
 
     // clang-format off
-    if (keycon("END"))
+    if (keycon(p, "END"))
     {
-      if (keycmp("IF") ||
-          keycmp("SUB"))
+      if (keycmp(p, "IF") ||
+          keycmp(p, "SUB"))
         break;
-      CHECK(parseEnd());
+      CHECK(parseEnd(p));
       continue;
     }
-    else if (keycmp("ELSEIF") ||
-             keycmp("ELSE")   ||
-             keycmp("NEXT")   ||
-             keycmp("LOOP")   ||
-             (*s == '\0'))
+    else if (keycmp(p, "ELSEIF") ||
+             keycmp(p, "ELSE")   ||
+             keycmp(p, "NEXT")   ||
+             keycmp(p, "LOOP")   ||
+             (*p->s == '\0'))
     {
       break;
     }
     // clang-format on
 
-    CHECK(parseStmt());
+    CHECK(parseStmt(p));
   }
 
   // Exit block
-  idxType cnt = clrVar(level--);
+  idxType cnt = clrVar(p, p->level--);
   if (cnt > 0)
-    addCode(CMD_POP, cnt - 1);
+    addCode(p, CMD_POP, cnt - 1);
   return 0;
 }
 
 //=============================================================================
 // Public functions
 //=============================================================================
-int parseAll(const sSys* system, int* errline, int* errcol)
+int parse_arena(sParser* p, void* arena, int size)
 {
-  // Init variables
-  memset(varName, 0, sizeof(varName));
-  memset(labels, 0, sizeof(labels));
-  memset(subName, 0, sizeof(subName));
-  exitLabel[1]   = 0;
-  spAtBeginOfDo  = -1;
-  spAtBeginOfFor = -1;
-  exitDo         = -1;
-  exitFor        = -1;
-  optionExplicit = false;
-#if STAT
-  maxVarNum = 0;
+  // Tables of the parser in memory of the caller (PARSE_ARENA_SIZE bytes).
+  // Used by parse_*() up to parse_link(), then e.g. free for the VM stack
+  const int align = sizeof(idxType);
+
+  p->arena     = arena;
+  p->arenaSize = size;
+  p->arenaUsed = 0;
+
+  // Indices first, the names don't need alignment
+  p->varIndex = arenaAlloc(p, MAX_VAR_NUM * sizeof(idxType), align);
+  p->varLevel = arenaAlloc(p, MAX_VAR_NUM * sizeof(idxType), align);
+  p->varDim   = arenaAlloc(p, MAX_VAR_NUM * sizeof(idxType), align);
+  p->labelDst = arenaAlloc(p, MAX_LABELS * sizeof(idxType), align);
+  p->subLabel = arenaAlloc(p, MAX_SUB_NUM * sizeof(idxType), align);
+  p->subArgc  = arenaAlloc(p, MAX_SUB_NUM * sizeof(idxType), align);
+#if BASIC_LARGE
+  p->varHead = arenaAlloc(p, 2 * MAX_VAR_NUM * sizeof(idxType), align);
+  p->varNext = arenaAlloc(p, MAX_VAR_NUM * sizeof(idxType), align);
+  p->lblHead = arenaAlloc(p, 2 * MAX_LABELS * sizeof(idxType), align);
+  p->lblNext = arenaAlloc(p, MAX_LABELS * sizeof(idxType), align);
+  p->subHead = arenaAlloc(p, 2 * MAX_SUB_NUM * sizeof(idxType), align);
+  p->subNext = arenaAlloc(p, MAX_SUB_NUM * sizeof(idxType), align);
+  p->regHead = arenaAlloc(p, 2 * MAX_REG_NUM * sizeof(idxType), align);
+  p->regNext = arenaAlloc(p, MAX_REG_NUM * sizeof(idxType), align);
+  p->svcHead = arenaAlloc(p, 2 * MAX_SVC_NUM * sizeof(idxType), align);
+  p->svcNext = arenaAlloc(p, MAX_SVC_NUM * sizeof(idxType), align);
 #endif
+  p->varName = arenaAlloc(p, MAX_VAR_NUM * MAX_NAME, 1);
+  p->labels  = arenaAlloc(p, MAX_LABELS * MAX_NAME, 1);
+  p->subName = arenaAlloc(p, MAX_SUB_NUM * MAX_NAME, 1);
+  p->readBuf = arenaAlloc(p, READ_BUF_SIZE + 1, 1);
 
-  curArgc = -1;
+  ENSURE(p->arenaUsed <= size, ERR_PARSE_ARENA);
+  return 0;
+}
 
-  sp    = 0;
-  level = -1;
+//-----------------------------------------------------------------------------
+int parse_all(sParser* p, const sSys* system, int* errline, int* errcol)
+{
+  // Source from sys->getNextChar()
+  return parse_mem(p, system, NULL, 0, errline, errcol);
+}
 
-  sys     = system;
-  s       = NULL;
-  lineNum = 1;
-  lineCol = 1;
+//-----------------------------------------------------------------------------
+int parse_mem(sParser* p, const sSys* system, const char* source, int len,
+              int* errline, int* errcol)
+{
+  // Source in memory (e.g. a mapped file), NULL: from sys->getNextChar()
+  if (p->arenaUsed > p->arenaSize)  // parse_arena() failed
+  {
+    if (errline)
+      *errline = 0;
+    if (errcol)
+      *errcol = 0;
+    return ERR_PARSE_ARENA;
+  }
+
+  // Init variables
+  memset(p->varName, 0, MAX_VAR_NUM * MAX_NAME);
+  memset(p->labels, 0, MAX_LABELS * MAX_NAME);
+  memset(p->subName, 0, MAX_SUB_NUM * MAX_NAME);
+  p->varCnt         = 0;
+  p->lblCnt         = 0;
+  p->subCnt         = 0;
+  p->exitLabel[0]   = '!';
+  p->exitLabel[1]   = 0;
+  p->spAtBeginOfDo  = -1;
+  p->spAtBeginOfFor = -1;
+  p->exitDo         = -1;
+  p->exitFor        = -1;
+  p->optionExplicit = false;
+#if STAT
+  p->maxVarNum = 0;
+  p->strBytes  = 0;
+#endif
+
+  p->curArgc = -1;
+
+  p->sp    = 0;
+  p->level = -1;
+
+  p->sys     = system;
+  p->s       = NULL;
+  p->lineNum = 1;
+  p->lineCol = 1;
+  p->mem     = source;
+  p->memEnd  = source ? source + len : NULL;
+  p->quote   = false;
+  p->pos     = 0;
+  p->opPos   = -1;
+#if BASIC_LARGE
+  hashInit(p);
+#endif
 
   // Start reading
-  readChars(0, true);
+  readChars(p, 0, true);
 
   int err;
-  if (((err = parseBlock()) >= 0) &&
-      ((err = (chrcon('\0') ? 0 : ERR_EOF)) >= 0) &&
-      ((err = addCode(CMD_END, 0)) >= 0))
+  if (((err = parseBlock(p)) >= 0) &&
+      ((err = (chrcon(p, '\0') ? 0 : ERR_EOF)) >= 0) &&
+      ((err = addCode(p, CMD_END, 0)) >= 0))
     return 0;
 
   if (errline)
-    *errline = lineNum;
+    *errline = p->lineNum;
   if (errcol)
-    *errcol = lineCol;
+    *errcol = p->lineCol;
   return err;
 }
 
 //-----------------------------------------------------------------------------
-int link(const sSys* system)
+int parse_link(sParser* p, const sSys* system)
 {
   sCodeIdx code;
 
-  for (idxType idx = 0; sys->getCode(&code, idx) >= 0;
-       idx += sys->getCodeLen(code.code.op))
+  ENSURE(p->arenaUsed <= p->arenaSize, ERR_PARSE_ARENA);
+  for (idxType idx = 0; system->getCode(&code, idx) >= 0;
+       idx += system->getCodeLen(code.code.op))
   {
     switch (code.code.op)
     {
       case LNK_GOTO:
-        ENSURE(code.code.param < ARRAY_SIZE(labelDst), ERR_LABEL_INV);
-        ENSURE(labelDst[code.code.param] != (idxType)-1, ERR_LABEL_MISSING);
+        ENSURE(code.code.param < MAX_LABELS, ERR_LABEL_INV);
+        ENSURE(p->labelDst[code.code.param] != (idxType)-1, ERR_LABEL_MISSING);
         code.code.op    = CMD_GOTO;
-        code.code.param = labelDst[code.code.param];
+        code.code.param = p->labelDst[code.code.param];
         system->setCode(&code);
         break;
       case LNK_GOSUB:
-        ENSURE(code.code.param < ARRAY_SIZE(subLabel), ERR_LABEL_INV);
-        ENSURE(subLabel[code.code.param] != (idxType)-1, ERR_SUB_NOT_FOUND);
+        ENSURE(code.code.param < MAX_SUB_NUM, ERR_LABEL_INV);
+        ENSURE(p->subLabel[code.code.param] != (idxType)-1, ERR_SUB_NOT_FOUND);
         code.code.op    = CMD_GOSUB;
-        code.code.param = subLabel[code.code.param];
+        code.code.param = p->subLabel[code.code.param];
         system->setCode(&code);
         break;
     }
@@ -1356,19 +1498,29 @@ int link(const sSys* system)
 }
 
 //-----------------------------------------------------------------------------
-void parseStat(int codeSize, int strSize)
+void parse_stat(const sParser* p, int codeSize, int strSize)
 {
 #if STAT
+  int maxVarNum = p->maxVarNum;
+  int strBytes  = p->strBytes;
   int maxSubNum = 0;
   int maxLblNum = 0;
+  int arenaUsed;
 
   for (int i = 0; i < MAX_SUB_NUM; i++)
-    if (subName[i][0])
+    if (p->subName[i][0])
       maxSubNum++;
   for (int i = 0; i < MAX_LABELS; i++)
-    if (labels[i][0])
+    if (p->labels[i][0])
       maxLblNum++;
 
+  // Working memory: used entries of the tables (see parse_arena()), the
+  // hash tables of registers and SVCs and the read buffer
+  arenaUsed = maxVarNum * (3 * (int)sizeof(idxType) + HASH_BYTES + MAX_NAME) +
+              maxLblNum * ((int)sizeof(idxType) + HASH_BYTES + MAX_NAME) +
+              maxSubNum * (2 * (int)sizeof(idxType) + HASH_BYTES + MAX_NAME) +
+              (MAX_REG_NUM + MAX_SVC_NUM) * HASH_BYTES + READ_BUF_SIZE + 1;
+
   // clang-format off
   printf(BASIC_OUT_EOL);
   printf("+-----------------------------------------+" BASIC_OUT_EOL);
@@ -1377,7 +1529,38 @@ void parseStat(int codeSize, int strSize)
   printf("| Var    %5.1f%% - %4d/%4d variables     |"  BASIC_OUT_EOL, (100.0f * maxVarNum) / MAX_VAR_NUM, maxVarNum, MAX_VAR_NUM);
   printf("| Label  %5.1f%% - %4d/%4d labels        |"  BASIC_OUT_EOL, (100.0f * maxLblNum) / MAX_LABELS,  maxLblNum, MAX_LABELS);
   printf("| Str    %5.1f%% - %4d/%4d bytes         |"  BASIC_OUT_EOL, (100.0f * strSize)   / STRING_MEM,  strSize,   STRING_MEM);
+  printf("| Dedup  %5.1f%% - %4d/%4d literal bytes |"  BASIC_OUT_EOL, strBytes ? (100.0f * strSize) / strBytes : 100.0f, strSize, strBytes);
+  printf("| Arena  %5.1f%% - %4d/%4d bytes         |"  BASIC_OUT_EOL, (100.0f * arenaUsed) / p->arenaSize,    arenaUsed, p->arenaSize);
   printf("+-----------------------------------------+" BASIC_OUT_EOL);
   // clang-format on
 #endif
 }
+
+#if PARSE_STATIC
+//-----------------------------------------------------------------------------
+int parseAll(const sSys* system, int* errline, int* errcol)
+{
+  CHECK(parse_arena(&parserState, parserArena, sizeof(parserArena)));
+  return parse_all(&parserState, system, errline, errcol);
+}
+
+//-----------------------------------------------------------------------------
+int parseMem(const sSys* system, const char* source, int len, int* errline,
+             int* errcol)
+{
+  CHECK(parse_arena(&parserState, parserArena, sizeof(parserArena)));
+  return parse_mem(&parserState, system, source, len, errline, errcol);
+}
+
+//-----------------------------------------------------------------------------
+int link(const sSys* system)
+{
+  return parse_link(&parserState, system);
+}
+
+//-----------------------------------------------------------------------------
+void parseStat(int codeSize, int strSize)
+{
+  parse_stat(&parserState, codeSize, strSize);
+}
+#endif
@@ -0,0 +1,274 @@
+#include "basic_patch.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include <stddef.h>
+#include <string.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define HEADERS_SIZE (sizeof(sPatchHeader) + sizeof(sImageHeader))
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static idxType mapIdx(const sPatchSeg* segs, int num, idxType idx)
+{
+  // Index of the old section -> index in the new one, moved like the part
+  // in front of it
+  const sPatchSeg* prev = NULL;
+
+  for (int i = 0; i < num; i++)
+    if (idx >= 0 && segs[i].from <= (uint32_t)idx &&
+        (!prev || segs[i].from > prev->from))
+      prev = &segs[i];
+  return prev ? (idxType)(idx - prev->from + prev->to) : idx;
+}
+
+//-----------------------------------------------------------------------------
+static bool fill(sPatcher* p, const char** in, int* len, void* dst, int start,
+                 int size)
+{
+  // Received bytes of the part [start, start + size) of the patch, true if
+  // it's complete
+  int n = start + size - p->fill;
+
+  if (n > *len)
+    n = *len;
+  if (n > 0)
+  {
+    memcpy((char*)dst + p->fill - start, *in, n);
+    p->fill += n;
+    *in += n;
+    *len -= n;
+  }
+  return p->fill >= start + size;
+}
+
+//-----------------------------------------------------------------------------
+static bool checkSegs(const sPatchSeg* segs, int num, uint32_t oldLen,
+                      uint32_t newLen)
+{
+  // Parts inside of both sections, sorted by the new index
+  uint32_t to = 0;
+
+  for (int i = 0; i < num; i++)
+  {
+    if (segs[i].len == 0 || segs[i].len > oldLen || segs[i].len > newLen ||
+        segs[i].from > oldLen - segs[i].len ||
+        segs[i].to > newLen - segs[i].len || segs[i].to < to)
+      return false;
+    to = segs[i].to + segs[i].len;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static int output(sPatcher* p, const void* data, int len)
+{
+  ENSURE(p->write(p->ctx, data, len), ERR_PATCH_WRITE);
+  p->crc = image_crc(p->crc, data, len);
+  p->pos += len;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int start(sPatcher* p)
+{
+  // Header of the new image and the parts are complete
+  int codeSegs = p->header.codeSegs;
+
+  ENSURE(p->image.magic == IMAGE_MAGIC, ERR_PATCH_DATA);
+  ENSURE(p->image.codeLen <= CODE_MEM && p->image.strLen <= STRING_MEM,
+         ERR_PATCH_SIZE);
+  ENSURE(checkSegs(p->segs, codeSegs, p->old.codeLen, p->image.codeLen) &&
+             checkSegs(&p->segs[codeSegs], p->header.strSegs,
+                       p->old.strLen, p->image.strLen),
+         ERR_PATCH_DATA);
+  p->size = IMAGE_SIZE(p->image.codeLen, p->image.strLen);
+  return output(p, &p->image, sizeof(p->image));
+}
+
+//-----------------------------------------------------------------------------
+static bool record(sPatcher* p, const char** in, int* len)
+{
+  // Header of the next record, true if it's complete
+  uint8_t c;
+
+  do
+  {
+    if (*len == 0 || p->shift > 28)
+      return false;
+    c = *(*in)++;
+    (*len)--;
+    p->rec |= (uint32_t)(c & 0x7F) << p->shift;
+    p->shift += 7;
+  } while (c & 0x80);
+
+  p->run   = p->rec >> 1;
+  p->copy  = p->rec & 1;
+  p->rec   = 0;
+  p->shift = 0;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static int copyCode(sPatcher* p, uint32_t from, uint32_t len)
+{
+  // Instructions of the old image, jump targets and string addresses moved
+  // along
+  char  buf[sizeof(sCode)];
+  sCode code;
+  int   n;
+
+  for (uint32_t i = from; i < from + len; i += n)
+  {
+    memset(&code, 0, sizeof(code));
+    code.op = (eOp)p->old.code[i];
+    n       = image_codeLen(code.op);
+    ENSURE(n > 0 && i + n <= from + len, ERR_PATCH_DATA);
+    memcpy(&code.param, &p->old.code[i + 1], n - 1);
+    patch_reloc(p->segs, p->header.codeSegs, p->header.strSegs, &code);
+    buf[0] = (char)code.op;
+    memcpy(&buf[1], &code.param, n - 1);
+    CHECK(output(p, buf, n));
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int copy(sPatcher* p, bool strings, uint32_t idx)
+{
+  // Record copied from the part of the old section which contains idx
+  const sPatchSeg* seg = p->segs;
+  int              num = p->header.codeSegs;
+  uint32_t         len = p->run;
+
+  if (strings)
+  {
+    seg += num;
+    num = p->header.strSegs;
+  }
+  while (num > 0 && idx >= seg->to + seg->len)
+  {
+    seg++;
+    num--;
+  }
+  ENSURE(num > 0 && idx >= seg->to && len <= seg->to + seg->len - idx,
+         ERR_PATCH_DATA);
+  p->run = 0;
+  if (strings)
+    return output(p, &p->old.strings[seg->from + idx - seg->to], len);
+  return copyCode(p, seg->from + idx - seg->to, len);
+}
+
+//=============================================================================
+// Public functions
+//=============================================================================
+int patch_init(sPatcher* p, const void* old, int size, fPatchWrite write,
+               void* ctx)
+{
+  // Old image in memory (e.g. flash), the new one is written by write() as
+  // the patch is received. The old image must match its CRC, the one of the
+  // new image covers the copied parts again
+  sImageHeader header;
+  uint32_t     crc;
+
+  ENSURE(size >= (int)sizeof(header), ERR_IMAGE_SIZE);
+  memcpy(&header, old, sizeof(header));  // Data may be unaligned
+  ENSURE(header.magic == IMAGE_MAGIC, ERR_IMAGE_MAGIC);
+  ENSURE(header.codeLen <= CODE_MEM && header.strLen <= STRING_MEM &&
+             IMAGE_SIZE(header.codeLen, header.strLen) <= size,
+         ERR_IMAGE_SIZE);
+
+  memset(p, 0, sizeof(*p));
+  p->old.code    = (const char*)old + sizeof(header);
+  p->old.codeLen = header.codeLen;
+  p->old.strings = p->old.code + header.codeLen;
+  p->old.strLen  = header.strLen;
+  p->oldCrc      = header.crc;
+  p->write       = write;
+  p->ctx         = ctx;
+
+  crc = image_crc(0, &header, offsetof(sImageHeader, crc));
+  crc = image_crc(crc, p->old.code, p->old.codeLen);
+  crc = image_crc(crc, p->old.strings, p->old.strLen);
+  ENSURE(crc == header.crc, ERR_IMAGE_CRC);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int patch_feed(sPatcher* p, const void* data, int len)
+{
+  // Next bytes of the patch, any size. Returns 1 when the new image is
+  // complete and its CRC matches, 0 if more bytes are needed
+  const char* in = data;
+  uint32_t    base;
+  uint32_t    end;
+  bool        strings;
+  int         segs;
+  int         n;
+
+  if (!fill(p, &in, &len, &p->header, 0, sizeof(p->header)))
+    return 0;
+  ENSURE(p->header.magic == PATCH_MAGIC &&
+             p->header.version == PATCH_VERSION,
+         ERR_PATCH_MAGIC);
+  ENSURE(p->header.oldCrc == p->oldCrc, ERR_PATCH_BASE);
+  segs = p->header.codeSegs + p->header.strSegs;
+  ENSURE(segs <= PATCH_MAX_SEGS, ERR_PATCH_SIZE);
+  if (!fill(p, &in, &len, &p->image, sizeof(p->header), sizeof(p->image)) ||
+      !fill(p, &in, &len, p->segs, HEADERS_SIZE, segs * sizeof(sPatchSeg)))
+    return 0;
+  if (p->size == 0)
+    CHECK(start(p));
+
+  // Records of the code and the string section
+  while (p->pos < p->size)
+  {
+    base    = sizeof(sImageHeader);
+    end     = base + p->image.codeLen;
+    strings = p->pos >= end;
+    if (strings)
+    {
+      base = end;
+      end  = p->size;
+    }
+    if (p->run == 0)
+    {
+      if (!record(p, &in, &len))
+      {
+        ENSURE(p->shift <= 28, ERR_PATCH_DATA);
+        return 0;
+      }
+      ENSURE(p->run > 0 && p->run <= end - p->pos, ERR_PATCH_DATA);
+    }
+    if (p->copy)
+    {
+      CHECK(copy(p, strings, p->pos - base));
+      continue;
+    }
+    n = (p->run < (uint32_t)len) ? (int)p->run : len;
+    if (n == 0)
+      return 0;
+    CHECK(output(p, in, n));
+    p->run -= n;
+    in += n;
+    len -= n;
+  }
+  ENSURE(len == 0, ERR_PATCH_DATA);
+  ENSURE(p->crc == p->header.newCrc, ERR_PATCH_CRC);
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+void patch_reloc(const sPatchSeg* segs, int codeSegs, int strSegs,
+                 sCode* code)
+{
+  // Jump target or string address of an instruction copied from the old
+  // image -> address in the new one
+  if (image_isJump(code->op))
+    code->param = mapIdx(segs, codeSegs, code->param);
+  else if (code->op == VAL_STRING)
+    code->str.start = mapIdx(&segs[codeSegs], strSegs, code->str.start);
+}
@@ -0,0 +1,271 @@
+#include "basic_reload.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include <stdbool.h>
+#include <string.h>
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static eOp generic(eOp op)
+{
+  // Quickened instructions are rewritten while running (see exec_run())
+  switch (op)
+  {
+    case CMD_IF_NEQ_QI:
+    case CMD_IF_NEQ_QF:
+      return CMD_IF_NEQ;
+    case CMD_IF_LTEQ_QI:
+    case CMD_IF_LTEQ_QF:
+      return CMD_IF_LTEQ;
+    case CMD_IF_GTEQ_QI:
+    case CMD_IF_GTEQ_QF:
+      return CMD_IF_GTEQ;
+    case CMD_IF_LT_QI:
+    case CMD_IF_LT_QF:
+      return CMD_IF_LT;
+    case CMD_IF_GT_QI:
+    case CMD_IF_GT_QF:
+      return CMD_IF_GT;
+    case CMD_IF_EQUAL_QI:
+    case CMD_IF_EQUAL_QF:
+      return CMD_IF_EQUAL;
+    case OP_PLUS_QI:
+    case OP_PLUS_QF:
+      return OP_PLUS;
+    case OP_MINUS_QI:
+    case OP_MINUS_QF:
+      return OP_MINUS;
+    case OP_MULT_QI:
+    case OP_MULT_QF:
+      return OP_MULT;
+    default:
+      return op;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static int decode(const sImage* image, idxType idx, sCode* code)
+{
+  // Instruction at idx, returns its length
+  int len;
+
+  ENSURE(idx >= 0 && idx < image->codeLen, ERR_RELOAD_MAIN);
+  memset(code, 0, sizeof(*code));
+  code->op = (eOp)image->code[idx];
+  CHECK(len = image_codeLen(code->op));
+  ENSURE(idx + len <= image->codeLen, ERR_RELOAD_MAIN);
+  memcpy(&code->param, &image->code[idx + 1], len - 1);
+  return len;
+}
+
+//-----------------------------------------------------------------------------
+static int findSubs(const sImage* image, sReloadSubs* subs)
+{
+  // Entries of the Subs (targets of a GOSUB) in ascending order, the ends
+  // are set by walk()
+  sCode code;
+  int   len;
+  int   i;
+
+  subs->cnt = 0;
+  for (idxType idx = 0; idx < image->codeLen; idx += len)
+  {
+    CHECK(len = decode(image, idx, &code));
+    if (code.op != CMD_GOSUB)
+      continue;
+    for (i = subs->cnt; i > 0 && subs->start[i - 1] > code.param; i--)
+      ;
+    if (i > 0 && subs->start[i - 1] == code.param)
+      continue;
+    ENSURE(subs->cnt < MAX_SUB_NUM, ERR_RELOAD_MAIN);
+    memmove(&subs->start[i + 1], &subs->start[i],
+            (subs->cnt - i) * sizeof(idxType));
+    subs->start[i] = code.param;
+    subs->end[i]   = -1;
+    subs->cnt++;
+  }
+
+  // Sub starts with the GOTO over it
+  for (i = 0; i < subs->cnt; i++)
+    subs->start[i] -= image_codeLen(CMD_GOTO);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int subAt(const sReloadSubs* subs, const sCode* code, idxType idx)
+{
+  // Number of the Sub starting with code at idx, else -1
+  int lo = 0;
+  int hi = subs->cnt - 1;
+
+  if (code->op != CMD_GOTO)
+    return -1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    if (subs->start[mid] == idx)
+      return mid;
+    if (subs->start[mid] < idx)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+static idxType subEnd(const sReloadSubs* subs, int k, idxType dst)
+{
+  // Target of the GOTO over the Sub, the optimizer lets it skip the
+  // following Subs as well
+  if (k + 1 < subs->cnt && subs->start[k + 1] < dst)
+    return subs->start[k + 1];
+  return dst;
+}
+
+//-----------------------------------------------------------------------------
+static idxType mapIdx(const sReload* r, idxType idx)
+{
+  // Code index of the running program -> index in the new version. Outside
+  // of the Subs shifted by the changed sizes of the Subs in front
+  int delta = 0;
+
+  for (int k = 0; k < r->cur.cnt && idx >= r->cur.start[k]; k++)
+  {
+    if (idx < r->cur.end[k])
+      return idx - r->cur.start[k] + r->next.start[k];
+    delta += (r->next.end[k] - r->next.start[k]) -
+             (r->cur.end[k] - r->cur.start[k]);
+  }
+  return idx + delta;
+}
+
+//-----------------------------------------------------------------------------
+static bool same(const sReload* r, const sImage* cur, idxType i,
+                 const sImage* next, idxType j)
+{
+  // Same instruction in both versions, strings are compared by content
+  sCode a;
+  sCode b;
+  int   len = decode(cur, i, &a);
+
+  if (len < 0 || decode(next, j, &b) != len || generic(a.op) != generic(b.op))
+    return false;
+  if (image_isJump(a.op))
+    return mapIdx(r, a.param) == b.param && a.param2 == b.param2;
+  if (a.op == VAL_STRING)
+  {
+    return a.str.len == b.str.len &&
+           a.str.start + a.str.len <= cur->strLen &&
+           b.str.start + b.str.len <= next->strLen &&
+           memcmp(&cur->strings[a.str.start], &next->strings[b.str.start],
+                  a.str.len) == 0;
+  }
+  return memcmp(&cur->code[i + 1], &next->code[j + 1], len - 1) == 0;
+}
+
+//-----------------------------------------------------------------------------
+static int walk(sReload* r, const sImage* cur, const sImage* next,
+                bool compare)
+{
+  // Code outside of the Subs of both versions at once. First pass: ends of
+  // the Subs, second pass: same instructions
+  idxType i = 0;
+  idxType j = 0;
+  sCode   a;
+  sCode   b;
+  int     lenA;
+  int     lenB;
+  int     k;
+
+  while (i < cur->codeLen && j < next->codeLen)
+  {
+    CHECK(lenA = decode(cur, i, &a));
+    CHECK(lenB = decode(next, j, &b));
+    k = subAt(&r->cur, &a, i);
+    ENSURE(k == subAt(&r->next, &b, j), ERR_RELOAD_MAIN);
+    if (k >= 0)
+    {
+      // GOTO over the Sub is part of the code outside
+      ENSURE(!compare || mapIdx(r, a.param) == b.param, ERR_RELOAD_MAIN);
+      r->cur.end[k]  = subEnd(&r->cur, k, a.param);
+      r->next.end[k] = subEnd(&r->next, k, b.param);
+      ENSURE(r->cur.end[k] > i && r->next.end[k] > j, ERR_RELOAD_MAIN);
+      i = r->cur.end[k];
+      j = r->next.end[k];
+      continue;
+    }
+    ENSURE(!compare || same(r, cur, i, next, j), ERR_RELOAD_MAIN);
+    i += lenA;
+    j += lenB;
+  }
+  ENSURE(i == cur->codeLen && j == next->codeLen, ERR_RELOAD_MAIN);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static bool sameSub(const sReload* r, const sImage* cur, const sImage* next,
+                    int k)
+{
+  // Instructions behind the GOTO over the Sub
+  idxType i = r->cur.start[k] + image_codeLen(CMD_GOTO);
+  idxType j = r->next.start[k] + image_codeLen(CMD_GOTO);
+  int     len;
+
+  if (r->cur.end[k] - i != r->next.end[k] - j)
+    return false;
+  for (; i < r->cur.end[k]; i += len, j += len)
+  {
+    len = image_codeLen((eOp)cur->code[i]);
+    if (!same(r, cur, i, next, j))
+      return false;
+  }
+  return true;
+}
+
+//=============================================================================
+// Public functions
+//=============================================================================
+int reload_map(sReload* r, const sImage* cur, const sImage* next)
+{
+  // Checks if next can replace the running program cur: only code in Subs
+  // changed, so the globals on the stack stay valid. Returns the number of
+  // changed Subs
+  int k;
+
+  // Strings of the running program at the same positions
+  ENSURE(next->strLen >= cur->strLen &&
+             memcmp(cur->strings, next->strings, cur->strLen) == 0,
+         ERR_RELOAD_STRINGS);
+
+  CHECK(findSubs(cur, &r->cur));
+  CHECK(findSubs(next, &r->next));
+  ENSURE(r->cur.cnt == r->next.cnt, ERR_RELOAD_MAIN);
+  CHECK(walk(r, cur, next, false));
+  for (k = 0; k < r->cur.cnt; k++)
+    ENSURE(r->cur.end[k] >= 0 && r->next.end[k] >= 0, ERR_RELOAD_MAIN);
+  CHECK(walk(r, cur, next, true));
+
+  r->changed = 0;
+  for (k = 0; k < r->cur.cnt; k++)
+    if (!sameSub(r, cur, next, k))
+      r->changed++;
+  return r->changed;
+}
+
+//-----------------------------------------------------------------------------
+int reload_pc(const sReload* r, const sVm* vm, idxType* pc)
+{
+  // Safe point to swap in the new version (see reload_map()): outside of the
+  // Subs and no return address on the stack. *pc is then the index in the
+  // new version
+  if (*pc < 0)
+    return 0;  // Not running
+  for (int k = 0; k < r->cur.cnt; k++)
+    ENSURE(*pc <= r->cur.start[k] || *pc >= r->cur.end[k], ERR_RELOAD_BUSY);
+  for (int i = 0; i < vm->sp; i++)
+    ENSURE(vm->stack[i].op != VAL_LABEL, ERR_RELOAD_BUSY);
+  *pc = mapIdx(r, *pc);
+  return 0;
+}
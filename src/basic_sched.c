@@ -0,0 +1,301 @@
+#define _POSIX_C_SOURCE 200809L  // clock_gettime() with -std=c99
+
+#include "basic_sched.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include "basic_jit.h"
+
+#if SCHED
+#include <string.h>
+#include <time.h>
+
+//=============================================================================
+// Private variables
+//=============================================================================
+static __thread sSchedVm* current;  // Instance run by this thread
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static int now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+//-----------------------------------------------------------------------------
+static void wakeIdle(sSched* sched)
+{
+  pthread_mutex_lock(&sched->idleLock);
+  pthread_cond_broadcast(&sched->idle);
+  pthread_mutex_unlock(&sched->idleLock);
+}
+
+//-----------------------------------------------------------------------------
+static void waitIdle(sSched* sched)
+{
+  // Wake up at least every ms to process the timer wheel
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_nsec += 1000000;
+  if (ts.tv_nsec >= 1000000000)
+  {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  pthread_mutex_lock(&sched->idleLock);
+  if (__atomic_load_n(&sched->active, __ATOMIC_ACQUIRE) > 0)
+    pthread_cond_timedwait(&sched->idle, &sched->idleLock, &ts);
+  pthread_mutex_unlock(&sched->idleLock);
+}
+
+//-----------------------------------------------------------------------------
+static void push(sSchedWorker* w, sSchedVm* first, sSchedVm* last, int cnt)
+{
+  // Append the chain first .. last to the run queue
+  last->next = NULL;
+  pthread_mutex_lock(&w->lock);
+  if (w->tail)
+    w->tail->next = first;
+  else
+    w->head = first;
+  w->tail = last;
+  w->cnt += cnt;
+  pthread_mutex_unlock(&w->lock);
+}
+
+//-----------------------------------------------------------------------------
+static sSchedVm* pop(sSchedWorker* w)
+{
+  sSchedVm* inst;
+  pthread_mutex_lock(&w->lock);
+  inst = w->head;
+  if (inst)
+  {
+    w->head = inst->next;
+    if (!w->head)
+      w->tail = NULL;
+    w->cnt--;
+  }
+  pthread_mutex_unlock(&w->lock);
+  return inst;
+}
+
+//-----------------------------------------------------------------------------
+static sSchedVm* steal(sSched* sched, sSchedWorker* w)
+{
+  // Take half of the queue of the next busy worker, skip locked ones
+  int       idx = w - sched->workers;
+  sSchedVm* first;
+  sSchedVm* last;
+  int       cnt;
+
+  for (int i = 1; i < sched->workerCnt; i++)
+  {
+    sSchedWorker* victim = &sched->workers[(idx + i) % sched->workerCnt];
+    if (pthread_mutex_trylock(&victim->lock) != 0)
+      continue;
+    cnt = (victim->cnt + 1) / 2;
+    if (cnt == 0)
+    {
+      pthread_mutex_unlock(&victim->lock);
+      continue;
+    }
+    first = last = victim->head;
+    for (int j = 1; j < cnt; j++)
+      last = last->next;
+    victim->head = last->next;
+    if (!victim->head)
+      victim->tail = NULL;
+    victim->cnt -= cnt;
+    pthread_mutex_unlock(&victim->lock);
+
+    // Run the first one, queue the others
+    if (cnt > 1)
+      push(w, first->next, last, cnt - 1);
+    return first;
+  }
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+static void timers(sSched* sched, sSchedWorker* w)
+{
+  // Move all instances due until now to the run queue of this worker
+  int       tick  = now();
+  sSchedVm* first = NULL;
+  sSchedVm* last  = NULL;
+  int       cnt   = 0;
+  int       from;
+
+  if (tick == __atomic_load_n(&sched->tick, __ATOMIC_RELAXED) ||
+      pthread_mutex_trylock(&sched->timerLock) != 0)
+    return;
+
+  from = sched->tick + 1;
+  if (tick - from >= SCHED_WHEEL)
+    from = tick - SCHED_WHEEL + 1;
+  for (int t = from; t - tick <= 0; t++)
+  {
+    sSchedVm** link = &sched->wheel[(unsigned)t % SCHED_WHEEL];
+    while (*link)
+    {
+      sSchedVm* inst = *link;
+      if (inst->wake - tick > 0)  // Later round of the wheel
+      {
+        link = &inst->next;
+        continue;
+      }
+      *link = inst->next;
+      if (last)
+        last->next = inst;
+      else
+        first = inst;
+      last = inst;
+      cnt++;
+    }
+  }
+  __atomic_store_n(&sched->tick, tick, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&sched->timerLock);
+
+  if (cnt > 0)
+  {
+    push(w, first, last, cnt);
+    wakeIdle(sched);
+  }
+}
+
+//-----------------------------------------------------------------------------
+static void park(sSched* sched, sSchedWorker* w, sSchedVm* inst)
+{
+  inst->wake  = now() + inst->sleep;
+  inst->sleep = 0;
+  pthread_mutex_lock(&sched->timerLock);
+  if (inst->wake - sched->tick > 0)
+  {
+    sSchedVm** slot = &sched->wheel[(unsigned)inst->wake % SCHED_WHEEL];
+    inst->next      = *slot;
+    *slot           = inst;
+    inst            = NULL;
+  }
+  pthread_mutex_unlock(&sched->timerLock);
+
+  // Slot of the wake tick was already processed -> run again
+  if (inst)
+    push(w, inst, inst, 1);
+}
+
+//-----------------------------------------------------------------------------
+static void* work(void* arg)
+{
+  sSchedWorker* w     = arg;
+  sSched*       sched = w->sched;
+  sSchedVm*     inst;
+  int           res;
+
+  while (__atomic_load_n(&sched->active, __ATOMIC_ACQUIRE) > 0)
+  {
+    timers(sched, w);
+    inst = pop(w);
+    if (!inst)
+      inst = steal(sched, w);
+    if (!inst)
+    {
+      waitIdle(sched);
+      continue;
+    }
+
+    current = inst;
+    res = exec_run(&inst->vm, inst->sys, &inst->pc, SCHED_SLICE, -1);
+    current = NULL;
+
+    if (res < 0)
+    {
+      inst->res = res;
+      if (res != ERR_EXEC_END)
+        __atomic_add_fetch(&sched->failed, 1, __ATOMIC_RELAXED);
+      if (__atomic_sub_fetch(&sched->active, 1, __ATOMIC_ACQ_REL) == 0)
+        wakeIdle(sched);
+    }
+    else if (inst->sleep > 0)
+    {
+      park(sched, w, inst);
+    }
+    else
+    {
+      push(w, inst, inst, 1);
+    }
+  }
+  return NULL;
+}
+
+//=============================================================================
+// Public functions
+//=============================================================================
+int sched_init(sSched* sched, int workers)
+{
+  ENSURE(workers > 0 && workers <= SCHED_MAX_WORKERS, ERR_SCHED_WORKERS);
+  memset(sched, 0, sizeof(*sched));
+  sched->workerCnt = workers;
+  for (int i = 0; i < workers; i++)
+  {
+    sched->workers[i].sched = sched;
+    pthread_mutex_init(&sched->workers[i].lock, NULL);
+  }
+  pthread_mutex_init(&sched->idleLock, NULL);
+  pthread_cond_init(&sched->idle, NULL);
+  pthread_mutex_init(&sched->timerLock, NULL);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+void sched_add(sSched* sched, sSchedVm* inst, sSys* sys, idxType pc)
+{
+  // Before sched_run(), instances are distributed round robin
+  exec_reset(&inst->vm);
+  inst->sys   = sys;
+  inst->pc    = pc;
+  inst->res   = 0;
+  inst->sleep = 0;
+  sched->active++;
+  push(&sched->workers[sched->next++ % sched->workerCnt], inst, inst, 1);
+}
+
+//-----------------------------------------------------------------------------
+int sched_run(sSched* sched)
+{
+  // Worker 0 is the calling thread. Returns the number of instances ended
+  // by an error, the results are in sSchedVm.res
+  int started = 1;
+
+#if JIT
+  // Only one worker at a time could use it, the others would interpret
+  jit_enable(sched->workerCnt == 1);
+#endif
+  sched->tick = now();
+  for (int i = 1; i < sched->workerCnt; i++)
+  {
+    // Without a thread, the instances are stolen by the other workers
+    if (pthread_create(&sched->workers[i].thread, NULL, work,
+                       &sched->workers[i]) != 0)
+      break;
+    started++;
+  }
+  work(&sched->workers[0]);
+  for (int i = 1; i < started; i++)
+    pthread_join(sched->workers[i].thread, NULL);
+#if JIT
+  jit_enable(true);
+#endif
+  return sched->failed;
+}
+
+//-----------------------------------------------------------------------------
+void sched_sleep(int ms)
+{
+  // Called by a SVC (e.g. Sleep), which then returns 1 to yield
+  if (current)
+    current->sleep = (ms > 0) ? ms : 1;
+}
+#endif
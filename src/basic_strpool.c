@@ -0,0 +1,99 @@
+#include "basic_strpool.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include "basic_parser.h"
+#include <string.h>
+
+//=============================================================================
+// Private functions
+//=============================================================================
+#if BASIC_LARGE
+static int bucket(const char* str, int len)
+{
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < len; i++)
+    hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+  return hash % STRPOOL_BUCKETS;
+}
+
+//-----------------------------------------------------------------------------
+static void indexBytes(sStrPool* pool, int from, int to)
+{
+  // Adds the positions whose first g bytes end in [from, to)
+  for (int g = 1; g <= STRPOOL_GRAM; g++)
+  {
+    idxType* head = pool->head[g - 1];
+    idxType* tail = pool->tail[g - 1];
+    idxType* next = pool->next[g - 1];
+
+    for (int pos = (from >= g) ? from - g + 1 : 0; pos + g <= to; pos++)
+    {
+      int b     = bucket(&pool->mem[pos], g);
+      next[pos] = -1;
+      if (tail[b] < 0)
+        head[b] = pos;
+      else
+        next[tail[b]] = pos;
+      tail[b] = pos;
+    }
+  }
+}
+#endif
+
+//=============================================================================
+// Public functions
+//=============================================================================
+void strpool_init(sStrPool* pool, char* mem, int size)
+{
+  pool->mem  = mem;
+  pool->size = size;
+  pool->len  = 0;
+#if BASIC_LARGE
+  memset(pool->head, 0xFF, sizeof(pool->head));
+  memset(pool->tail, 0xFF, sizeof(pool->tail));
+#endif
+}
+
+//-----------------------------------------------------------------------------
+int strpool_add(sStrPool* pool, const char* str, int len)
+{
+  // Start of the first occurrence of str, else of the first end of the pool
+  // which is a prefix of str (only the rest is appended)
+  int last = pool->len - len;  // Last start of an occurrence
+  int pos;
+
+#if BASIC_LARGE
+  int g = (len < STRPOOL_GRAM) ? len : STRPOOL_GRAM;
+  pos   = (g > 0) ? pool->head[g - 1][bucket(str, g)] : 0;
+  for (; pos >= 0 && pos <= last; pos = pool->next[g - 1][pos])
+#else
+  for (pos = 0; pos <= last; pos++)
+#endif
+  {
+    if (memcmp(&pool->mem[pos], str, len) == 0)
+      return pos;
+  }
+
+  pos = (last >= 0) ? last + 1 : 0;
+  while (memcmp(&pool->mem[pos], str, pool->len - pos) != 0)
+    pos++;
+  ENSURE(pos + len <= pool->size, ERR_STR_MEM);
+  memcpy(&pool->mem[pool->len], &str[pool->len - pos], pos + len - pool->len);
+#if BASIC_LARGE
+  indexBytes(pool, pool->len, pos + len);
+#endif
+  pool->len = pos + len;
+  return pos;
+}
+
+//-----------------------------------------------------------------------------
+void strpool_reuse(sStrPool* pool, int len)
+{
+  // The first len bytes of mem are strings already (e.g. of the running
+  // program, see reload_map()), they keep their positions
+  pool->len = len;
+#if BASIC_LARGE
+  indexBytes(pool, 0, len);
+#endif
+}
@@ -0,0 +1,524 @@
+#include "basic_transpile.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define AOT_MAX_FUNCS (MAX_SUB_NUM + 1)  // Main program and subs
+
+// Flags of a code index
+#define F_INSTR 0x01  // Start of an instruction
+#define F_FUNC  0x02  // Entry of a function (main program or GOSUB target)
+#define F_REACH 0x04  // Reachable from the entry of the current function
+#define F_LABEL 0x08  // Jump target in the current function
+
+//=============================================================================
+// Private variables
+//=============================================================================
+static const sSys* sys;
+static FILE*       out;
+static uint8_t     flags[CODE_MEM + 1];  // +1: end of the code
+static idxType     work[CODE_MEM + 1];   // Instructions to follow
+static idxType     funcs[AOT_MAX_FUNCS];
+static int         funcCnt;
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static void emit(const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(out, fmt, args);
+  va_end(args);
+}
+
+//-----------------------------------------------------------------------------
+static int jumpTarget(const sCode* code)
+{
+  // Code index of a jump within the function (-1: no jump)
+  switch (code->op)
+  {
+    case CMD_IF:
+    case CMD_GOTO:
+    case CMD_FOR_GLOBAL:
+    case CMD_FOR_LOCAL:
+    case CMD_NEXT_GLOBAL:
+    case CMD_NEXT_LOCAL:
+      return code->param;
+    default:
+      if (code->op >= CMD_IF_NEQ && code->op <= CMD_IF_EQUAL_QF)
+        return code->param;
+      if (code->op >= CMD_IF_NEQ_SS && code->op <= CMD_IF_EQUAL_SK)
+        return code->param;
+      return -1;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static bool fallsThrough(eOp op)
+{
+  switch (op)
+  {
+    case CMD_GOTO:
+    case CMD_RETURN:
+    case CMD_END:
+    case CMD_INVALID:
+    case LNK_GOTO:
+    case LNK_GOSUB:
+    case VAL_LABEL:
+      return false;
+    default:
+      return true;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static const char* compareStr(eOp op)
+{
+  // All compare instructions list the operators in the same order
+  static const char* const str[] = {"!=", "<=", ">=", "<", ">", "=="};
+
+  if (op >= CMD_IF_NEQ && op <= CMD_IF_EQUAL)
+    return str[op - CMD_IF_NEQ];
+  if (op >= CMD_IF_NEQ_II && op <= CMD_IF_EQUAL_II)
+    return str[op - CMD_IF_NEQ_II];
+  if (op >= CMD_IF_NEQ_QI && op <= CMD_IF_EQUAL_QF)
+    return str[(op - CMD_IF_NEQ_QI) / 2];
+  if (op >= CMD_IF_NEQ_SS && op <= CMD_IF_EQUAL_SK)
+    return str[(op - CMD_IF_NEQ_SS) / 2];
+  if (op >= OP_NEQ && op <= OP_EQUAL)
+    return str[op - OP_NEQ];
+  if (op >= OP_NEQ_II && op <= OP_EQUAL_II)
+    return str[op - OP_NEQ_II];
+  return "?";
+}
+
+//-----------------------------------------------------------------------------
+static const char* arithStr(eOp op)
+{
+  switch (op)
+  {
+    case OP_PLUS:
+    case OP_PLUS_II:
+    case OP_PLUS_QI:
+    case OP_PLUS_QF:
+    case OP_PLUS_SS:
+    case OP_PLUS_SK:
+      return "+";
+    case OP_MINUS:
+    case OP_MINUS_II:
+    case OP_MINUS_QI:
+    case OP_MINUS_QF:
+    case OP_MINUS_SS:
+    case OP_MINUS_SK:
+      return "-";
+    case OP_MULT:
+    case OP_MULT_II:
+    case OP_MULT_QI:
+    case OP_MULT_QF:
+    case OP_MULT_SS:
+    case OP_MULT_SK:
+      return "*";
+    case OP_XOR:
+      return "^";
+    case OP_OR:
+      return "|";
+    case OP_AND:
+      return "&";
+    case OP_SHL:
+      return "<<";
+    case OP_SHR:
+      return ">>";
+    case OP_MOD:
+      return "%";
+    default:
+      return "?";
+  }
+}
+
+//-----------------------------------------------------------------------------
+static int readCode(sCodeIdx* code, idxType idx, int len, idxType* next)
+{
+  int size;
+  CHECK(sys->getCode(code, idx));
+  size = sys->getCodeLen(code->code.op);
+  ENSURE(size > 0, ERR_AOT_CMD);
+  *next = idx + size;
+  ENSURE(*next <= len, ERR_AOT_CMD);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int scan(int len)
+{
+  // Mark the instructions and check all targets
+  sCodeIdx code;
+  idxType  next;
+  int      dst;
+
+  memset(flags, 0, sizeof(flags));
+  for (idxType idx = 0; idx < len; idx = next)
+  {
+    CHECK(readCode(&code, idx, len, &next));
+    flags[idx] |= F_INSTR;
+  }
+  flags[len] |= F_INSTR;  // Code after the end is invalid (see emitInstr())
+
+  for (idxType idx = 0; idx < len; idx = next)
+  {
+    CHECK(readCode(&code, idx, len, &next));
+    dst = (code.code.op == CMD_GOSUB) ? code.code.param
+                                      : jumpTarget(&code.code);
+    if (code.code.op == CMD_GOSUB || dst >= 0)
+      ENSURE(dst >= 0 && dst <= len && (flags[dst] & F_INSTR), ERR_AOT_JUMP);
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int reach(idxType entry, int len)
+{
+  // Marks the instructions of the function (F_REACH) and its jump targets
+  // (F_LABEL), subs called by the function are added to funcs[]
+  sCodeIdx code;
+  idxType  next;
+  int      cnt = 0;
+  int      dst;
+
+  for (int i = 0; i <= len; i++)
+    flags[i] &= ~(F_REACH | F_LABEL);
+
+  flags[entry] |= F_REACH;
+  work[cnt++] = entry;
+  while (cnt > 0)
+  {
+    idxType idx = work[--cnt];
+    if (idx >= len)
+      continue;
+    CHECK(readCode(&code, idx, len, &next));
+
+    if (code.code.op == CMD_GOSUB && !(flags[code.code.param] & F_FUNC))
+    {
+      ENSURE(funcCnt < AOT_MAX_FUNCS, ERR_AOT_LIMIT);
+      flags[code.code.param] |= F_FUNC;
+      funcs[funcCnt++] = code.code.param;
+    }
+    if ((dst = jumpTarget(&code.code)) >= 0)
+    {
+      flags[dst] |= F_LABEL;
+      if (!(flags[dst] & F_REACH))
+      {
+        flags[dst] |= F_REACH;
+        work[cnt++] = dst;
+      }
+    }
+    if (fallsThrough(code.code.op) && !(flags[next] & F_REACH))
+    {
+      flags[next] |= F_REACH;
+      work[cnt++] = next;
+    }
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static void emitFloat(fType value)
+{
+  if (isnan(value))
+    emit("NAN");
+  else if (isinf(value))
+    emit(value < 0 ? "-INFINITY" : "INFINITY");
+  else
+    emit("%af", value);  // Hex float, exact
+}
+
+//-----------------------------------------------------------------------------
+static void emitInstr(const sCode* code, idxType next)
+{
+  const char* cmp = compareStr(code->op);
+  const char* op  = arithStr(code->op);
+  char        var[16];  // Variable: absolute or fp relative
+
+  switch (code->op)
+  {
+    case CMD_LET_LOCAL:
+    case CMD_GET_LOCAL:
+    case CMD_INC_LOCAL:
+    case CMD_LETI_LOCAL:
+      snprintf(var, sizeof(var), "fp %c %d", code->param < 0 ? '-' : '+',
+               abs(code->param));
+      break;
+    case CMD_FOR_LOCAL:
+    case CMD_NEXT_LOCAL:
+      snprintf(var, sizeof(var), "fp %c %d", code->param2 < 0 ? '-' : '+',
+               abs(code->param2));
+      break;
+    case CMD_FOR_GLOBAL:
+    case CMD_NEXT_GLOBAL:
+      snprintf(var, sizeof(var), "%d", code->param2);
+      break;
+    default:
+      snprintf(var, sizeof(var), "%d", code->param);
+      break;
+  }
+
+  // clang-format off
+  switch (code->op)
+  {
+    case CMD_PRINT:       emit("CHECK(print(%d));", code->param); break;
+    case CMD_LET_GLOBAL:
+    case CMD_LET_LOCAL:   emit("CHECK(letVar(%s, %d));", var, code->param2);
+                          break;
+    case CMD_LET_PTR:     emit("CHECK(letPtr(%d));", code->param); break;
+    case CMD_LET_REG:     emit("CHECK(setReg(%d));", code->param); break;
+    case CMD_IF:          emit("IF(L%d);", code->param); break;
+    case CMD_GOTO:        emit("goto L%d;", code->param); break;
+    case CMD_GOSUB:       emit("GOSUB(sub%d, %d);", code->param, next); break;
+    case CMD_RETURN:      emit("return returnSub(%d);", code->param); break;
+    case CMD_POP:         emit("ENSURE_STACK(%d); sp -= %d;", code->param + 1,
+                               code->param + 1);
+                          break;
+    case CMD_NOP:         emit(";"); break;
+    case CMD_END:         emit("return ERR_EXEC_END;"); break;
+    case CMD_SVC:         emit("SVC(%d);", code->param); break;
+    case CMD_GET_GLOBAL:
+    case CMD_GET_LOCAL:   emit("CHECK(getVar(%s, %d));", var, code->param2);
+                          break;
+    case CMD_GET_PTR:     emit("CHECK(getPtr(%d));", code->param); break;
+    case CMD_GET_REG:     emit("CHECK(getReg(%d));", code->param); break;
+    case CMD_CREATE_PTR:  emit("CHECK(createPtr(%d, %d));", code->param,
+                               code->param2);
+                          break;
+    case CMD_INC_GLOBAL:
+    case CMD_INC_LOCAL:   emit("CHECK(incVar(%s, %d));", var, code->param2);
+                          break;
+    case CMD_LETI_GLOBAL:
+    case CMD_LETI_LOCAL:  emit("CHECK(letInt(%s, %d));", var, code->param2);
+                          break;
+    case CMD_FOR_GLOBAL:
+    case CMD_FOR_LOCAL:   emit("FOR(%s, L%d);", var, code->param);
+                          break;
+    case CMD_NEXT_GLOBAL:
+    case CMD_NEXT_LOCAL:  emit("NEXT(%s, L%d);", var, code->param);
+                          break;
+
+    // Quickened instructions behave like the generic ones
+    case CMD_IF_NEQ:    case CMD_IF_NEQ_QI:   case CMD_IF_NEQ_QF:
+    case CMD_IF_LTEQ:   case CMD_IF_LTEQ_QI:  case CMD_IF_LTEQ_QF:
+    case CMD_IF_GTEQ:   case CMD_IF_GTEQ_QI:  case CMD_IF_GTEQ_QF:
+    case CMD_IF_LT:     case CMD_IF_LT_QI:    case CMD_IF_LT_QF:
+    case CMD_IF_GT:     case CMD_IF_GT_QI:    case CMD_IF_GT_QF:
+    case CMD_IF_EQUAL:  case CMD_IF_EQUAL_QI: case CMD_IF_EQUAL_QF:
+      emit("IF_CMP(%s, L%d);", cmp, code->param);
+      break;
+    case CMD_IF_NEQ_II: case CMD_IF_LTEQ_II:  case CMD_IF_GTEQ_II:
+    case CMD_IF_LT_II:  case CMD_IF_GT_II:    case CMD_IF_EQUAL_II:
+      emit("IF_CMP_II(%s, L%d);", cmp, code->param);
+      break;
+    case CMD_MOVE:
+      emit("CHECK(move(%d, %d, %d));", SLOT_DST(code->param),
+           SLOT_NEED(code->param), SLOT_A(code->param2));
+      break;
+    case CMD_IF_NEQ_SS: case CMD_IF_LTEQ_SS:  case CMD_IF_GTEQ_SS:
+    case CMD_IF_LT_SS:  case CMD_IF_GT_SS:    case CMD_IF_EQUAL_SS:
+      emit("SLOT_IF(slot(%d), slot(%d), %s, L%d);", SLOT_A(code->param2),
+           SLOT_B(code->param2), cmp, code->param);
+      break;
+    case CMD_IF_NEQ_SK: case CMD_IF_LTEQ_SK:  case CMD_IF_GTEQ_SK:
+    case CMD_IF_LT_SK:  case CMD_IF_GT_SK:    case CMD_IF_EQUAL_SK:
+      emit("SLOT_IF(slot(%d), KONST(%d), %s, L%d);", SLOT_A(code->param2),
+           SLOT_B(code->param2), cmp, code->param);
+      break;
+
+    case OP_NEQ:  case OP_LTEQ:  case OP_GTEQ:
+    case OP_LT:   case OP_GT:    case OP_EQUAL:
+      emit("OP_CMP(%s);", cmp);
+      break;
+    case OP_XOR:  case OP_OR:    case OP_AND:
+    case OP_SHL:  case OP_SHR:   case OP_MOD:
+      emit("OP_INT(%s);", op);
+      break;
+    case OP_PLUS:  case OP_PLUS_QI:  case OP_PLUS_QF:
+    case OP_MINUS: case OP_MINUS_QI: case OP_MINUS_QF:
+    case OP_MULT:  case OP_MULT_QI:  case OP_MULT_QF:
+      emit("OP_ARITH(%s);", op);
+      break;
+    case OP_NOT:  emit("CHECK(opNot());");  break;
+    case OP_DIV:  emit("CHECK(opDiv());");  break;
+    case OP_IDIV: emit("CHECK(opIdiv());"); break;
+    case OP_POW:  emit("CHECK(opPow());");  break;
+    case OP_SIGN: emit("CHECK(opSign());"); break;
+
+    // Both operands are known to be integers (see optimizer)
+    case OP_NEQ_II: case OP_LTEQ_II: case OP_GTEQ_II:
+    case OP_LT_II:  case OP_GT_II:   case OP_EQUAL_II:
+      emit("OP_CMP_II(%s);", cmp);
+      break;
+    case OP_PLUS_II: case OP_MINUS_II: case OP_MULT_II:
+      emit("OP_II(%s);", op);
+      break;
+
+    case OP_PLUS_SS: case OP_MINUS_SS: case OP_MULT_SS:
+      emit("SLOT_ARITH(%d, %d, slot(%d), slot(%d), %s);",
+           SLOT_DST(code->param), SLOT_NEED(code->param), SLOT_A(code->param2),
+           SLOT_B(code->param2), op);
+      break;
+    case OP_PLUS_SK: case OP_MINUS_SK: case OP_MULT_SK:
+      emit("SLOT_ARITH(%d, %d, slot(%d), KONST(%d), %s);",
+           SLOT_DST(code->param), SLOT_NEED(code->param), SLOT_A(code->param2),
+           SLOT_B(code->param2), op);
+      break;
+
+    case VAL_ZERO:
+      emit("CHECK(pushInt(0));");
+      break;
+    case VAL_INTEGER:
+      if (code->iValue == INT32_MIN)
+        emit("CHECK(pushInt(INT32_MIN));");
+      else
+        emit("CHECK(pushInt(%d));", code->iValue);
+      break;
+    case VAL_FLOAT:
+      emit("CHECK(pushFloat(");
+      emitFloat(code->fValue);
+      emit("));");
+      break;
+    case VAL_STRING:
+      emit("CHECK(pushCode(&(sCode){.op = VAL_STRING, .str = {%d, %d}}));",
+           code->str.start, code->str.len);
+      break;
+    case VAL_PTR:
+      emit("CHECK(pushCode(&(sCode){.op = VAL_PTR, .param = %d, "
+           ".param2 = %d}));", code->param, code->param2);
+      break;
+    default:
+      emit("return ERR_EXEC_CMD_INV;");
+      break;
+  }
+  // clang-format on
+}
+
+//-----------------------------------------------------------------------------
+static int emitFunc(idxType entry, int len)
+{
+  sCodeIdx code;
+  idxType  next;
+
+  CHECK(reach(entry, len));
+  emit("\n//---------------------------------------------------------------"
+       "--------------\n");
+  emit("static int sub%d(void)\n{\n", entry);
+
+  // Instructions are emitted in code order, jump to the entry if it isn't
+  // the first one
+  for (idxType idx = 0; idx < entry; idx++)
+    if (flags[idx] & F_REACH)
+    {
+      flags[entry] |= F_LABEL;
+      emit("  goto L%d;\n", entry);
+      break;
+    }
+
+  for (idxType idx = 0; idx <= len; idx = next)
+  {
+    if ((flags[idx] & F_REACH) && (flags[idx] & F_LABEL))
+      emit("L%d:\n", idx);
+    if (idx == len)  // Code memory behind the program is zero
+    {
+      if (flags[idx] & F_REACH)
+        emit("  return ERR_EXEC_CMD_INV;\n");
+      break;
+    }
+    CHECK(readCode(&code, idx, len, &next));
+    if (flags[idx] & F_REACH)
+    {
+      emit("  ");
+      emitInstr(&code.code, next);
+      emit("\n");
+    }
+  }
+  emit("}\n");
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int emitStrings(int len)
+{
+  // String literals of the program as C string (end of the used pool)
+  sCodeIdx    code;
+  idxType     next;
+  const char* str;
+  int         end = 0;
+
+  for (idxType idx = 0; idx < len; idx = next)
+  {
+    CHECK(readCode(&code, idx, len, &next));
+    if (code.code.op == VAL_STRING &&
+        code.code.str.start + code.code.str.len > end)
+      end = code.code.str.start + code.code.str.len;
+  }
+
+  emit("static const char strings[] =\n  \"");
+  if (end > 0)
+  {
+    CHECK(sys->getString(&str, 0, end));
+    for (int i = 0; i < end; i++)
+    {
+      if (str[i] >= ' ' && str[i] < 0x7F && !strchr("\"\\?", str[i]))
+        emit("%c", str[i]);
+      else
+        emit("\\%03o", (uint8_t)str[i]);
+      if (i % 64 == 63 && i + 1 < end)
+        emit("\"\n  \"");
+    }
+  }
+  emit("\";\n");
+  return 0;
+}
+
+//=============================================================================
+// Public functions
+//=============================================================================
+int transpile(const sSys* system, int len, const char* name, FILE* file)
+{
+  // Writes the program as C code, which runs like the interpreter does. Each
+  // sub becomes a function, GOSUB a call and jumps within a sub goto.
+  sys     = system;
+  out     = file;
+  funcCnt = 0;
+  ENSURE(len >= 0 && len <= CODE_MEM, ERR_AOT_CMD);
+  CHECK(scan(len));
+
+  // Find all subs called by reachable code
+  flags[0] |= F_FUNC;
+  funcs[funcCnt++] = 0;
+  for (int i = 0; i < funcCnt; i++)
+    CHECK(reach(funcs[i], len));
+
+  emit("// Generated from BASIC bytecode by transpile(), don't edit\n");
+  emit("#include \"basic_aot.h\"\n\n");
+  CHECK(emitStrings(len));
+  emit("\n");
+  for (int i = 0; i < funcCnt; i++)
+    emit("static int sub%d(void);\n", funcs[i]);
+  for (int i = 0; i < funcCnt; i++)
+    CHECK(emitFunc(funcs[i], len));
+
+  emit("\n//---------------------------------------------------------------"
+       "--------------\n");
+  emit("int %s(sSys* system, int (*cb)(void))\n{\n", name);
+  emit("  begin(system, cb, strings, sizeof(strings) - 1);\n");
+  emit("  CHECK(sub0());\n");
+  emit("  return ERR_EXEC_PC;  // RETURN without GOSUB\n}\n");
+
+  fflush(out);
+  return ferror(out) ? ERR_AOT_WRITE : 0;
+}
@@ -0,0 +1,83 @@
+#!/bin/sh
+# Benchmarks (Linux), best of 5 runs each
+#   parse   parse_mem() and parse_link() of a source, MB/s (tests/parse_bench.c)
+#   interp  run time of a program in the interpreter [ms] (EXEC_JIT 0)
+#   jit     same with the JIT (default configuration)
+#   aot     same transpiled to C (DEMO_TRANSPILE)
+#   sched   interpreter instructions per second of 64 instances of (one run)
+#           tests/bench/arith.bas by scheduler workers (tests/sched_bench.c)
+#
+#   tests/bench.sh
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+CC=${CC:-gcc}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Copy of demo/basic_config.h with other values: config <dir> [NAME value]..
+config()
+{
+  dir=$TMP/$1
+  shift
+  mkdir -p "$dir"
+  cp "$ROOT/demo/basic_config.h" "$dir/"
+  while [ $# -gt 1 ]; do
+    sed -i "s/^\(#define $1  *\)[^ ]*/\1$2/" "$dir/basic_config.h"
+    shift 2
+  done
+}
+
+# Build with a configuration: build <name> <main> <output> [cflags]..
+build()
+{
+  name=$1
+  main=$2
+  out=$3
+  shift 3
+  $CC -O2 -w "$@" -I"$ROOT/inc" -I"$TMP/$name" -I"$ROOT/demo" \
+      "$ROOT"/src/*.c "$main" -o "$out" -lm -pthread
+}
+
+# Best run time of a host [ms]: best <host> <program>
+best()
+{
+  rm -rf "$TMP/run"
+  mkdir -p "$TMP/run"
+  cp "$2" "$TMP/run/demo\\test.bas"
+  for i in 1 2 3 4 5; do
+    (cd "$TMP/run" && "$1" 2>&1 > /dev/null)
+  done | sort -n | head -1
+}
+
+config interp EXEC_JIT 0
+config jit
+config aot    EXEC_JIT 0
+build interp "$ROOT/tests/parse_bench.c" "$TMP/parse" || exit 1
+build interp "$ROOT/tests/host.c" "$TMP/interp/host" -DHOST_BENCH=1 || exit 1
+build jit "$ROOT/tests/host.c" "$TMP/jit/host" -DHOST_BENCH=1 || exit 1
+build aot "$ROOT/tests/host.c" "$TMP/aot/host" -DDEMO_TRANSPILE=1 || exit 1
+build interp "$ROOT/tests/sched_bench.c" "$TMP/sched" || exit 1
+
+for f in "$ROOT/demo/bench.bas" "$ROOT/tests/prog/t3.bas" \
+         "$ROOT/tests/prog/t8.bas"; do
+  for i in 1 2 3 4 5; do
+    "$TMP/parse" "$f" 2000 | sed 's/.*: //'
+  done | sort -rn | head -1 | sed "s|^|parse  $(basename "$f") |"
+done
+
+for f in "$ROOT/demo/bench.bas" "$ROOT"/tests/bench/*.bas; do
+  n=$(basename "$f")
+  echo "interp $n $(best "$TMP/interp/host" "$f")"
+  echo "jit    $n $(best "$TMP/jit/host" "$f")"
+  (cd "$TMP/run" && "$TMP/aot/host" > /dev/null)
+  if build aot "$ROOT/tests/host.c" "$TMP/aot/prog" -DHOST_AOT=1 \
+           -DHOST_BENCH=1 "$TMP/run/demo\\test_aot.c"; then
+    echo "aot    $n $(best "$TMP/aot/prog" "$f")"
+  fi
+done
+
+rm -rf "$TMP/run"
+mkdir -p "$TMP/run"
+cp "$ROOT/tests/bench/arith.bas" "$TMP/run/demo\\test.bas"
+echo "sched  $(nproc) cores"
+(cd "$TMP/run" && "$TMP/sched" 64 1 2 4 8 16 2>&1 > /dev/null) |
+  sed 's/^\([0-9]*\) /sched  \1 workers /'
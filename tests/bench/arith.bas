@@ -0,0 +1,16 @@
+' Benchmark: integer and float arithmetic on scalar variables
+Dim a = 0
+Dim b = 1
+Dim c = 0
+Dim f = 0.5
+For i = 1 To 30000
+  c = a * 3 + b * 5 - i
+  a = b + c - a * 2
+  b = i - a + c * 7 - 4
+  If a > b Then a = a - b
+  If c < 0 Then c = 0 - c
+  f = f * 0.5 + i
+  a = a - (a \ 1000) * 1000
+  b = b - (b \ 1000) * 1000
+Next
+Print a; " "; b; " "; c; " "; f
@@ -0,0 +1,17 @@
+' Sub with a hot integer loop
+Sub Work(n)
+  Dim s = 0
+  Dim t = 1
+  For i = 1 To n
+    s = s + i * 3 - t
+    t = t + 1
+    If s > 100000 Then s = s - 100000
+  Next
+  Work = s
+End Sub
+r = 0
+For k = 1 To 400
+  r = r + Work(5000)
+  If r > 1000000 Then r = r - 1000000
+Next
+Print r
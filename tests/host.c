@@ -0,0 +1,94 @@
+// Linux host of the demo for the tests (see tests/run.sh, tests/bench.sh)
+//
+// Includes demo/basic.c, which loads demo\test.bas of the working directory.
+//   HOST_AOT 1:   Runs the transpiled program (demo\test_aot.c, BasicAot())
+//                 instead of the interpreter
+//   HOST_BENCH 1: Runs without waiting between the slices and writes the run
+//                 time to stderr (programs without Sleep)
+#include "basic.c"
+#include <time.h>
+
+#ifndef HOST_AOT
+#define HOST_AOT 0
+#endif
+#ifndef HOST_BENCH
+#define HOST_BENCH 0
+#endif
+
+//=============================================================================
+// Functions
+//=============================================================================
+int sysTickMs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//-----------------------------------------------------------------------------
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+#if HOST_AOT
+//-----------------------------------------------------------------------------
+int BasicAot(sSys* sys, int (*yield)(void));
+
+//-----------------------------------------------------------------------------
+static int aotYield(void)
+{
+  // Sleep of the program, same as the slices of BasicTask()
+  int start = sysTickMs();
+
+  while (sysTickMs() - start < sleepMs)
+    ;
+  sleepMs = 0;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static void run(void)
+{
+  int res = BasicAot(&sys, aotYield);
+
+  if (res == ERR_EXEC_END)
+    printf("BASIC: done" BASIC_OUT_EOL);
+  else if (res < 0)
+    printf("BASIC: Runtime error %d" BASIC_OUT_EOL, res);
+}
+#else
+//-----------------------------------------------------------------------------
+static void run(void)
+{
+  const int interval = HOST_BENCH ? 0 : 10;
+  int       lastCall = sysTickMs();
+
+  while (BasicTask(interval))
+  {
+    while (sysTickMs() - lastCall < interval)
+      ;
+    lastCall = sysTickMs();
+  }
+}
+#endif
+
+//=============================================================================
+// Main
+//=============================================================================
+int main(void)
+{
+  double start;
+
+  BasicInit();
+  printf("=[ Exec ]====================================================\r\n");
+  start = now();
+  run();
+  if (HOST_BENCH)
+    fprintf(stderr, "%.1f ms\n", now() - start);
+  return 0;
+}
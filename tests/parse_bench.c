@@ -0,0 +1,69 @@
+// Parser throughput: parse_mem() and parse_link() of a source in memory,
+// without listing (see tests/bench.sh)
+//   parse_bench <file.bas> <runs>
+#include "basic.c"
+#include <stdlib.h>
+#include <time.h>
+
+//=============================================================================
+// Functions
+//=============================================================================
+int sysTickMs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//-----------------------------------------------------------------------------
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+int main(int argc, char* argv[])
+{
+  static char source[1 << 20];
+  static char arena[PARSE_ARENA_SIZE];
+  sParser     parser;
+  FILE*       f = (argc == 3) ? fopen(argv[1], "rb") : NULL;
+  int         runs, len, line, col, err;
+  double      start, ms;
+
+  if (!f)
+  {
+    fprintf(stderr, "usage: parse_bench <file.bas> <runs>\n");
+    return 1;
+  }
+  len = fread(source, 1, sizeof(source), f);
+  fclose(f);
+  runs = atoi(argv[2]);
+
+  sys.setCode = setCode;
+  sys.echo    = NULL;  // No listing
+  start       = now();
+  for (int i = 0; i < runs; i++)
+  {
+    codeLen = 0;
+    strLen  = 0;
+    strpool_init(&pool, strings, sizeof(strings));
+    parse_arena(&parser, arena, sizeof(arena));
+    if ((err = parse_mem(&parser, &sys, source, len, &line, &col)) < 0 ||
+        (err = parse_link(&parser, &sys)) < 0)
+    {
+      fprintf(stderr, "%s: ERROR %d in Line %d, Col %d: %s\n", argv[1], err,
+              line, col, errmsg(err));
+      return 1;
+    }
+  }
+  ms = now() - start;
+  printf("%s: %.1f MB/s\n", argv[1], len * (double)runs / 1e3 / ms);
+  return 0;
+}
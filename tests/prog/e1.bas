@@ -0,0 +1,5 @@
+' idiv by zero
+a = 7
+b = 0
+Print a \ 2; " "; a Mod 4
+Print a \ b
@@ -0,0 +1,9 @@
+' recursion overflows the stack
+Sub Rec1(n)
+  Rec1 = Rec2(n + 1)
+End Sub
+Sub Rec2(n)
+  Print n; " ";
+  Rec2 = Rec1(n + 1)
+End Sub
+Print Rec1(0)
@@ -0,0 +1,6 @@
+' array write out of bound
+Dim a(3)
+For i = 0 To 5
+  a(i) = i * 1.5
+  Print a(i); " ";
+Next
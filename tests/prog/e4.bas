@@ -0,0 +1,14 @@
+' register write without setter, float compare, strings
+x = 0.1
+y = 3
+If x < y Then Print "lt"
+If y <> 3 Then
+  Print "ne"
+Else
+  Print "eq"
+End If
+Print "tick"; ($TICK >= 0)
+$LED = 1
+Print $LED
+$TICK = 5
+Print "never"
@@ -0,0 +1,7 @@
+' floats, pow, sign, shifts, iif
+a = 2.5
+b = -a
+Print b; " "; 2 ^ 0.5; " "; -(3 ^ 2); " "; 7 / 2; " "; 1 Shl 31
+Print Iif(a > 1, "big", "small"); " "; Iif(0, 1, 2)
+c = 1e38
+Print c * 10
@@ -0,0 +1,28 @@
+' arithmetic and types
+a = 5
+b = 2.5
+Print a + b; " "; a - b; " "; a * b; " "; a / 2; " "; a \ 2; " "; a Mod 3; " "; 2 ^ 10
+Print -a; " "; -b; " "; Not 0; " "; 6 And 3; " "; 6 Or 3; " "; 6 Xor 3; " "; 1 Shl 4; " "; 256 Shr 2
+Print a < b; a <= b; a > b; a >= b; a = 5; a <> 5
+c = a
+c = c + 1
+c = c - 3
+c = c * 2
+Print c
+x = 1.5
+x = x + 1
+Print x
+s = 0
+For i = 1 To 100
+  s = s + i
+Next
+Print "sum="; s
+s = 0
+For i = 10 To 1 Step -1
+  s = s + i
+Next
+Print "neg="; s
+For f = 0 To 1 Step 0.25
+  Print f; " ";
+Next
+Print ""
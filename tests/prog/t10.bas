@@ -0,0 +1,51 @@
+' jit: hot subs with loops, locals, globals, floats and recursion
+Dim g = 0
+Dim f = 0.5
+Sub Acc(n)
+  Dim s = 0
+  For i = 1 To n
+    s = s + i * 3 - 1
+    If s > 1000 Then s = s - 1000
+  Next
+  g = g + 1
+  Acc = s
+End Sub
+Sub Down(n)
+  Dim c = 0
+  For i = n To 1 Step -2
+    c = c + i
+  Next
+  Down = c
+End Sub
+Sub Mixed(a, b)
+  Dim t = a
+  t = t * b + 1
+  If t <> 7 Then t = t - 1
+  If (a And 1) = 1 Then t = t Or 16
+  Mixed = t + f
+End Sub
+Sub Rec2(n)
+  Rec2 = Rec(n)
+End Sub
+Sub Rec(n)
+  If n < 2 Then
+    Return 1
+  End If
+  Rec = Rec2(n - 1) + Rec2(n - 2)
+End Sub
+Sub Cmp(a, b)
+  Cmp = (a < b) + (a = b) * 2 + (Not a)
+End Sub
+Dim r = 0
+For k = 1 To 40
+  r = r + Acc(k * 5) + Down(k)
+  r = r - Mixed(k, 3)
+  f = f + 0.25
+Next
+Print r; " "; g; " "; f
+Print Rec(4); " "; Cmp(1, 2); " "; Cmp(3, 3); " "; Cmp(1.5, 2)
+q = 2147483647
+For k = 1 To 20
+  q = Acc(3)
+Next
+Print q; " "; -Down(9)
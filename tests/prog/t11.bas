@@ -0,0 +1,9 @@
+' jit: runtime error inside a hot sub
+Dim a(4)
+Sub Get(i)
+  Dim x = i * 2
+  Get = a(x)
+End Sub
+For k = 0 To 20
+  Print Get(k); " ";
+Next
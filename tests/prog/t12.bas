@@ -0,0 +1,10 @@
+' jit: division by zero after many calls
+Sub D(i)
+  Dim x = 10 - i
+  D = 100 \ x
+End Sub
+s = 0
+For k = 0 To 20
+  s = s + D(k)
+  Print s; " ";
+Next
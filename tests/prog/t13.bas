@@ -0,0 +1,7 @@
+' slots: stack overflow of the replaced stack code (run with OPT_SLOTS 0 too)
+Dim big(26)
+Sub S(a, b)
+  a = a + b * 2
+  S = a
+End Sub
+Print S(1, 2)
@@ -0,0 +1,35 @@
+' subs, recursion, arrays
+Sub Fib2(n)
+  Fib2 = Fib(n)
+End Sub
+
+Sub Fib(n)
+  If n < 2 Then
+    Return n
+  End If
+  Fib = Fib2(n - 1) + Fib2(n - 2)
+End Sub
+
+Sub Fill(arr(), n)
+  For i = 0 To n - 1
+    arr(i) = i * i
+  Next
+End Sub
+
+Sub Sum(arr(), n)
+  Dim t = 0
+  For i = 0 To n - 1
+    t = t + arr(i)
+  Next
+  Sum = t
+End Sub
+
+Print Fib(4)
+Dim q(8)
+Fill q, 8
+Print Sum(q, 8)
+Print q(3); " "; q(7)
+Dim g = 3
+g = g + 4
+Print g
+Print Iif(g > 5, "big", "small")
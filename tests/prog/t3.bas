@@ -0,0 +1,50 @@
+' control flow
+i = 0
+Do
+  i = i + 1
+  If i = 3 Then
+    Print "three"
+  ElseIf i = 5 Then
+    Exit Do
+  Else
+    Print i
+  End If
+Loop
+Print "after do "; i
+j = 0
+Do While j < 4
+  j = j + 1
+Loop
+Print j
+Do
+  j = j - 1
+Loop Until j <= 0
+Print j
+For k = 0 To 10
+  If k * 2 > 8 Then Exit For
+  Print k * 2;
+Next
+Print ""
+n = 0
+top:
+n = n + 1
+If n < 4 Then GoTo top
+Print "n="; n
+For a = 1 To 3
+  For b = 1 To 3
+    Print a * b; " ";
+  Next
+Next
+Print ""
+$led = -1
+Print $led
+$led = 0
+Print $led
+Sub Cnt(x)
+  Do
+    x = x - 1
+    If x < 2 Then Exit Sub
+  Loop
+End Sub
+Cnt 5
+Print "end"
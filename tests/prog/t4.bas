@@ -0,0 +1,6 @@
+' runtime error
+a = 1
+b = 0
+Print a \ 1
+Print a / b
+Print "never"
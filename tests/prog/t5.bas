@@ -0,0 +1,11 @@
+' loop heavy
+Dim cnt = 0
+Dim x = 0
+For i = 1 To 2000
+  For j = 1 To 50
+    cnt = cnt + 1
+    x = i * j + cnt - 3
+    If x > 100000 Then cnt = cnt - 1
+  Next
+Next
+Print cnt; " "; x
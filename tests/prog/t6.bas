@@ -0,0 +1,4 @@
+' end statement
+Print 1
+End
+Print 2
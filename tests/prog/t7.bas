@@ -0,0 +1,5 @@
+' sleep and yield
+t = $tick
+Sleep 0.05
+d = $tick - t
+Print Iif(d >= 40, "slept", "no sleep")
@@ -0,0 +1,35 @@
+' type inference: vars changing type, subs writing globals
+Dim g = 1
+Dim h = 2
+Sub SetF(v)
+  g = v / 2
+End Sub
+Sub SetI(v)
+  h = v
+End Sub
+x = 1
+For i = 1 To 4
+  Print x + 1; " "; x * 2; " "; x < 2; " "
+  If x > 1 Then
+    x = 0.5
+  Else
+    x = x + 1
+  End If
+Next
+Print ""
+Print g + 1; " "; g < 2
+SetF 3
+Print g + 1; " "; g < 2; " "; g * 2
+SetI 4
+Print h + 1; " "; h - 1
+SetI 1.5
+Print h + 1; " "; h * 3
+y = 2147483647
+y = y + 1
+Print y
+z = 7
+Do While z > 0
+  z = z - 2
+  If z = 3 Then z = z + 0.25
+Loop
+Print z
@@ -0,0 +1,16 @@
+' quickening: same instruction sees alternating types
+Dim v = 1
+Dim w = 0
+For k = 1 To 6
+  If k Mod 2 = 0 Then
+    v = 1.5
+  Else
+    v = k
+  End If
+  w = w + v * 2
+  If v < 2 Then Print "<";
+  If v = 1.5 Then Print "f";
+  If v <> 3 Then Print "n";
+  Print v - 1; " "; w; " ";
+Next
+Print ""
@@ -0,0 +1,109 @@
+#!/bin/sh
+# Differential test of the interpreter, the JIT and the transpiler (Linux)
+#
+# Every program in tests/prog is run by the demo (tests/host.c) in several
+# builds, the output must be the same as in tests/prog/<name>.txt:
+#   interp    interpreter (EXEC_JIT 0)
+#   jit       JIT, every called sub is compiled (EXEC_JIT_CALLS 1)
+#   switch    switch dispatch                  (without instruction count)
+#   cache     quickened in the decode cache    (without instruction count)
+#   noslots   stack code only (OPT_SLOTS 0)    (without instruction count)
+#   aot       transpiled to C (DEMO_TRANSPILE) (without instruction count)
+#
+#   tests/run.sh [-u]   -u: write the output of interp as expected output
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+CC=${CC:-gcc}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+failed=0
+
+# Copy of demo/basic_config.h with other values: config <dir> [NAME value]..
+config()
+{
+  dir=$TMP/$1
+  shift
+  mkdir -p "$dir"
+  cp "$ROOT/demo/basic_config.h" "$dir/"
+  while [ $# -gt 1 ]; do
+    sed -i "s/^\(#define $1  *\)[^ ]*/\1$2/" "$dir/basic_config.h"
+    shift 2
+  done
+}
+
+# Demo host with a configuration: build <name> [cflags]..
+build()
+{
+  name=$1
+  shift
+  $CC -O2 -w "$@" -I"$ROOT/inc" -I"$TMP/$name" -I"$ROOT/demo" \
+      "$ROOT"/src/*.c "$ROOT/tests/host.c" -o "$TMP/$name/host" -lm -pthread
+}
+
+# Output of a host after the load: run <host> <program> <dir>
+run()
+{
+  rm -rf "$3"
+  mkdir -p "$3"
+  cp "$2" "$3/demo\\test.bas"
+  (cd "$3" && timeout 20 "$1" > out.txt 2>&1)
+  sed -n '/=\[ Exec \]/,$p' "$3/out.txt"
+}
+
+# Compare with the expected output: check <variant> <program> <output>
+check()
+{
+  if cmp -s "$3" "$4"; then
+    echo "ok   $1 $2"
+  else
+    echo "FAIL $1 $2"
+    diff "$4" "$3" | head -10
+    failed=$((failed + 1))
+  fi
+}
+
+config interp  EXEC_JIT 0
+config jit     EXEC_JIT 1 EXEC_JIT_CALLS 1
+config switch  EXEC_JIT 0 EXEC_THREADED 0 EXEC_QUICKEN 0
+config cache   EXEC_JIT 0 EXEC_DECODE_CACHE CODE_MEM EXEC_QUICKEN 1
+config noslots EXEC_JIT 0 OPT_SLOTS 0
+config aot     EXEC_JIT 0
+for v in interp jit switch cache noslots; do
+  build $v || exit 1
+done
+build aot -DDEMO_TRANSPILE=1 || exit 1
+
+for f in "$ROOT"/tests/prog/*.bas; do
+  n=$(basename "$f" .bas)
+  exp=${f%.bas}.txt
+  if [ "$1" = "-u" ]; then
+    run "$TMP/interp/host" "$f" "$TMP/run" > "$exp"
+    echo "updated $n"
+    continue
+  fi
+  grep -v 'instructions executed' "$exp" > "$TMP/exp.txt"
+  for v in interp jit; do
+    run "$TMP/$v/host" "$f" "$TMP/run" > "$TMP/out.txt"
+    check $v $n "$TMP/out.txt" "$exp"
+  done
+  for v in switch cache noslots; do
+    run "$TMP/$v/host" "$f" "$TMP/run" | grep -v 'instructions executed' \
+      > "$TMP/out.txt"
+    check $v $n "$TMP/out.txt" "$TMP/exp.txt"
+  done
+
+  # Transpile with the demo, compile and run the C code
+  run "$TMP/aot/host" "$f" "$TMP/run" > /dev/null
+  if [ -f "$TMP/run/demo\\test_aot.c" ] &&
+     cp "$TMP/run/demo\\test_aot.c" "$TMP/aot/aot.c" &&
+     $CC -O2 -w -DHOST_AOT=1 -I"$ROOT/inc" -I"$TMP/aot" -I"$ROOT/demo" \
+         "$ROOT"/src/*.c "$ROOT/tests/host.c" "$TMP/aot/aot.c" \
+         -o "$TMP/aot/prog" -lm -pthread; then
+    run "$TMP/aot/prog" "$f" "$TMP/run" > "$TMP/out.txt"
+  else
+    echo "no C code" > "$TMP/out.txt"
+  fi
+  check aot $n "$TMP/out.txt" "$TMP/exp.txt"
+done
+
+[ "$1" = "-u" ] || echo "$failed failed"
+[ $failed -eq 0 ]
@@ -0,0 +1,71 @@
+// Throughput of the scheduler by number of workers (see tests/bench.sh)
+//   sched_bench <instances> <workers>...
+//
+// Runs <instances> copies of demo\test.bas of the working directory for each
+// number of workers and writes the executed instructions per second to
+// stderr. Built with EXEC_JIT 0, so all worker counts run the interpreter.
+#include "basic.c"
+#include "basic_sched.h"
+#include <stdlib.h>
+#include <time.h>
+
+//=============================================================================
+// Private variables
+//=============================================================================
+static sSched sched;
+
+//=============================================================================
+// Functions
+//=============================================================================
+int sysTickMs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//-----------------------------------------------------------------------------
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+int main(int argc, char* argv[])
+{
+  int       cnt  = (argc > 2) ? atoi(argv[1]) : 0;
+  sSchedVm* inst = (cnt > 0) ? calloc(cnt, sizeof(sSchedVm)) : NULL;
+
+  if (!inst)
+  {
+    fprintf(stderr, "usage: sched_bench <instances> <workers>...\n");
+    return 1;
+  }
+  BasicInit();
+  for (int a = 2; a < argc; a++)
+  {
+    int      workers = atoi(argv[a]);
+    uint64_t instr   = 0;
+    double   start, ms;
+
+    if (sched_init(&sched, workers) < 0)
+      return 1;
+    for (int i = 0; i < cnt; i++)
+      sched_add(&sched, &inst[i], &sys, 0);
+    start = now();
+    if (sched_run(&sched) != 0)
+      return 1;
+    ms = now() - start;
+    for (int i = 0; i < cnt; i++)
+      instr += inst[i].vm.dispatchCnt;
+    fprintf(stderr, "%d %.1f ms %.1f Minstr/s\n", workers, ms,
+            instr / ms / 1e3);
+  }
+  return 0;
+}
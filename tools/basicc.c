@@ -0,0 +1,513 @@
+// Offline compiler: BASIC source -> bytecode image (see basic_image.h)
+//
+// Build it for the configuration of the target, e.g.
+//   gcc -Iinc -I<dir of basic_config.h> src/basic_parser.c
+//       src/basic_optimizer.c src/basic_debug.c src/basic_image.c
+//       src/basic_strpool.c tools/basicc.c -o basicc -pthread
+//
+// Registers and buildin functions are read from a bindings file, one per
+// line in the order of sSys.regs / sSys.svcs of the target:
+//   $TICK r      register, r: readable, w: writable
+//   $LED rw
+//   Iif 3        buildin function, number of arguments
+//   Sleep 1
+#include "basic_bytecode.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include "basic_debug.h"
+#include "basic_exec.h"
+#include "basic_image.h"
+#include "basic_optimizer.h"
+#include "basic_parser.h"
+#include "basic_strpool.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define MAX_JOBS 64  // Max number of threads
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// Compilation of one source at a time, one per thread
+typedef struct
+{
+#if BASIC_LARGE
+  char*      codeMem;  // Grow up to CODE_MEM / STRING_MEM (see reserve())
+  char*      strings;
+  int        codeSize;
+  int        strSize;
+#else
+  char       codeMem[CODE_MEM];
+  char       strings[STRING_MEM];
+#endif
+  idxType    codeLen;
+  idxType    strLen;
+  FILE*      file;
+  char       error[200];  // Last error (see fail())
+  sStrPool   pool;        // Dedup of strings (same as the demo)
+  sParser    parser;
+  char       arena[PARSE_ARENA_SIZE];  // Tables of the parser
+  sOptimizer optimizer;
+} sJob;
+
+//=============================================================================
+// Private variables
+//=============================================================================
+static __thread sJob* job;  // Compilation of this thread
+
+// Names of registers and buildin functions (see readBindings())
+static char names[MAX_REG_NUM + MAX_SVC_NUM][MAX_NAME + 1];
+
+// Sources, shared by the threads (see worker())
+static const char** sources;
+static int          sourceCnt;
+static int          nextSource = 0;
+static int          failed     = 0;
+static const char*  output;  // File (one source) or directory
+static const char*  array;   // Name of the array (C header), else NULL
+
+//=============================================================================
+// Private system functions
+//=============================================================================
+#if BASIC_LARGE
+static bool reserve(char** mem, int* size, int need, int max)
+{
+  // Code and strings of the large profile are allocated as the program
+  // grows, the limits are only checked against max
+  int   newSize = *size ? *size : 4096;
+  char* buf;
+
+  if (need > max)
+    need = max;
+  if (need <= *size)
+    return true;
+  while (newSize < need)
+    newSize *= 2;
+  if (newSize > max)
+    newSize = max;
+  if (!(buf = realloc(*mem, newSize)))
+    return false;
+  *mem  = buf;
+  *size = newSize;
+  return true;
+}
+#define RESERVE_CODE(n) reserve(&job->codeMem, &job->codeSize, (n), CODE_MEM)
+#define RESERVE_STR(n)  reserve(&job->strings, &job->strSize, (n), STRING_MEM)
+#define STR_SIZE        job->strSize
+#else
+#define RESERVE_CODE(n) true
+#define RESERVE_STR(n)  true
+#define STR_SIZE        (int)sizeof(job->strings)
+#endif
+
+//-----------------------------------------------------------------------------
+static char getNextChar(void)
+{
+  int c = fgetc(job->file);
+  return (c == EOF) ? '\0' : c;
+}
+
+//-----------------------------------------------------------------------------
+static int addCode(const sCode* code)
+{
+  int idx = job->codeLen;
+  int len = image_codeLen(code->op);
+
+  ENSURE(len > 0 && idx + len <= CODE_MEM, ERR_MEM_CODE);
+  ENSURE(RESERVE_CODE(idx + len), ERR_MEM_CODE);
+  job->codeMem[idx] = code->op;
+  if (len > 1)
+    memcpy(&job->codeMem[idx + 1], &code->param, len - 1);
+  job->codeLen += len;
+  return idx;
+}
+
+//-----------------------------------------------------------------------------
+static int setCode(const sCodeIdx* code)
+{
+  int len = image_codeLen(code->code.op);
+
+  ENSURE(code->idx >= 0 && code->idx + len <= CODE_MEM, ERR_MEM_CODE);
+  ENSURE(RESERVE_CODE(code->idx + len), ERR_MEM_CODE);
+  job->codeMem[code->idx] = code->code.op;
+  if (len > 1)
+    memcpy(&job->codeMem[code->idx + 1], &code->code.param, len - 1);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+static int newCode(sCodeIdx* code, eOp op)
+{
+  code->code.op = op;
+  code->idx     = addCode(&code->code);
+  return code->idx;
+}
+
+//-----------------------------------------------------------------------------
+static int getCode(sCodeIdx* code, int idx)
+{
+  ENSURE(idx >= 0 && idx < CODE_MEM, ERR_MEM_CODE);
+  code->idx     = idx;
+  code->code.op = (idx < job->codeLen) ? (eOp)job->codeMem[idx] : CMD_INVALID;
+  int len       = image_codeLen(code->code.op);
+  if (len > 1)
+    memcpy(&code->code.param, &job->codeMem[idx + 1], len - 1);
+  return idx;
+}
+
+//-----------------------------------------------------------------------------
+static int getCodeNextIndex(void)
+{
+  return job->codeLen;
+}
+
+//-----------------------------------------------------------------------------
+static int setString(const char* str, unsigned int len)
+{
+  int start;
+
+  // Strings of the large profile may have moved (see reserve())
+  ENSURE(RESERVE_STR(job->pool.len + (int)len), ERR_STR_MEM);
+  job->pool.mem  = job->strings;
+  job->pool.size = STR_SIZE;
+  start          = strpool_add(&job->pool, str, len);
+  job->strLen    = job->pool.len;
+  return start;
+}
+
+//-----------------------------------------------------------------------------
+static int getString(const char** str, int start, unsigned int len)
+{
+  ENSURE(start + len <= (unsigned int)job->strLen, ERR_STR_MEM);
+  *str = &job->strings[start];
+  return len;
+}
+
+//-----------------------------------------------------------------------------
+// Access functions are only checked for existence by the verifier
+static int getStub(sCode* code, int cookie)
+{
+  (void)code;
+  (void)cookie;
+  return ERR_EXEC_REG_READ;
+}
+
+static int setStub(sCode* code, int cookie)
+{
+  (void)code;
+  (void)cookie;
+  return ERR_EXEC_REG_WRITE;
+}
+
+static int svcStub(sCode* args, sCode* mem)
+{
+  (void)args;
+  (void)mem;
+  return ERR_EXEC_SVC_INV;
+}
+
+//=============================================================================
+// System
+//=============================================================================
+// clang-format off
+static sSys sys =
+{
+  .getNextChar      = getNextChar,
+  .addCode          = addCode,
+  .newCode          = newCode,
+  .getCode          = getCode,
+  .setCode          = setCode,
+  .getCodeNextIndex = getCodeNextIndex,
+  .getCodeLen       = image_codeLen,
+  .getString        = getString,
+  .setString        = setString,
+};
+// clang-format on
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static bool fail(const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  vsnprintf(job->error, sizeof(job->error), format, args);
+  va_end(args);
+  printf("%s" BASIC_OUT_EOL, job->error);
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+static bool readBindings(const char* filename)
+{
+  FILE* f = fopen(filename, "r");
+  char  line[80];
+  char  name[40];
+  char  mode[8];
+  int   regs   = 0;
+  int   svcs   = 0;
+  int   lineNo = 0;
+  bool  ok     = true;
+  int   cnt;
+
+  if (!f)
+    return fail("Can't open %s", filename);
+  while (ok && fgets(line, sizeof(line), f))
+  {
+    lineNo++;
+    cnt = sscanf(line, "%39s %7s", name, mode);
+    if (cnt <= 0 || name[0] == '#')
+      continue;
+    ok = (cnt == 2 && strlen(name) <= MAX_NAME);
+    if (ok && name[0] == '$' && regs < MAX_REG_NUM)
+    {
+      strcpy(names[regs + svcs], name);
+      sys.regs[regs].name   = names[regs + svcs];
+      sys.regs[regs].getter = strchr(mode, 'r') ? getStub : NULL;
+      sys.regs[regs].setter = strchr(mode, 'w') ? setStub : NULL;
+      regs++;
+    }
+    else if (ok && name[0] != '$' && svcs < MAX_SVC_NUM)
+    {
+      strcpy(names[regs + svcs], name);
+      sys.svcs[svcs].name = names[regs + svcs];
+      sys.svcs[svcs].func = svcStub;
+      sys.svcs[svcs].argc = atoi(mode);
+      svcs++;
+    }
+    else
+    {
+      ok = false;
+    }
+  }
+  fclose(f);
+  return ok || fail("%s:%d: Invalid binding", filename, lineNo);
+}
+
+//-----------------------------------------------------------------------------
+static bool compile(const char* filename)
+{
+  int line, col, err;
+
+  job->file = fopen(filename, "r");
+  if (!job->file)
+    return fail("Can't open %s", filename);
+  job->codeLen = 0;
+  job->strLen  = 0;
+  strpool_init(&job->pool, job->strings, STR_SIZE);
+  parse_arena(&job->parser, job->arena, sizeof(job->arena));
+  err = parse_all(&job->parser, &sys, &line, &col);
+  fclose(job->file);
+  if (err < 0)
+    return fail("%s:%d:%d: ERROR %d: %s", filename, line, col, err,
+                errmsg(err));
+  if ((err = parse_link(&job->parser, &sys)) < 0)
+    return fail("%s: LINK ERROR %d: %s", filename, err, errmsg(err));
+  if ((err = optimize_code(&job->optimizer, &sys)) < 0)
+    return fail("%s: Optimizer ERROR %d: %s", filename, err, errmsg(err));
+  job->codeLen = err;  // Optimized code can be shorter
+  if ((err = optimize_verify(&job->optimizer, &sys, job->codeLen)) < 0)
+  {
+    // Same as the target: only an interpreter with stack checks runs it
+    if (!EXEC_CHECK_STACK)
+      return fail("%s: Verify ERROR %d: %s", filename, err, errmsg(err));
+    printf("%s: Verify WARNING %d: %s" BASIC_OUT_EOL, filename, err,
+           errmsg(err));
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static void writeError(const char* filename)
+{
+  // A header which stops the build of the firmware with the error, even if
+  // the exit code of basicc is ignored
+  FILE* f = fopen(filename, "w");
+
+  if (!f)
+    return;
+  fprintf(f, "// Bytecode image, generated by basicc" BASIC_OUT_EOL);
+  fprintf(f, "#error \"");
+  for (const char* c = job->error; *c; c++)
+    fprintf(f, (*c == '"' || *c == '\\') ? "\\%c" : "%c", *c);
+  fprintf(f, "\"" BASIC_OUT_EOL);
+  fclose(f);
+}
+
+//-----------------------------------------------------------------------------
+static bool writeImage(const char* filename)
+{
+  // Binary image or C header with the image as const array (flash)
+  sImage       image = {job->codeMem, job->codeLen, job->strings, job->strLen};
+  sImageHeader header;
+  FILE*        f;
+  int          size;
+  bool         ok = true;
+
+  if ((size = image_header(&sys, &image, &header)) < 0)
+  {
+    printf("Image ERROR %d: %s" BASIC_OUT_EOL, size, errmsg(size));
+    return false;
+  }
+  f = fopen(filename, array ? "w" : "wb");
+  if (!f)
+  {
+    printf("Can't write %s" BASIC_OUT_EOL, filename);
+    return false;
+  }
+  if (!array)
+  {
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+         fwrite(image.code, 1, image.codeLen, f) == (size_t)image.codeLen &&
+         fwrite(image.strings, 1, image.strLen, f) == (size_t)image.strLen;
+  }
+  else
+  {
+    const uint8_t* parts[] = {(const uint8_t*)&header,
+                              (const uint8_t*)image.code,
+                              (const uint8_t*)image.strings};
+    const int      lens[]  = {sizeof(header), image.codeLen, image.strLen};
+    int            pos     = 0;
+
+    fprintf(f, "// Bytecode image, generated by basicc" BASIC_OUT_EOL);
+    fprintf(f, "#pragma once" BASIC_OUT_EOL BASIC_OUT_EOL);
+    fprintf(f, "static const int %sLen = %d;" BASIC_OUT_EOL, array, size);
+    fprintf(f, "static const unsigned char %s[%d] =" BASIC_OUT_EOL "{", array,
+            size);
+    for (int i = 0; i < (int)ARRAY_SIZE(parts); i++)
+    {
+      for (int j = 0; j < lens[i]; j++, pos++)
+      {
+        fprintf(f, "%s0x%02X,", (pos % 12) ? " " : BASIC_OUT_EOL "  ",
+                parts[i][j]);
+      }
+    }
+    fprintf(f, BASIC_OUT_EOL "};" BASIC_OUT_EOL);
+  }
+  return (fclose(f) == 0) && ok;
+}
+
+//-----------------------------------------------------------------------------
+static bool build(const char* source, bool list)
+{
+  // One source -> output, several sources -> <output>/<name>.bin (or .h)
+  char        filename[FILENAME_MAX];
+  const char* name = strrchr(source, '/');
+  const char* ext  = strrchr(source, '.');
+
+  name = name ? name + 1 : source;
+  if (!ext || ext < name)
+    ext = name + strlen(name);
+  if (sourceCnt == 1)
+    snprintf(filename, sizeof(filename), "%s", output);
+  else
+    snprintf(filename, sizeof(filename), "%s/%.*s%s", output,
+             (int)(ext - name), name, array ? ".h" : ".bin");
+
+  if (!compile(source))
+  {
+    if (array)
+      writeError(filename);
+    return false;
+  }
+  if (list)
+  {
+    debugPrintRaw(&sys);
+    parse_stat(&job->parser, job->codeLen, job->strLen);
+  }
+  return writeImage(filename);
+}
+
+//-----------------------------------------------------------------------------
+static void* worker(void* arg)
+{
+  // Takes the next source until all are done
+  int i;
+
+  job = arg;
+  while ((i = __atomic_fetch_add(&nextSource, 1, __ATOMIC_RELAXED)) <
+         sourceCnt)
+  {
+    if (!build(sources[i], false))
+      __atomic_fetch_add(&failed, 1, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+int main(int argc, char* argv[])
+{
+  pthread_t   threads[MAX_JOBS];
+  sJob*       jobs;
+  const char* bindings = NULL;
+  int         jobCnt   = 1;
+  bool        list     = false;
+
+  sources = calloc(argc, sizeof(*sources));
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      bindings = argv[++i];
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      output = argv[++i];
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      array = argv[++i];
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      jobCnt = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-l"))
+      list = true;
+    else if (argv[i][0] != '-' && sources)
+      sources[sourceCnt++] = argv[i];
+    else
+    {
+      sourceCnt = 0;  // Invalid argument -> usage
+      break;
+    }
+  }
+  if (sourceCnt == 0 || !output || jobCnt < 1 || jobCnt > MAX_JOBS ||
+      (list && sourceCnt > 1))
+  {
+    printf("usage: basicc [-b bindings] [-c array] [-l] [-j jobs] -o output"
+           " sources..." BASIC_OUT_EOL);
+    printf("  -b bindings  Registers and buildin functions of the target"
+           BASIC_OUT_EOL);
+    printf("  -c array     Write a C header with the image as const array"
+           BASIC_OUT_EOL);
+    printf("  -l           List bytecode and statistics (one source)"
+           BASIC_OUT_EOL);
+    printf("  -j jobs      Compile the sources with that many threads"
+           BASIC_OUT_EOL);
+    printf("  -o output    Image (one source) or directory of the images"
+           BASIC_OUT_EOL);
+    return 2;
+  }
+
+  if (jobCnt > sourceCnt)
+    jobCnt = sourceCnt;
+  jobs = calloc(jobCnt, sizeof(sJob));
+  if (!jobs)
+    return 1;
+  job = &jobs[0];
+  if (bindings && !readBindings(bindings))
+    return 1;
+  if (sourceCnt == 1)
+    return build(sources[0], list) ? 0 : 1;
+
+  // The main thread works as well
+  for (int i = 1; i < jobCnt; i++)
+    if (pthread_create(&threads[i], NULL, worker, &jobs[i]) != 0)
+      jobCnt = i;
+  worker(&jobs[0]);
+  for (int i = 1; i < jobCnt; i++)
+    pthread_join(threads[i], NULL);
+  return failed ? 1 : 0;
+}
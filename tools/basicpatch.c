@@ -0,0 +1,681 @@
+// Patch generator: old image + new image -> patch (see basic_patch.h)
+//
+// Build it for the configuration of the target, e.g.
+//   gcc -Iinc -I<dir of basic_config.h> src/basic_image.c src/basic_patch.c
+//       tools/basicpatch.c -o basicpatch
+//
+// Parts of the new image are matched with the old one. Code is compared
+// instruction by instruction without jump targets and string addresses, so
+// code behind a change still matches although its addresses are shifted.
+// The records of the patch copy what's the same in a part (patch_reloc()
+// moves the addresses along) and hold the other bytes.
+#include "basic_bytecode.h"
+#include "basic_common.h"
+#include "basic_config.h"
+#include "basic_image.h"
+#include "basic_patch.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//=============================================================================
+// Defines
+//=============================================================================
+#define MAX_SIZE   IMAGE_SIZE(CODE_MEM, STRING_MEM)
+#define MAX_SEGS   (CODE_MEM + STRING_MEM)
+#define CODE_GRAM  3   // Instructions of a match in another place
+#define STR_GRAM   4   // Bytes of a match in another place
+#define HASH_BITS  12  // Buckets of the search for matches (2^n)
+#define MIN_COPY   2   // Shorter copies are sent as bytes
+#define FEED_CHUNK 61  // Bytes per patch_feed() of the self check
+
+#define FNV_OFFSET 0x811C9DC5u
+#define FNV_PRIME  0x01000193u
+
+//=============================================================================
+// Typedefs
+//=============================================================================
+// Image read from a file
+typedef struct
+{
+  char         data[MAX_SIZE];
+  int          size;
+  sImageHeader header;
+  sImage       image;
+  int          ops[CODE_MEM + 1];  // Instruction indices, codeLen at the end
+  int          opNum;
+  uint32_t     keys[CODE_MEM];     // Instructions without addresses
+  bool         start[CODE_MEM];    // An instruction starts here
+} sFile;
+
+//-----------------------------------------------------------------------------
+// Parts of one section
+typedef struct
+{
+  sPatchSeg segs[MAX_SEGS];
+  int       num;
+} sSegs;
+
+//-----------------------------------------------------------------------------
+// Records of one section
+typedef struct
+{
+  struct
+  {
+    int idx;  // Index in the new section
+    int len;  // [bytes]
+    int seg;  // Copied from this part (code, then strings), else -1
+  } runs[MAX_SEGS];
+  int num;
+} sRuns;
+
+//-----------------------------------------------------------------------------
+// New image written by the self check
+typedef struct
+{
+  char data[MAX_SIZE];
+  int  size;
+} sOut;
+
+//=============================================================================
+// Private variables
+//=============================================================================
+static sFile old;
+static sFile new;
+static sSegs code;
+static sSegs strs;
+static sRuns codeRuns;
+static sRuns strRuns;
+static int   saved[MAX_SEGS];  // Bytes copied by a part
+static sOut  out;
+static int   heads[1 << HASH_BITS];
+static int   nexts[MAX_SEGS];
+static int   strHeads[1 << HASH_BITS];  // Strings of the old code
+static int   strNexts[CODE_MEM];
+static int   strAt[STRING_MEM];  // Length of a string of the new code
+
+//=============================================================================
+// Private functions
+//=============================================================================
+static uint32_t fnv1a(uint32_t hash, const void* data, int len)
+{
+  const uint8_t* p = data;
+  while (len-- > 0)
+    hash = (hash ^ *p++) * FNV_PRIME;
+  return hash;
+}
+
+//-----------------------------------------------------------------------------
+static sCode decode(const sFile* f, int idx)
+{
+  sCode c = {.op = (eOp)f->image.code[idx]};
+  memcpy(&c.param, &f->image.code[idx + 1], image_codeLen(c.op) - 1);
+  return c;
+}
+
+//-----------------------------------------------------------------------------
+static uint32_t key(const sFile* f, int idx)
+{
+  // Instruction without the parts moved by patch_reloc(), strings by content
+  sCode    c    = decode(f, idx);
+  uint32_t hash = fnv1a(FNV_OFFSET, &f->image.code[idx], 1);
+
+  if (image_isJump(c.op))
+    return fnv1a(hash, &c.param2, sizeof(c.param2));
+  if (c.op == VAL_STRING)
+  {
+    hash = fnv1a(hash, &c.str.len, sizeof(c.str.len));
+    if (c.str.start >= 0 && c.str.start + c.str.len <= f->image.strLen)
+      hash = fnv1a(hash, &f->image.strings[c.str.start], c.str.len);
+    return hash;
+  }
+  return fnv1a(hash, &f->image.code[idx + 1], image_codeLen(c.op) - 1);
+}
+
+//-----------------------------------------------------------------------------
+static bool readImage(const char* filename, sFile* f)
+{
+  FILE* file = fopen(filename, "rb");
+  int   len;
+
+  if (!file)
+  {
+    printf("Can't read %s" BASIC_OUT_EOL, filename);
+    return false;
+  }
+  f->size = fread(f->data, 1, sizeof(f->data), file);
+  fclose(file);
+  memcpy(&f->header, f->data, sizeof(f->header));
+  if (f->size < (int)sizeof(f->header) || f->header.magic != IMAGE_MAGIC ||
+      f->header.codeLen > CODE_MEM || f->header.strLen > STRING_MEM ||
+      IMAGE_SIZE(f->header.codeLen, f->header.strLen) != f->size)
+  {
+    printf("%s: not an image of this configuration" BASIC_OUT_EOL, filename);
+    return false;
+  }
+  f->image.code    = f->data + sizeof(f->header);
+  f->image.codeLen = f->header.codeLen;
+  f->image.strings = f->image.code + f->header.codeLen;
+  f->image.strLen  = f->header.strLen;
+
+  for (int idx = 0; idx < f->image.codeLen; idx += len)
+  {
+    len = image_codeLen((eOp)f->image.code[idx]);
+    if (len <= 0 || idx + len > f->image.codeLen)
+    {
+      printf("%s: invalid instruction at %d" BASIC_OUT_EOL, filename, idx);
+      return false;
+    }
+    f->keys[f->opNum]  = key(f, idx);
+    f->ops[f->opNum++] = idx;
+    f->start[idx]      = true;
+  }
+  f->ops[f->opNum] = f->image.codeLen;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static void addSeg(sSegs* s, int from, int to, int len)
+{
+  s->segs[s->num].from = from;
+  s->segs[s->num].to   = to;
+  s->segs[s->num].len  = len;
+  s->num++;
+}
+
+//-----------------------------------------------------------------------------
+static uint32_t gram(const uint32_t* keys, int n)
+{
+  return fnv1a(FNV_OFFSET, keys, n * sizeof(keys[0])) >> (32 - HASH_BITS);
+}
+
+//-----------------------------------------------------------------------------
+static void matchCode(void)
+{
+  // Instructions of the new image in the old one: behind the previous match
+  // or else at the longest match of CODE_GRAM instructions
+  int o = 0;
+  int n = 0;
+  int len;
+
+  memset(heads, -1, sizeof(heads));
+  for (int i = old.opNum - CODE_GRAM; i >= 0; i--)
+  {
+    uint32_t h = gram(&old.keys[i], CODE_GRAM);
+    nexts[i]   = heads[h];
+    heads[h]   = i;
+  }
+
+  while (n < new.opNum)
+  {
+    len = 0;
+    while (o + len < old.opNum && n + len < new.opNum &&
+           old.keys[o + len] == new.keys[n + len])
+      len++;
+    if (len == 0 && n + CODE_GRAM <= new.opNum)
+    {
+      for (int i = heads[gram(&new.keys[n], CODE_GRAM)]; i >= 0; i = nexts[i])
+      {
+        int l = 0;
+        while (i + l < old.opNum && n + l < new.opNum &&
+               old.keys[i + l] == new.keys[n + l])
+          l++;
+        if (l >= CODE_GRAM && l > len)
+        {
+          o   = i;
+          len = l;
+        }
+      }
+    }
+    if (len == 0)
+    {
+      n++;
+      continue;
+    }
+    addSeg(&code, old.ops[o], new.ops[n], old.ops[o + len] - old.ops[o]);
+    o += len;
+    n += len;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static void matchStrings(void)
+{
+  // Same for the bytes of the string section. Short strings (e.g. "\r\n")
+  // are found by the strings of the code
+  const char* a = old.image.strings;
+  const char* b = new.image.strings;
+  int         o = 0;
+  int         n = 0;
+  int         len;
+  sCode       c;
+
+  memset(heads, -1, sizeof(heads));
+  for (int i = old.image.strLen - STR_GRAM; i >= 0; i--)
+  {
+    uint32_t h = fnv1a(FNV_OFFSET, &a[i], STR_GRAM) >> (32 - HASH_BITS);
+    nexts[i]   = heads[h];
+    heads[h]   = i;
+  }
+  memset(strHeads, -1, sizeof(strHeads));
+  for (int i = 0; i < old.opNum; i++)
+  {
+    c = decode(&old, old.ops[i]);
+    if (c.op == VAL_STRING && c.str.len > 0 && c.str.start >= 0 &&
+        c.str.start + c.str.len <= old.image.strLen)
+    {
+      uint32_t h =
+          fnv1a(FNV_OFFSET, &a[c.str.start], c.str.len) >> (32 - HASH_BITS);
+      strNexts[i] = strHeads[h];
+      strHeads[h] = i;
+    }
+  }
+  for (int i = 0; i < new.opNum; i++)
+  {
+    c = decode(&new, new.ops[i]);
+    if (c.op == VAL_STRING && c.str.start >= 0 &&
+        c.str.start + c.str.len <= new.image.strLen &&
+        c.str.len > strAt[c.str.start])
+      strAt[c.str.start] = c.str.len;
+  }
+
+  while (n < new.image.strLen)
+  {
+    len = 0;
+    while (o + len < old.image.strLen && n + len < new.image.strLen &&
+           a[o + len] == b[n + len])
+      len++;
+    if (len == 0 && n + STR_GRAM <= new.image.strLen)
+    {
+      uint32_t h = fnv1a(FNV_OFFSET, &b[n], STR_GRAM) >> (32 - HASH_BITS);
+      for (int i = heads[h]; i >= 0; i = nexts[i])
+      {
+        int l = 0;
+        while (i + l < old.image.strLen && n + l < new.image.strLen &&
+               a[i + l] == b[n + l])
+          l++;
+        if (l >= STR_GRAM && l > len)
+        {
+          o   = i;
+          len = l;
+        }
+      }
+    }
+    if (len == 0 && strAt[n] > 0)
+    {
+      uint32_t h = fnv1a(FNV_OFFSET, &b[n], strAt[n]) >> (32 - HASH_BITS);
+      for (int i = strHeads[h]; i >= 0 && len == 0; i = strNexts[i])
+      {
+        c = decode(&old, old.ops[i]);
+        if (c.str.len == strAt[n] &&
+            memcmp(&a[c.str.start], &b[n], c.str.len) == 0)
+        {
+          o   = c.str.start;
+          len = c.str.len;
+        }
+      }
+    }
+    if (len == 0)
+    {
+      n++;
+      continue;
+    }
+    addSeg(&strs, o, n, len);
+    o += len;
+    n += len;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static void merge(sSegs* s)
+{
+  // Joins parts with the same offset, the bytes in between become records
+  int num = 0;
+
+  for (int k = 0; k < s->num; k++)
+  {
+    sPatchSeg* prev = &s->segs[num - 1];
+    if (num > 0 && s->segs[k].from - prev->from == s->segs[k].to - prev->to)
+      prev->len = s->segs[k].to + s->segs[k].len - prev->to;
+    else
+      s->segs[num++] = s->segs[k];
+  }
+  s->num = num;
+}
+
+//-----------------------------------------------------------------------------
+static int segAt(const sSegs* s, int* k, int idx)
+{
+  // Part with the new index idx, *k is a part in front of it
+  while (*k < s->num && idx >= (int)(s->segs[*k].to + s->segs[*k].len))
+    (*k)++;
+  return (*k < s->num && idx >= (int)s->segs[*k].to) ? *k : -1;
+}
+
+//-----------------------------------------------------------------------------
+static void addRun(sRuns* r, int idx, int len, int seg)
+{
+  // Extends the last record if it's of the same kind
+  if (r->num > 0 && r->runs[r->num - 1].seg == seg)
+  {
+    r->runs[r->num - 1].len += len;
+    return;
+  }
+  r->runs[r->num].idx = idx;
+  r->runs[r->num].len = len;
+  r->runs[r->num].seg = seg;
+  r->num++;
+}
+
+//-----------------------------------------------------------------------------
+static void strSaved(idxType start, int len)
+{
+  // Copied string instruction: counts for the string part in front of its
+  // old address (see patch_reloc())
+  int prev = -1;
+
+  for (int k = 0; k < strs.num; k++)
+    if (start >= (int)strs.segs[k].from &&
+        (prev < 0 || strs.segs[k].from > strs.segs[prev].from))
+      prev = k;
+  if (prev >= 0)
+    saved[code.num + prev] += len;
+}
+
+//-----------------------------------------------------------------------------
+static void findCodeRuns(const sPatchSeg* segs)
+{
+  // Instructions of a part are copied if they're the same after
+  // patch_reloc()
+  char buf[sizeof(sCode)];
+  int  k = 0;
+
+  codeRuns.num = 0;
+  for (int i = 0; i < new.opNum; i++)
+  {
+    int   idx = new.ops[i];
+    int   len = new.ops[i + 1] - idx;
+    int   seg = segAt(&code, &k, idx);
+    int   from;
+    sCode c;
+    sCode o;
+
+    if (seg >= 0)
+    {
+      from = code.segs[seg].from + idx - code.segs[seg].to;
+      if (!old.start[from] ||
+          image_codeLen((eOp)old.image.code[from]) != len)
+        seg = -1;
+    }
+    if (seg >= 0)
+    {
+      c = o = decode(&old, from);
+      patch_reloc(segs, code.num, strs.num, &c);
+      buf[0] = (char)c.op;
+      memcpy(&buf[1], &c.param, len - 1);
+      if (memcmp(buf, &new.image.code[idx], len) != 0)
+        seg = -1;
+      else if (c.op == VAL_STRING)
+        strSaved(o.str.start, len);
+    }
+    addRun(&codeRuns, idx, len, seg);
+  }
+}
+
+//-----------------------------------------------------------------------------
+static void findStrRuns(void)
+{
+  // Bytes of a part are copied if they're the same
+  int k = 0;
+
+  strRuns.num = 0;
+  for (int idx = 0; idx < new.image.strLen; idx++)
+  {
+    int seg = segAt(&strs, &k, idx);
+    if (seg >= 0 &&
+        old.image.strings[strs.segs[seg].from + idx - strs.segs[seg].to] !=
+            new.image.strings[idx])
+      seg = -1;
+    addRun(&strRuns, idx, 1, (seg >= 0) ? code.num + seg : -1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+static void count(sRuns* r)
+{
+  // Short copies become bytes, the copied bytes count for the parts
+  int num = 0;
+
+  for (int i = 0; i < r->num; i++)
+  {
+    if (r->runs[i].len < MIN_COPY)
+      r->runs[i].seg = -1;
+    if (num > 0 && r->runs[i].seg < 0 && r->runs[num - 1].seg < 0)
+      r->runs[num - 1].len += r->runs[i].len;
+    else
+      r->runs[num++] = r->runs[i];
+  }
+  r->num = num;
+  for (int i = 0; i < r->num; i++)
+    if (r->runs[i].seg >= 0)
+      saved[r->runs[i].seg] += r->runs[i].len;
+}
+
+//-----------------------------------------------------------------------------
+static int cmpSaved(const void* a, const void* b)
+{
+  return saved[*(const int*)a] - saved[*(const int*)b];
+}
+
+//-----------------------------------------------------------------------------
+static bool drop(void)
+{
+  // Removes the parts which copy less than their entry in the patch, else
+  // the ones which copy the least if there are more than PATCH_MAX_SEGS.
+  // True if any
+  static int order[MAX_SEGS];
+  int        num  = code.num + strs.num;
+  int        kept = 0;
+  int        k;
+
+  for (k = 0; k < num; k++)
+    order[k] = k;
+  qsort(order, num, sizeof(order[0]), cmpSaved);
+  for (k = 0; k < num; k++)
+    if (saved[order[k]] > (int)sizeof(sPatchSeg))
+      break;
+  if (k == 0 && num > PATCH_MAX_SEGS)
+    k = num - PATCH_MAX_SEGS;
+  if (k == 0)
+    return false;
+
+  // Marked by len 0
+  for (int i = 0; i < k; i++)
+  {
+    if (order[i] < code.num)
+      code.segs[order[i]].len = 0;
+    else
+      strs.segs[order[i] - code.num].len = 0;
+  }
+  for (int i = 0; i < code.num; i++)
+    if (code.segs[i].len > 0)
+      code.segs[kept++] = code.segs[i];
+  code.num = kept;
+  kept     = 0;
+  for (int i = 0; i < strs.num; i++)
+    if (strs.segs[i].len > 0)
+      strs.segs[kept++] = strs.segs[i];
+  strs.num = kept;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static void table(sPatchSeg* segs)
+{
+  // Parts as stored in the patch: code, then strings
+  memcpy(segs, code.segs, code.num * sizeof(sPatchSeg));
+  memcpy(&segs[code.num], strs.segs, strs.num * sizeof(sPatchSeg));
+}
+
+//-----------------------------------------------------------------------------
+static void reduce(void)
+{
+  // Records of the parts which are worth it
+  static sPatchSeg segs[MAX_SEGS];
+
+  merge(&code);
+  merge(&strs);
+  do
+  {
+    table(segs);
+    memset(saved, 0, sizeof(saved));
+    findCodeRuns(segs);
+    findStrRuns();
+    count(&codeRuns);
+    count(&strRuns);
+  } while (drop());
+}
+
+//-----------------------------------------------------------------------------
+static bool writeRuns(FILE* f, const sRuns* r, const char* data)
+{
+  // LEB128 of (bytes << 1 | copy), followed by the bytes if not copied
+  for (int i = 0; i < r->num; i++)
+  {
+    uint32_t value = (uint32_t)r->runs[i].len << 1 | (r->runs[i].seg >= 0);
+    uint8_t  buf[5];
+    int      len = 0;
+
+    do
+    {
+      buf[len] = value & 0x7F;
+      value >>= 7;
+      if (value)
+        buf[len] |= 0x80;
+      len++;
+    } while (value);
+    if (fwrite(buf, 1, len, f) != (size_t)len ||
+        (r->runs[i].seg < 0 &&
+         fwrite(&data[r->runs[i].idx], 1, r->runs[i].len, f) !=
+             (size_t)r->runs[i].len))
+      return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static bool writePatch(const char* filename)
+{
+  static sPatchSeg segs[PATCH_MAX_SEGS];
+  sPatchHeader     header = {
+        .magic    = PATCH_MAGIC,
+        .version  = PATCH_VERSION,
+        .codeSegs = code.num,
+        .strSegs  = strs.num,
+        .oldCrc   = old.header.crc,
+        .newCrc   = image_crc(0, new.data, new.size),
+  };
+  FILE* f = fopen(filename, "wb");
+  bool  ok;
+
+  if (!f)
+  {
+    printf("Can't write %s" BASIC_OUT_EOL, filename);
+    return false;
+  }
+  table(segs);
+  ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+       fwrite(&new.header, sizeof(new.header), 1, f) == 1 &&
+       fwrite(segs, sizeof(sPatchSeg), code.num + strs.num, f) ==
+           (size_t)(code.num + strs.num) &&
+       writeRuns(f, &codeRuns, new.image.code) &&
+       writeRuns(f, &strRuns, new.image.strings);
+  return (fclose(f) == 0) && ok;
+}
+
+//-----------------------------------------------------------------------------
+static bool writeOut(void* ctx, const void* data, int len)
+{
+  sOut* o = ctx;
+  if (o->size + len > (int)sizeof(o->data))
+    return false;
+  memcpy(&o->data[o->size], data, len);
+  o->size += len;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+static bool check(const char* filename)
+{
+  // Applies the patch as the target does (in small pieces)
+  static sPatcher patcher;
+  static char     patch[2 * MAX_SIZE + PATCH_MAX_SEGS * sizeof(sPatchSeg)];
+  FILE*           f    = fopen(filename, "rb");
+  int             size = 0;
+  int             res  = 0;
+
+  if (f)
+  {
+    size = fread(patch, 1, sizeof(patch), f);
+    fclose(f);
+  }
+  res = patch_init(&patcher, old.data, old.size, writeOut, &out);
+  for (int pos = 0; res == 0 && pos < size; pos += FEED_CHUNK)
+    res = patch_feed(&patcher, &patch[pos],
+                     (size - pos < FEED_CHUNK) ? size - pos : FEED_CHUNK);
+  if (res != 1 || out.size != new.size || memcmp(out.data, new.data, new.size))
+  {
+    printf("Patch check failed (%d)" BASIC_OUT_EOL, res);
+    return false;
+  }
+  printf("Patch %d bytes (%d + %d parts), image %d -> %d bytes" BASIC_OUT_EOL,
+         size, code.num, strs.num, old.size, new.size);
+  return true;
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+int main(int argc, char* argv[])
+{
+  const char* output = NULL;
+  const char* files[2];
+  int         fileCnt = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      output = argv[++i];
+    else if (argv[i][0] != '-' && fileCnt < 2)
+      files[fileCnt++] = argv[i];
+    else
+    {
+      fileCnt = 0;  // Invalid argument -> usage
+      break;
+    }
+  }
+  if (fileCnt != 2 || !output)
+  {
+    printf("usage: basicpatch -o patch old new" BASIC_OUT_EOL);
+    printf("  -o patch  Patch which turns the image old into new"
+           BASIC_OUT_EOL);
+    return 2;
+  }
+
+  if (!readImage(files[0], &old) || !readImage(files[1], &new))
+    return 1;
+  if (old.header.version != new.header.version ||
+      old.header.ops != new.header.ops ||
+      old.header.signature != new.header.signature)
+  {
+    printf("Images of different targets (version or signature)"
+           BASIC_OUT_EOL);
+    return 1;
+  }
+
+  matchStrings();
+  matchCode();
+  reduce();
+  return (writePatch(output) && check(output)) ? 0 : 1;
+}